@@ -42,6 +42,7 @@ int main(int argc, char *const argv[]) {
     if (::errorCount() > 0)
         return 1;
 
+    ArenaScope arena;
     auto hook = options.getDebugHook();
 
     // BMV2 is required for compatibility with the previous compiler.
@@ -83,7 +84,7 @@ int main(int argc, char *const argv[]) {
             auto format = options.p4RuntimeAsJson ? P4::P4RuntimeFormat::JSON
                                                   : P4::P4RuntimeFormat::BINARY;
             serializeP4Runtime(out, program, toplevel, &midEnd.refMap,
-                               &midEnd.typeMap, format);
+                               &midEnd.typeMap, format, options.compactJson);
         }
     }
 
@@ -17,6 +17,7 @@ limitations under the License.
 #include <algorithm>
 
 #include "jsonconverter.h"
+#include "lib/gc.h"
 #include "lib/gmputil.h"
 #include "frontends/p4/coreLibrary.h"
 #include "ir/ir.h"
@@ -1908,6 +1909,7 @@ Util::IJson* JsonConverter::convertControl(const IR::ControlBlock* block, cstrin
 
 unsigned JsonConverter::nextId(cstring group) {
     static std::map<cstring, unsigned> counters;
+    OutsideArena permanent;
     return counters[group]++;
 }
 
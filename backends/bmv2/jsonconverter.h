@@ -55,7 +55,9 @@ class DirectMeterMap final {
 class JsonConverter final {
  public:
     const CompilerOptions& options;
-    Util::JsonObject       toplevel;  // output is constructed here
+    // Output is constructed here and only serialized at the end: converting
+    // the actions and pipelines appends to sections that precede them.
+    Util::JsonObject       toplevel;
     P4V1::V1Model&         v1model;
     P4::P4CoreLibrary&     corelib;
     P4::ReferenceMap*      refMap;
@@ -159,7 +161,7 @@ class JsonConverter final {
     void convert(P4::ReferenceMap* refMap, P4::TypeMap* typeMap, const IR::ToplevelBlock *toplevel,
                  P4::ConvertEnums::EnumMapping* enumMap);
     void serialize(std::ostream& out) const
-    { toplevel.serialize(out); }
+    { toplevel.serialize(out, options.compactJson); }
 };
 
 }  // namespace BMV2
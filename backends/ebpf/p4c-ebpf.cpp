@@ -32,6 +32,7 @@ limitations under the License.
 #include "frontends/p4/frontend.h"
 
 void compile(EbpfOptions& options) {
+    ArenaScope arena;
     auto hook = options.getDebugHook();
     bool isv1 = options.langVersion == CompilerOptions::FrontendVersion::P4_14;
     if (isv1) {
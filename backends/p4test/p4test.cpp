@@ -14,6 +14,9 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+#include <fstream>
+#include <iostream>
+
 #include "ir/ir.h"
 #include "lib/log.h"
 #include "lib/error.h"
@@ -52,6 +55,7 @@ int main(int argc, char *const argv[]) {
     if (::errorCount() > 0)
         return 1;
 
+    ArenaScope arena;
     auto program = parseP4File(options);
     auto hook = options.getDebugHook();
 
@@ -63,16 +67,13 @@ int main(int argc, char *const argv[]) {
         if (program != nullptr && ::errorCount() == 0) {
             P4Test::MidEnd midEnd(options);
             midEnd.addDebugHook(hook);
-#if 0
-            /* doing this breaks the output until we get dump/undump of srcInfo */
-            if (options.debugJson) {
-                std::stringstream tmp;
-                JSONGenerator gen(tmp);
-                gen << program;
-                JSONLoader loader(tmp);
-                loader >> program;
+            if (options.debugBinary) {
+                // run the midend on the IR reloaded from its binary form,
+                // which keeps the source positions: the output must not change
+                std::stringstream bin;
+                BinaryGenerator(bin) << program;
+                BinaryLoader(bin) >> program;
             }
-#endif
             auto top = midEnd.process(program);
             log_dump(program, "After midend");
             log_dump(top, "Top level block");
@@ -96,6 +97,25 @@ int main(int argc, char *const argv[]) {
                     system("json_diff t1.json t2.json");
                 }
             }
+            if (options.dumpBinaryFile)
+                BinaryGenerator(*openFile(options.dumpBinaryFile, true)) << program;
+            if (options.debugBinary) {
+                // the reloaded IR must be the same as the original one, down
+                // to the node ids and source positions
+                std::stringstream bin, json1, json2;
+                BinaryGenerator(bin) << program;
+
+                const IR::Node* node = nullptr;
+                BinaryLoader loader(bin);
+                loader >> node;
+
+                JSONGenerator(json1) << program;
+                JSONGenerator(json2) << node;
+                std::stringstream bin2;
+                BinaryGenerator(bin2) << node;
+                if (json1.str() != json2.str() || bin.str() != bin2.str())
+                    error("binary IR mismatch");
+            }
         }
     }
     if (Log::verbose())
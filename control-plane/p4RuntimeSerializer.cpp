@@ -786,13 +786,14 @@ public:
 
     /// Serialize the control plane API to @destination as a message in the JSON
     /// protocol buffers format. This is intended for debugging and testing.
-    void writeJsonTo(std::ostream* destination) {
+    /// If @compact is true, the JSON is written without whitespace.
+    void writeJsonTo(std::ostream* destination, bool compact) {
         using namespace google::protobuf::util;
         CHECK_NULL(destination);
 
-        // Serialize the JSON in a human-readable format.
+        // Serialize the JSON in a human-readable format, unless asked otherwise.
         JsonPrintOptions options;
-        options.add_whitespace = true;
+        options.add_whitespace = !compact;
 
         std::string output;
         if (MessageToJsonString(*p4Info, &output, options) != Status::OK) {
@@ -1475,7 +1476,8 @@ void serializeP4Runtime(std::ostream* destination,
                         const IR::ToplevelBlock* evaluatedProgram,
                         ReferenceMap* refMap,
                         TypeMap* typeMap,
-                        P4RuntimeFormat format /* = P4RuntimeFormat::BINARY */) {
+                        P4RuntimeFormat format /* = P4RuntimeFormat::BINARY */,
+                        bool compactJson /* = false */) {
     using namespace ControlPlaneAPI;
 
     // Perform a first pass to collect all of the control plane visible symbols in
@@ -1508,7 +1510,7 @@ void serializeP4Runtime(std::ostream* destination,
     // Write the serialization out in the requested format.
     switch (format) {
         case P4RuntimeFormat::BINARY: serializer.writeTo(destination); break;
-        case P4RuntimeFormat::JSON: serializer.writeJsonTo(destination); break;
+        case P4RuntimeFormat::JSON: serializer.writeJsonTo(destination, compactJson); break;
     }
 }
 
@@ -39,7 +39,8 @@ void serializeP4Runtime(std::ostream* destination,
                         const IR::ToplevelBlock* evaluatedProgram,
                         ReferenceMap* refMap,
                         TypeMap* typeMap,
-                        P4RuntimeFormat format = P4RuntimeFormat::BINARY);
+                        P4RuntimeFormat format = P4RuntimeFormat::BINARY,
+                        bool compactJson = false);
 
 }  // namespace P4
 
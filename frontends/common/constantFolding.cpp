@@ -768,7 +768,12 @@ const IR::Node* DoConstantFolding::postorder(IR::SelectExpression* expression) {
     if (changes) {
         if (cases.size() == 0 && result == expression && warnings)
             ::warning("%1%: no case matches", expression);
-        expression->selectCases = std::move(cases);
+        if (result == expression) {
+            // don't modify the node in place; see cloneOnWrite
+            auto clone = expression->clone();
+            clone->selectCases = std::move(cases);
+            result = clone;
+        }
     }
     return result;
 }
@@ -58,7 +58,7 @@ class DoConstantFolding : public Transform {
  public:
     DoConstantFolding(const ReferenceMap* refMap, TypeMap* typeMap, bool warnings = true) :
             refMap(refMap), typeMap(typeMap), typesKnown(typeMap != nullptr), warnings(warnings) {
-        visitDagOnce = true; setName("DoConstantFolding");
+        visitDagOnce = true; cloneOnWrite = true; setName("DoConstantFolding");
     }
 
     const IR::Node* postorder(IR::Declaration_Constant* d) override;
@@ -17,16 +17,19 @@ limitations under the License.
 #include <getopt.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <stdlib.h>
 #include <unistd.h>
 
 #include "setup.h"
 #include "options.h"
 #include "lib/log.h"
 #include "lib/exceptions.h"
+#include "lib/gc.h"
 #include "lib/nullstream.h"
 #include "lib/path.h"
 #include "frontends/p4/toP4/toP4.h"
 #include "ir/json_generator.h"
+#include "ir/pass_manager.h"
 
 const char* CompilerOptions::defaultMessage = "Compile a P4 program";
 
@@ -91,15 +94,42 @@ CompilerOptions::CompilerOptions() : Util::Options(defaultMessage) {
     registerOption("--testJson", nullptr,
                     [this](const char*) { debugJson = true; return true; },
                     "Dump and undump the IR");
+    registerOption("--toBinary", "file",
+                   [this](const char* arg) { dumpBinaryFile = arg; return true; },
+                   "Dump IR in binary form to the specified file.");
+    registerOption("--testBinary", nullptr,
+                   [this](const char*) { debugBinary = true; return true; },
+                   "Dump and undump the IR in binary form");
     registerOption("--p4runtime-file", "file",
                    [this](const char* arg) { p4RuntimeFile = arg; return true; },
                    "Write a P4Runtime control plane API description to the specified file.");
     registerOption("--p4runtime-as-json", nullptr,
                    [this](const char*) { p4RuntimeAsJson = true; return true; },
                    "Write out the P4Runtime API description as human-readable JSON.");
+    registerOption("--compact-json", nullptr,
+                   [this](const char*) { compactJson = true; return true; },
+                   "Write JSON output without indentation or line breaks.");
     registerOption("-o", "outfile",
                    [this](const char* arg) { outputFile = arg; return true; },
                    "Write output to outfile");
+    registerOption("--arena", nullptr,
+                   [](const char*) { enable_arena_alloc(); return true; },
+                   "Allocate memory from an arena that is freed only at the end of the\n"
+                   "compilation, instead of using the garbage collector.  Faster, but\n"
+                   "may use more memory.");
+    registerOption("--threads", "n",
+                   [](const char* arg) {
+                       char *end;
+                       long n = strtol(arg, &end, 10);
+                       if (*end || n < 0) {
+                           ::error("Illegal thread count %1%", arg);
+                           return false; }
+                       ParallelContainers::threads = n;
+                       return true; },
+                   "Number of threads used to process controls and parsers in parallel\n"
+                   "(default: 1; 0 means one per core).  The ids of the IR nodes, shown\n"
+                   "by --toJSON, then depend on scheduling.  Needs --arena when built\n"
+                   "with the garbage collector.");
     registerOption("--Werror", nullptr,
                     [](const char*) {
                         ErrorReporter::instance.setWarningsAreErrors();
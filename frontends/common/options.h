@@ -71,12 +71,22 @@ class CompilerOptions : public Util::Options {
     // Dump and undump the IR tree
     bool debugJson = false;
 
+    // Dump a binary representation of the IR in the file
+    cstring dumpBinaryFile = nullptr;
+
+    // Dump and undump the IR tree in binary form
+    bool debugBinary = false;
+
     // Write a P4Runtime control plane API description to the specified file.
     cstring p4RuntimeFile = nullptr;
 
     // If true, write out the P4Runtime API description as human-readable JSON.
     bool p4RuntimeAsJson = false;
 
+    // Write JSON output (the bmv2 configuration and the P4Runtime description
+    // in JSON) without indentation or line breaks.
+    bool compactJson = false;
+
     // Compiler target architecture
     cstring target = nullptr;
     // substrings matched agains pass names
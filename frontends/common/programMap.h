@@ -24,10 +24,12 @@ namespace P4 {
 // Base class for various maps.
 // A map is computed on a certain P4Program.
 // If the program has not changed, the map is up-to-date.
-class ProgramMap : public IHasDbPrint {
+class ProgramMap : public IHasDbPrint, public ProgramAnalysis {
  protected:
     const IR::P4Program* program = nullptr;
     cstring mapKind;
+    // incremented whenever the map is (re)computed for a different program
+    unsigned generation = 0;
     explicit ProgramMap(cstring kind) : mapKind(kind) {}
     virtual ~ProgramMap() {}
 
@@ -55,9 +57,15 @@ class ProgramMap : public IHasDbPrint {
     void updateMap(const IR::Node* node) {
         if (!node->is<IR::P4Program>())
             return;
+        if (program != node)
+            ++generation;
         program = node->to<IR::P4Program>();
         LOG2(mapKind << " updated to " << dbp(node));
     }
+    unsigned getGeneration() const { return generation; }
+    bool validFor(const IR::Node* node) const override
+    { return program != nullptr && program == node; }
+    void revalidate(const IR::Node* node) override { updateMap(node); }
 };
 
 }  // namespace P4
@@ -15,6 +15,7 @@ limitations under the License.
 */
 
 #include <sstream>
+#include <unordered_set>
 #include "referenceMap.h"
 #include "frontends/p4/reservedWords.h"
 
@@ -25,22 +26,134 @@ ReferenceMap::ReferenceMap() : ProgramMap("ReferenceMap"), isv1(false) { clear()
 void ReferenceMap::clear() {
     pathToDeclaration.clear();
     usedNames.clear();
+    nameCount.clear();
     used.clear();
     thisToDeclaration.clear();
-    usedNames.insert(P4::reservedWords.begin(), P4::reservedWords.end());
+    resolved.clear();
+    untracked = Resolved();
+    current = &untracked;
+    shared.clear();
+    run = 0;
+    for (auto word : P4::reservedWords)
+        usedNames.insert(word);
+}
+
+void ReferenceMap::usedName(cstring name) {
+    if (P4::reservedWords.count(name))
+        return;
+    usedNames.insert(name);
+    nameCount[name]++;
+    current->names.push_back(name);
+}
+
+bool ReferenceMap::unshare(const IR::Node* node) {
+    auto it = shared.find(node);
+    if (it == shared.end())
+        return false;
+    if (--it->second == 0)
+        shared.erase(it);
+    return true;
+}
+
+void ReferenceMap::unuse(const IR::IDeclaration* decl) {
+    auto it = used.find(decl);
+    if (--it->second == 0)
+        used.erase(it);
+}
+
+void ReferenceMap::forget(Resolved& r) {
+    for (auto path : r.paths) {
+        if (unshare(path))
+            continue;
+        auto it = pathToDeclaration.find(path);
+        unuse(it->second.first);
+        pathToDeclaration.erase(it); }
+    for (auto pointer : r.pointers) {
+        if (!unshare(pointer))
+            thisToDeclaration.erase(pointer); }
+    for (auto name : r.names) {
+        auto it = nameCount.find(name);
+        if (--it->second == 0) {
+            nameCount.erase(it);
+            usedNames.erase(name); } }
+    r = Resolved();
+}
+
+void ReferenceMap::forget(const IR::Node* decl) {
+    auto it = resolved.find(decl);
+    if (it == resolved.end())
+        return;
+    forget(it->second);
+    resolved.erase(it);
+}
+
+void ReferenceMap::update(const IR::P4Program* program) {
+    run++;
+    forget(untracked);
+    std::unordered_set<const IR::Node*> live;
+    for (auto decl : *program->declarations) {
+        live.insert(decl);
+        if (auto control = decl->to<IR::P4Control>()) {
+            live.insert(control->controlLocals->begin(), control->controlLocals->end());
+        } else if (auto parser = decl->to<IR::P4Parser>()) {
+            live.insert(parser->parserLocals->begin(), parser->parserLocals->end());
+            live.insert(parser->states->begin(), parser->states->end()); } }
+    for (auto it = resolved.begin(); it != resolved.end();) {
+        if (live.count(it->first)) {
+            ++it;
+        } else {
+            forget(it->second);
+            it = resolved.erase(it); } }
+}
+
+void ReferenceMap::dependsOn(Resolved* r, const IR::IDeclaration* decl, const Dependence& dep) {
+    unsigned kind = dep.isType | dep.previousOnly << 1 | dep.absolute << 2;
+    auto it = r->dependences.emplace(std::make_pair(decl, kind), dep);
+    if (!it.second && dep.previousOnly) {
+        // Declarations visible from a position stay visible further on, so if
+        // the first and last use resolve to decl, all of them in between do.
+        auto &d = it.first->second;
+        if (dep.first.srcInfo < d.first.srcInfo)
+            d.first = dep.first;
+        if (d.last.srcInfo < dep.last.srcInfo)
+            d.last = dep.last; }
+}
+
+ReferenceMap::Resolved* ReferenceMap::startResolving(const IR::Node* decl) {
+    forget(decl);
+    auto outer = current;
+    current = &resolved[decl];
+    return outer;
+}
+
+void ReferenceMap::endResolving(Resolved* outer, bool reusable) {
+    current->reusable = reusable;
+    current = outer;
 }
 
 void ReferenceMap::setDeclaration(const IR::Path* path, const IR::IDeclaration* decl) {
     CHECK_NULL(path);
     CHECK_NULL(decl);
     LOG1("Resolved " << path << " to " << decl);
-    auto previous = get(pathToDeclaration, path);
-    if (previous != nullptr && previous != decl)
-        BUG("%1% already resolved to %2% instead of %3%",
-                                path, previous, decl);
-    pathToDeclaration.emplace(path, decl);
+    auto it = pathToDeclaration.find(path);
+    if (it == pathToDeclaration.end()) {
+        pathToDeclaration.emplace(path, std::make_pair(decl, run));
+        used[decl]++;
+    } else {
+        auto previous = it->second.first;
+        if (previous != decl) {
+            // A path resolved in an earlier run may be reached from a changed
+            // declaration before the one that holds it is resolved again.
+            if (it->second.second == run)
+                BUG("%1% already resolved to %2% instead of %3%",
+                                        path, previous, decl);
+            unuse(previous);
+            used[decl]++;
+            it->second.first = decl; }
+        it->second.second = run;
+        shared[path]++; }
+    current->paths.push_back(path);
     usedName(path->name.name);
-    used.insert(decl);
 }
 
 void ReferenceMap::setDeclaration(const IR::This* pointer, const IR::IDeclaration* decl) {
@@ -51,7 +164,11 @@ void ReferenceMap::setDeclaration(const IR::This* pointer, const IR::IDeclaratio
     if (previous != nullptr && previous != decl)
         BUG("%1% already resolved to %2% instead of %3%",
             dbp(pointer), dbp(previous), dbp(decl));
-    thisToDeclaration.emplace(pointer, decl);
+    if (previous != nullptr)
+        shared[pointer]++;
+    else
+        thisToDeclaration.emplace(pointer, decl);
+    current->pointers.push_back(pointer);
 }
 
 const IR::IDeclaration* ReferenceMap::getDeclaration(const IR::This* pointer, bool notNull) const {
@@ -70,7 +187,8 @@ const IR::IDeclaration* ReferenceMap::getDeclaration(const IR::This* pointer, bo
 
 const IR::IDeclaration* ReferenceMap::getDeclaration(const IR::Path* path, bool notNull) const {
     CHECK_NULL(path);
-    auto result = get(pathToDeclaration, path);
+    auto it = pathToDeclaration.find(path);
+    auto result = it == pathToDeclaration.end() ? nullptr : it->second.first;
 
     if (result)
         LOG1("Looking up " << path << " found " << result->getNode());
@@ -86,7 +204,7 @@ void ReferenceMap::dbprint(std::ostream &out) const {
     if (pathToDeclaration.empty())
         out << "Empty" << std::endl;
     for (auto e : pathToDeclaration)
-        out << dbp(e.first) << "->" << dbp(e.second) << std::endl;
+        out << dbp(e.first) << "->" << dbp(e.second.first) << std::endl;
 }
 
 cstring ReferenceMap::newName(cstring base) {
@@ -104,7 +222,7 @@ cstring ReferenceMap::newName(cstring base) {
         base = base.substr(0, len - 1);
 
     cstring name = cstring::make_unique(usedNames, base, '_');
-    usedNames.insert(name);
+    usedName(name);
     return name;
 }
 
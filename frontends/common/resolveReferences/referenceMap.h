@@ -17,8 +17,11 @@ limitations under the License.
 #ifndef _COMMON_RESOLVEREFERENCES_REFERENCEMAP_H_
 #define _COMMON_RESOLVEREFERENCES_REFERENCEMAP_H_
 
+#include <unordered_map>
+
 #include "ir/ir.h"
 #include "lib/cstring.h"
+#include "lib/flat_hash.h"
 #include "lib/map.h"
 #include "frontends/common/programMap.h"
 
@@ -31,13 +34,58 @@ class NameGenerator {
 
 class ReferenceMap final : public ProgramMap, public NameGenerator {
     bool isv1;  // if true this is a map for a P4 v1.0 program (P4-14)
-    // Maps each path in the program to the corresponding declaration
-    std::map<const IR::Path*, const IR::IDeclaration*> pathToDeclaration;
-    std::set<const IR::IDeclaration*> used;
-    std::map<const IR::This*, const IR::IDeclaration*> thisToDeclaration;
+    // Maps each path in the program to the corresponding declaration,
+    // and the ResolveReferences run that found it
+    flat_hash_map<const IR::Path*, std::pair<const IR::IDeclaration*, unsigned>>
+        pathToDeclaration;
+    // Number of paths resolved to each declaration
+    flat_hash_map<const IR::IDeclaration*, unsigned> used;
+    flat_hash_map<const IR::This*, const IR::IDeclaration*> thisToDeclaration;
 
     // All names used within the program
-    std::set<cstring> usedNames;
+    flat_hash_set<cstring> usedNames;
+    // Number of times each name was recorded (reserved words excepted)
+    flat_hash_map<cstring, unsigned> nameCount;
+
+    // Paths resolved to the same declaration outside the declaration that
+    // contains them; positions first..last are enough to check them all.
+    struct Dependence {
+        IR::ID first, last;
+        bool isType, previousOnly, absolute;
+    };
+    // Everything recorded while resolving one declaration (a top-level one,
+    // or one local to a parser or control), except for what was recorded for
+    // the declarations nested in it.  ResolveReferences can keep this when
+    // the declaration is unchanged in an updated program.
+    struct Resolved {
+        std::vector<const IR::Path*> paths;
+        std::vector<const IR::This*> pointers;
+        std::vector<cstring> names;
+        std::map<std::pair<const IR::IDeclaration*, unsigned>, Dependence> dependences;
+        bool reusable = false;
+    };
+    std::unordered_map<const IR::Node*, Resolved> resolved;
+    // Recorded by passes other than ResolveReferences
+    Resolved untracked;
+    Resolved* current;
+    // Paths and pointers reached more than once (the IR is a DAG); maps each
+    // to the number of additional Resolved records that hold it.
+    flat_hash_map<const IR::Node*, unsigned> shared;
+    unsigned run;  // incremented by update()
+
+    friend class ResolveReferences;
+    void unuse(const IR::IDeclaration* decl);
+    // Drops one of the extra holders of node; false if it has none
+    bool unshare(const IR::Node* node);
+    void forget(Resolved& r);
+    void forget(const IR::Node* decl);
+    // Forget everything recorded for declarations that are not in program
+    void update(const IR::P4Program* program);
+    static void dependsOn(Resolved* r, const IR::IDeclaration* decl, const Dependence& dep);
+    // Returns the Resolved record that was current
+    Resolved* startResolving(const IR::Node* decl);
+    void endResolving(Resolved* outer, bool reusable);
+    bool canUpdate() const { return !resolved.empty(); }
 
  public:
     ReferenceMap();
@@ -51,7 +99,7 @@ class ReferenceMap final : public ProgramMap, public NameGenerator {
     void clear();
     bool isV1() const { return isv1; }
     bool isUsed(const IR::IDeclaration* decl) const { return used.count(decl) > 0; }
-    void usedName(cstring name) { usedNames.insert(name); }
+    void usedName(cstring name);
 };
 
 }  // namespace P4
@@ -20,98 +20,104 @@ limitations under the License.
 namespace P4 {
 
 std::vector<const IR::IDeclaration*>*
-ResolutionContext::resolve(IR::ID name, P4::ResolutionType type, bool previousOnly) const {
-    static std::vector<const IR::IDeclaration*> empty;
-
-    std::vector<const IR::INamespace*> toTry(stack);
-    toTry.insert(toTry.end(), globals.begin(), globals.end());
-
-    for (auto it = toTry.rbegin(); it != toTry.rend(); ++it) {
-        const IR::INamespace* current = *it;
-        LOG2("Trying to resolve in " << current->toString());
-
-        if (current->is<IR::IGeneralNamespace>()) {
-            auto gen = current->to<IR::IGeneralNamespace>();
-            Util::Enumerator<const IR::IDeclaration*>* decls = gen->getDeclsByName(name);
-            switch (type) {
-                case P4::ResolutionType::Any:
-                    break;
-                case P4::ResolutionType::Type: {
-                    std::function<bool(const IR::IDeclaration*)> kindFilter =
-                            [](const IR::IDeclaration* d) {
-                        return d->is<IR::Type>();
-                    };
-                    decls = decls->where(kindFilter);
-                    break;
-                }
-                case P4::ResolutionType::TypeVariable: {
-                    std::function<bool(const IR::IDeclaration*)> kindFilter =
-                            [](const IR::IDeclaration* d) {
-                    return d->is<IR::Type_Var>(); };
-                    decls = decls->where(kindFilter);
-                    break;
-                }
-            default:
-                BUG("Unexpected enumeration value %1%", static_cast<int>(type));
-            }
-
-            if (previousOnly) {
-                std::function<bool(const IR::IDeclaration*)> locationFilter =
-                        [name](const IR::IDeclaration* d) {
-                    Util::SourceInfo nsi = name.srcInfo;
-                    Util::SourceInfo dsi = d->getNode()->srcInfo;
-                    bool before = dsi <= nsi;
-                    LOG2("\tPosition test:" << dsi << "<=" << nsi << "=" << before);
-                    return before;
+ResolutionContext::lookup(const IR::INamespace* current, IR::ID name,
+                          P4::ResolutionType type, bool previousOnly) const {
+    LOG2("Trying to resolve in " << current->toString());
+
+    if (current->is<IR::IGeneralNamespace>()) {
+        auto gen = current->to<IR::IGeneralNamespace>();
+        Util::Enumerator<const IR::IDeclaration*>* decls = gen->getDeclsByName(name);
+        switch (type) {
+            case P4::ResolutionType::Any:
+                break;
+            case P4::ResolutionType::Type: {
+                std::function<bool(const IR::IDeclaration*)> kindFilter =
+                        [](const IR::IDeclaration* d) {
+                    return d->is<IR::Type>();
                 };
-                decls = decls->where(locationFilter);
+                decls = decls->where(kindFilter);
+                break;
             }
-
-            auto vector = decls->toVector();
-            if (!vector->empty()) {
-                LOG2("Resolved in " << dbp(current->getNode()));
-                return vector;
-            } else {
-                continue;
-            }
-        } else {
-            auto simple = current->to<IR::ISimpleNamespace>();
-            auto decl = simple->getDeclByName(name);
-            if (decl == nullptr)
-                continue;
-            switch (type) {
-                case P4::ResolutionType::Any:
-                    break;
-                case P4::ResolutionType::Type: {
-                    if (!decl->is<IR::Type>())
-                        continue;
-                    break;
-                }
-                case P4::ResolutionType::TypeVariable: {
-                    if (!decl->is<IR::Type_Var>())
-                        continue;
-                    break;
-                }
-            default:
-                BUG("Unexpected enumeration value %1%", static_cast<int>(type));
+            case P4::ResolutionType::TypeVariable: {
+                std::function<bool(const IR::IDeclaration*)> kindFilter =
+                        [](const IR::IDeclaration* d) {
+                return d->is<IR::Type_Var>(); };
+                decls = decls->where(kindFilter);
+                break;
             }
+        default:
+            BUG("Unexpected enumeration value %1%", static_cast<int>(type));
+        }
 
-            if (previousOnly) {
+        if (previousOnly) {
+            std::function<bool(const IR::IDeclaration*)> locationFilter =
+                    [name](const IR::IDeclaration* d) {
                 Util::SourceInfo nsi = name.srcInfo;
-                Util::SourceInfo dsi = decl->getNode()->srcInfo;
+                Util::SourceInfo dsi = d->getNode()->srcInfo;
                 bool before = dsi <= nsi;
                 LOG2("\tPosition test:" << dsi << "<=" << nsi << "=" << before);
-                if (!before)
-                    continue;
+                return before;
+            };
+            decls = decls->where(locationFilter);
+        }
+
+        auto vector = decls->toVector();
+        if (vector->empty())
+            return nullptr;
+        LOG2("Resolved in " << dbp(current->getNode()));
+        return vector;
+    } else {
+        auto simple = current->to<IR::ISimpleNamespace>();
+        auto decl = simple->getDeclByName(name);
+        if (decl == nullptr)
+            return nullptr;
+        switch (type) {
+            case P4::ResolutionType::Any:
+                break;
+            case P4::ResolutionType::Type: {
+                if (!decl->is<IR::Type>())
+                    return nullptr;
+                break;
+            }
+            case P4::ResolutionType::TypeVariable: {
+                if (!decl->is<IR::Type_Var>())
+                    return nullptr;
+                break;
             }
+        default:
+            BUG("Unexpected enumeration value %1%", static_cast<int>(type));
+        }
 
-            LOG2("Resolved in " << dbp(current->getNode()));
-            auto result = new std::vector<const IR::IDeclaration*>();
-            result->push_back(decl);
-            return result;
+        if (previousOnly) {
+            Util::SourceInfo nsi = name.srcInfo;
+            Util::SourceInfo dsi = decl->getNode()->srcInfo;
+            bool before = dsi <= nsi;
+            LOG2("\tPosition test:" << dsi << "<=" << nsi << "=" << before);
+            if (!before)
+                return nullptr;
         }
+
+        LOG2("Resolved in " << dbp(current->getNode()));
+        auto result = new std::vector<const IR::IDeclaration*>();
+        result->push_back(decl);
+        return result;
     }
+}
+
+std::vector<const IR::IDeclaration*>*
+ResolutionContext::resolve(IR::ID name, P4::ResolutionType type, bool previousOnly,
+                           const IR::INamespace** scope) const {
+    static std::vector<const IR::IDeclaration*> empty;
 
+    // Globals shadow everything else; then search from the innermost namespace out.
+    for (auto it = globals.rbegin(); it != globals.rend(); ++it) {
+        if (auto result = lookup(*it, name, type, previousOnly)) {
+            if (scope) *scope = *it;
+            return result; } }
+    for (auto it = stack.rbegin(); it != stack.rend(); ++it) {
+        if (auto result = lookup(*it, name, type, previousOnly)) {
+            if (scope) *scope = *it;
+            return result; } }
     return &empty;
 }
 
@@ -123,8 +129,9 @@ void ResolutionContext::done() {
 const IR::IDeclaration*
 ResolutionContext::resolveUnique(IR::ID name,
                                  P4::ResolutionType type,
-                                 bool previousOnly) const {
-    auto decls = resolve(name, type, previousOnly);
+                                 bool previousOnly,
+                                 const IR::INamespace** scope) const {
+    auto decls = resolve(name, type, previousOnly, scope);
     if (decls->empty()) {
         ::error("Could not find declaration for %1%", name);
         return nullptr;
@@ -170,11 +177,14 @@ ResolveReferences::ResolveReferences(ReferenceMap* refMap,
         refMap(refMap),
         context(nullptr),
         rootNamespace(nullptr),
+        toplevel(nullptr),
+        globalsChanged(false),
         anyOrder(false),
         checkShadow(checkShadow) {
     CHECK_NULL(refMap);
     setName("ResolveReferences");
     visitDagOnce = false;
+    declareComputes(refMap);
 }
 
 void ResolveReferences::addToContext(const IR::INamespace* ns) {
@@ -195,7 +205,7 @@ void ResolveReferences::removeFromContext(const IR::INamespace* ns) {
     context->pop(ns);
 }
 
-void ResolveReferences::resolvePath(const IR::Path* path, bool isType) const {
+void ResolveReferences::resolvePath(const IR::Path* path, bool isType) {
     LOG1("Resolving " << path << " " << (isType ? "as type" : "as identifier"));
     ResolutionContext* ctx = context;
     if (path->absolute)
@@ -205,13 +215,61 @@ void ResolveReferences::resolvePath(const IR::Path* path, bool isType) const {
     BUG_CHECK(!resolveForward.empty(), "Empty resolveForward");
     bool allowForward = resolveForward.back();
 
-    const IR::IDeclaration* decl = ctx->resolveUnique(path->name, k, !allowForward);
+    const IR::INamespace* scope = nullptr;
+    const IR::IDeclaration* decl = ctx->resolveUnique(path->name, k, !allowForward, &scope);
     if (decl == nullptr) {
         refMap->usedName(path->name.name);
         return;
     }
 
     refMap->setDeclaration(path, decl);
+    dependsOn(path->absolute ? 0 : context->level(scope), decl,
+              { path->name, path->name, isType, !allowForward, path->absolute });
+}
+
+void ResolveReferences::dependsOn(size_t level, const IR::IDeclaration* decl,
+                                  const ReferenceMap::Dependence &dep) {
+    // An enclosing declaration can only be kept if this resolves the same way
+    for (auto it = units.rbegin(); it != units.rend() && level < it->second; ++it)
+        ReferenceMap::dependsOn(it->first, decl, dep);
+}
+
+bool ResolveReferences::isTracked() const {
+    auto parent = getCurrentNode();
+    if (parent == toplevel)
+        return true;
+    if (getContext() == nullptr)
+        return false;
+    auto container = getContext()->node;
+    if (auto control = container->to<IR::P4Control>())
+        return parent == control->controlLocals;
+    if (auto parser = container->to<IR::P4Parser>())
+        return parent == parser->parserLocals || parent == parser->states;
+    return false;
+}
+
+bool ResolveReferences::unchanged(const IR::Node* decl) {
+    auto it = refMap->resolved.find(decl);
+    if (it == refMap->resolved.end() || !it->second.reusable)
+        return false;
+    auto root = new ResolutionContext(rootNamespace);
+    std::vector<size_t> levels;
+    for (auto &dep : it->second.dependences) {
+        auto ctx = dep.second.absolute ? root : context;
+        auto type = dep.second.isType ? ResolutionType::Type : ResolutionType::Any;
+        const IR::INamespace* scope = nullptr;
+        for (auto name : { dep.second.first, dep.second.last }) {
+            auto decls = ctx->resolve(name, type, dep.second.previousOnly, &scope);
+            if (decls->size() != 1 || decls->at(0) != dep.first.first)
+                return false;
+            if (!dep.second.previousOnly)
+                break; }
+        levels.push_back(dep.second.absolute ? 0 : context->level(scope));
+    }
+    auto level = levels.begin();
+    for (auto &dep : it->second.dependences)
+        dependsOn(*level++, dep.first.first, dep.second);
+    return true;
 }
 
 void ResolveReferences::checkShadowing(const IR::INamespace* ns) const {
@@ -243,11 +301,37 @@ void ResolveReferences::checkShadowing(const IR::INamespace* ns) const {
 
 Visitor::profile_t ResolveReferences::init_apply(const IR::Node* node) {
     anyOrder = refMap->isV1();
-    if (!refMap->checkMap(node))
-        refMap->clear();
+    if (!refMap->checkMap(node)) {
+        // Shadowing warnings are only given for the declarations that are resolved
+        if (checkShadow || !refMap->canUpdate() || !node->is<IR::P4Program>())
+            refMap->clear();
+        else
+            refMap->update(node->to<IR::P4Program>());
+    }
     return Inspector::init_apply(node);
 }
 
+const IR::Node* ResolveReferences::apply_visitor(const IR::Node* n, const char* name) {
+    if (n == nullptr || toplevel == nullptr || !isTracked())
+        return Inspector::apply_visitor(n, name);
+    if (n->is<IR::Declaration_MatchKind>()) {
+        // Always visited, to add the globals; a new match_kind may hide
+        // declarations in the ones that follow.
+        if (!refMap->resolved.count(n))
+            globalsChanged = true;
+    } else if (!checkShadow && !globalsChanged && unchanged(n)) {
+        LOG1("Keeping references in " << dbp(n));
+        return n;
+    }
+    auto errors = ::errorCount();
+    auto outer = refMap->startResolving(n);
+    units.emplace_back(refMap->current, context->depth());
+    auto result = Inspector::apply_visitor(n, name);
+    units.pop_back();
+    refMap->endResolving(outer, ::errorCount() == errors);
+    return result;
+}
+
 void ResolveReferences::end_apply(const IR::Node* node) {
     refMap->updateMap(node);
 }
@@ -263,12 +347,15 @@ bool ResolveReferences::preorder(const IR::P4Program* program) {
     resolveForward.push_back(anyOrder);
     BUG_CHECK(rootNamespace == nullptr, "Root namespace already set");
     rootNamespace = program;
+    toplevel = program->declarations;
+    globalsChanged = false;
     context = new ResolutionContext(rootNamespace);
     return true;
 }
 
 void ResolveReferences::postorder(const IR::P4Program*) {
     rootNamespace = nullptr;
+    toplevel = nullptr;
     context->done();
     resolveForward.pop_back();
     BUG_CHECK(resolveForward.empty(), "Expected empty resolvePath");
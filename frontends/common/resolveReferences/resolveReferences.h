@@ -17,6 +17,8 @@ limitations under the License.
 #ifndef _COMMON_RESOLVEREFERENCES_RESOLVEREFERENCES_H_
 #define _COMMON_RESOLVEREFERENCES_RESOLVEREFERENCES_H_
 
+#include <algorithm>
+
 #include "ir/ir.h"
 #include "referenceMap.h"
 #include "lib/exceptions.h"
@@ -34,6 +36,11 @@ class ResolutionContext : public IHasDbPrint {
     const IR::INamespace* rootNamespace;
     std::vector<const IR::INamespace*> globals;  // match_kind
 
+    // Declarations matching name in a single namespace; nullptr if there are none
+    std::vector<const IR::IDeclaration*>*
+    lookup(const IR::INamespace* current, IR::ID name, ResolutionType type,
+           bool previousOnly) const;
+
  public:
     explicit ResolutionContext(const IR::INamespace* rootNamespace) :
             rootNamespace(rootNamespace)
@@ -60,12 +67,21 @@ class ResolutionContext : public IHasDbPrint {
     // Resolve a reference for the specified name.
     // The reference is restricted to be to an object of the specified type
     // If previousOnly is true, the reference must precede the point of the 'name' in the program
+    // If scope is not null, it is set to the namespace the declarations were found in
     std::vector<const IR::IDeclaration*>*
-    resolve(IR::ID name, ResolutionType type, bool previousOnly) const;
+    resolve(IR::ID name, ResolutionType type, bool previousOnly,
+            const IR::INamespace** scope = nullptr) const;
 
     // Resolve a reference for the specified name; expect a single result
     const IR::IDeclaration*
-    resolveUnique(IR::ID name, ResolutionType type, bool previousOnly) const;
+    resolveUnique(IR::ID name, ResolutionType type, bool previousOnly,
+                  const IR::INamespace** scope = nullptr) const;
+
+    size_t depth() const { return stack.size(); }
+    // Position of ns on the stack; 0 (the root namespace) for globals
+    size_t level(const IR::INamespace* ns) const {
+        auto it = std::find(stack.rbegin(), stack.rend(), ns);
+        return it == stack.rend() ? 0 : stack.rend() - it - 1; }
 
     // Resolve a Type_Name to a concrete type
     const IR::Type *resolveType(const IR::Type *type) const;
@@ -74,11 +90,20 @@ class ResolutionContext : public IHasDbPrint {
 // No prerequisites, but it usually must be run over the whole program.
 // Builds output in refMap.
 // The ReferenceMap maps each Path to a declaration.
-class ResolveReferences : public Inspector {
+// When refMap holds the results for an earlier version of the program,
+// only the declarations that changed (or that refer to declarations that
+// changed) are resolved again; this is tracked for top-level declarations
+// and for the declarations local to parsers and controls.
+class ResolveReferences : public Inspector, public AnalysisUsage {
     // Output: reference map
     ReferenceMap* refMap;
     ResolutionContext* context;
     const IR::INamespace* rootNamespace;
+    const IR::Node* toplevel;  // program declarations
+    bool globalsChanged;
+    // Declarations tracked in refMap that enclose the current node, with the
+    // context depth at their start
+    std::vector<std::pair<ReferenceMap::Resolved*, size_t>> units;
     // used as a stack
     std::vector<bool> resolveForward;  // if true allow resolution with declarations that follow use
     bool anyOrder;
@@ -88,7 +113,16 @@ class ResolveReferences : public Inspector {
     void addToContext(const IR::INamespace* ns);
     void removeFromContext(const IR::INamespace* ns);
     void addToGlobals(const IR::INamespace* ns);
-    void resolvePath(const IR::Path* path, bool isType) const;
+    void resolvePath(const IR::Path* path, bool isType);
+    // True if the node about to be visited is a declaration tracked in refMap
+    bool isTracked() const;
+    // True if decl was resolved before and its references outside itself still
+    // resolve to the same declarations.
+    bool unchanged(const IR::Node* decl);
+    // Records in the enclosing declarations that they depend on decl, found
+    // at the given context level.
+    void dependsOn(size_t level, const IR::IDeclaration* decl,
+                   const ReferenceMap::Dependence &dep);
 
  public:
     explicit ResolveReferences(/* out */ P4::ReferenceMap* refMap,
@@ -96,6 +130,7 @@ class ResolveReferences : public Inspector {
 
     Visitor::profile_t init_apply(const IR::Node* node) override;
     void end_apply(const IR::Node* node) override;
+    const IR::Node* apply_visitor(const IR::Node* n, const char* name = 0) override;
     using Inspector::preorder;
     using Inspector::postorder;
 
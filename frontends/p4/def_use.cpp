@@ -26,10 +26,68 @@ namespace P4 {
 // name for header valid bit
 const cstring StorageFactory::validFieldName = "$valid";
 const cstring StorageFactory::indexFieldName = "$lastIndex";
-const LocationSet* LocationSet::empty = new LocationSet();
+
+namespace {
+template<class T1, class T2, class V>
+using PairMap = flat_hash_map<std::pair<T1, T2>, V, boost::hash<std::pair<T1, T2>>>;
+}  // namespace
+
+// The interned sets of one StorageFactory, and the memoized operations on them
+class LocationSetTables {
+    struct Hash { std::size_t operator()(const LocationSet* set) const { return set->hashValue; } };
+    struct Equal { bool operator()(const LocationSet* left, const LocationSet* right) const
+        { return left->locations == right->locations; } };
+
+ public:
+    std::unordered_set<const LocationSet*, Hash, Equal> sets;
+    PairMap<const LocationSet*, const LocationSet*, const LocationSet*> joins;
+    PairMap<const LocationSet*, const char*, const LocationSet*> fields;
+
+    const LocationSet* intern(LocationSet* set) {
+        std::size_t hash = 0;
+        boost::hash_range(hash, set->locations.begin(), set->locations.end());
+        set->hashValue = hash;
+        auto it = sets.emplace(set);
+        if (it.second)
+            set->interned = true;
+        return *it.first;
+    }
+};
+
+const LocationSet* LocationSet::empty = LocationSet::intern(new LocationSet());
 ProgramPoint ProgramPoint::beforeStart;
 
+LocationSetTables* LocationSet::tables() const {
+    auto tables = (*locations.begin())->tables;
+    BUG_CHECK(tables != nullptr, "%1%: location not created by a StorageFactory",
+              *locations.begin());
+    return tables;
+}
+
+const LocationSet* LocationSet::intern(LocationSet* set) {
+    if (set->interned)
+        return set;
+    if (set->locations.empty()) {
+        if (empty != nullptr)
+            return empty;
+        set->interned = true;  // this is empty
+        return set;
+    }
+    return set->tables()->intern(set);
+}
+
+StorageFactory::StorageFactory(TypeMap* typeMap) :
+        typeMap(typeMap), tables(new LocationSetTables)
+{ CHECK_NULL(typeMap); }
+
 StorageLocation* StorageFactory::create(const IR::Type* type, cstring name) const {
+    auto result = createLocation(type, name);
+    if (result != nullptr)
+        result->tables = tables;
+    return result;
+}
+
+StorageLocation* StorageFactory::createLocation(const IR::Type* type, cstring name) const {
     if (type->is<IR::Type_Bits>() ||
         type->is<IR::Type_Boolean>() ||
         type->is<IR::Type_Varbits>() ||
@@ -73,7 +131,7 @@ StorageLocation* StorageFactory::create(const IR::Type* type, cstring name) cons
 const LocationSet* StorageLocation::removeHeaders() const {
     auto result = new LocationSet();
     removeHeaders(result);
-    return result;
+    return LocationSet::intern(result);
 }
 
 void BaseLocation::removeHeaders(LocationSet* result) const
@@ -123,25 +181,35 @@ void ArrayLocation::addElement(unsigned index, LocationSet* result) const {
 const LocationSet* StorageLocation::getValidBits() const {
     auto result = new LocationSet();
     addValidBits(result);
-    return result;
+    return LocationSet::intern(result);
 }
 
 const LocationSet* StorageLocation::getLastIndexField() const {
     auto result = new LocationSet();
     addLastIndexField(result);
-    return result;
+    return LocationSet::intern(result);
 }
 
 const LocationSet* LocationSet::join(const LocationSet* other) const {
     CHECK_NULL(other);
     if (this == LocationSet::empty)
         return other;
-    if (other == LocationSet::empty)
+    if (other == LocationSet::empty || other == this)
         return this;
+    if (!interned || !other->interned)
+        return intern(new LocationSet(locations))->join(intern(new LocationSet(other->locations)));
+    // join is symmetric: memoize on the ordered pair
+    auto key = this < other ? std::make_pair(this, other) : std::make_pair(other, this);
+    auto tables = this->tables();
+    auto memo = tables->joins.find(key);
+    if (memo != tables->joins.end())
+        return memo->second;
     auto result = new LocationSet(locations);
     for (auto e : other->locations)
         result->add(e);
-    return result;
+    auto joined = tables->intern(result);
+    tables->joins.emplace(key, joined);
+    return joined;
 }
 
 const LocationSet* LocationSet::getArrayLastIndex() const {
@@ -152,11 +220,20 @@ const LocationSet* LocationSet::getArrayLastIndex() const {
             result->add(array->getLastIndexField());
         }
     }
-    return result;
+    return intern(result);
 }
 
 
 const LocationSet* LocationSet::getField(cstring field) const {
+    if (isEmpty())
+        return empty;
+    auto key = std::make_pair(this, field.c_str());
+    auto tables = this->tables();
+    if (interned) {
+        auto memo = tables->fields.find(key);
+        if (memo != tables->fields.end())
+            return memo->second;
+    }
     auto result = new LocationSet();
     for (auto l : locations) {
         if (l->is<StructLocation>()) {
@@ -169,7 +246,10 @@ const LocationSet* LocationSet::getField(cstring field) const {
                 f->to<StructLocation>()->addField(field, result);
         }
     }
-    return result;
+    auto interned = intern(result);
+    if (this->interned)
+        tables->fields.emplace(key, interned);
+    return interned;
 }
 
 const LocationSet* LocationSet::getValidField() const
@@ -181,7 +261,7 @@ const LocationSet* LocationSet::getIndex(unsigned index) const {
         auto array = l->to<ArrayLocation>();
         array->addElement(index, result);
     }
-    return result;
+    return intern(result);
 }
 
 const LocationSet* LocationSet::allElements() const {
@@ -191,14 +271,23 @@ const LocationSet* LocationSet::allElements() const {
         for (auto e : *array)
             result->add(e);
     }
-    return result;
+    return intern(result);
 }
 
 const LocationSet* LocationSet::canonicalize() const {
+    if (canonical != nullptr)
+        return canonical;
+    if (isEmpty())
+        return empty;
     LocationSet* result = new LocationSet();
     for (auto e : locations)
         result->addCanonical(e);
-    return result;
+    auto canon = intern(result);
+    if (interned) {
+        canonical = canon;
+        canon->canonical = canon;
+    }
+    return canon;
 }
 
 void LocationSet::addCanonical(const StorageLocation* location) {
@@ -230,25 +319,42 @@ const ProgramPoints* ProgramPoints::merge(const ProgramPoints* with) const {
     return result;
 }
 
-ProgramPoint::ProgramPoint(const ProgramPoint &context, const IR::Node* node) {
-    for (auto e : context.stack)
-        stack.push_back(e);
-    stack.push_back(node);
+const ProgramPoint::Frame* ProgramPoint::push(const Frame* context, const IR::Node* node) {
+    CHECK_NULL(node);
+    std::size_t hash = context == nullptr ? 0 : context->hash;
+    boost::hash_combine(hash, node);
+    return new Frame{context, node, hash};
 }
 
-bool ProgramPoint::operator==(const ProgramPoint& other) const {
-    if (stack.size() != other.stack.size())
-        return false;
-    for (unsigned i=0; i < stack.size(); i++)
-        if (stack.at(i) != other.stack.at(i))
+bool ProgramPoint::equal(const Frame* left, const Frame* right) {
+    for (; left != right; left = left->context, right = right->context) {
+        if (left == nullptr || right == nullptr)
+            return false;
+        if (left->hash != right->hash || left->node != right->node)
             return false;
+    }
     return true;
 }
 
-std::size_t ProgramPoint::hash() const {
-    std::size_t result = 0;
-    boost::hash_range(result, stack.begin(), stack.end());
-    return result;
+void ProgramPoint::dbprint(std::ostream& out) const {
+    if (isBeforeStart()) {
+        out << "<BeforeStart>";
+        return;
+    }
+    std::vector<const IR::Node*> stack;
+    for (auto f = frame; f != nullptr; f = f->context)
+        stack.push_back(f->node);
+    bool first = true;
+    for (auto n = stack.rbegin(); n != stack.rend(); ++n) {
+        if (!first)
+            out << "//";
+        out << dbp(*n);
+        first = false;
+    }
+    auto l = last();
+    if (l->is<IR::AssignmentStatement>() ||
+        l->is<IR::MethodCallStatement>())
+        out << "[[" << l << "]]";
 }
 
 bool ProgramPoints::operator==(const ProgramPoints& other) const {
@@ -260,83 +366,118 @@ bool ProgramPoints::operator==(const ProgramPoints& other) const {
     return true;
 }
 
-Definitions* Definitions::join(const Definitions* other) const {
-    auto result = new Definitions();
-    for (auto d : other->definitions) {
-        auto loc = d.first;
-        auto defs = d.second;
-        auto current = ::get(definitions, loc);
-        if (current != nullptr) {
-            auto merged = current->merge(defs);
-            result->definitions.emplace(loc, merged);
-        } else {
-            result->definitions.emplace(loc, defs);
-        }
+unsigned DefinitionNumbering::point(const ProgramPoint& point) {
+    auto it = pointIds.emplace(point, points.size());
+    if (it.second)
+        points.push_back(point);
+    return it.first->second;
+}
+
+unsigned DefinitionNumbering::location(const BaseLocation* location) {
+    auto it = locationIds.emplace(location, locations.size());
+    if (it.second) {
+        locations.push_back(location);
+        definers.emplace_back();
     }
-    for (auto d : definitions) {
-        auto loc = d.first;
-        auto defs = d.second;
-        auto current = ::get(other->definitions, loc);
-        if (current == nullptr)
-            result->definitions.emplace(loc, defs);
-        // otherwise have have already done it in the loop above
+    return it.first->second;
+}
+
+unsigned DefinitionNumbering::definition(unsigned point, unsigned location) {
+    uint64_t key = (static_cast<uint64_t>(point) + 1) << 32 | location;
+    auto it = definitionIds.emplace(key, pointOf.size());
+    if (it.second) {
+        pointOf.push_back(point);
+        definers.at(location).push_back(it.first->second);
     }
+    return it.first->second;
+}
+
+Definitions* Definitions::join(const Definitions* other) const {
+    auto result = new Definitions(*this);
+    result->reaching |= other->reaching;
     return result;
 }
 
-void Definitions::set(const StorageLocation* location, const ProgramPoints* point) {
+void Definitions::set(unsigned location, unsigned point) {
+    unsigned def = numbering->definition(point, location);
+    for (auto d : numbering->definitionsOf(location))
+        reaching.clrbit(d);
+    reaching.setbit(def);
+}
+
+void Definitions::set(const BaseLocation* location, const ProgramPoint& point) {
+    CHECK_NULL(location);
+    set(numbering->location(location), numbering->point(point));
+}
+
+void Definitions::set(const StorageLocation* location, const ProgramPoint& point) {
     LocationSet locset;
     locset.addCanonical(location);
-    for (auto sl : locset)
-        definitions[sl->to<BaseLocation>()] = point;
+    set(&locset, point);
 }
 
-void Definitions::set(const LocationSet* locations, const ProgramPoints* point) {
+void Definitions::set(const LocationSet* locations, const ProgramPoint& point) {
+    unsigned pt = numbering->point(point);
     for (auto sl : *locations->canonicalize())
-        definitions[sl->to<BaseLocation>()] = point;
+        set(numbering->location(sl->to<BaseLocation>()), pt);
 }
 
 void Definitions::remove(const StorageLocation* location) {
     auto loc = new LocationSet();
     loc->addCanonical(location);
-    for (auto sl : *loc) {
-        auto bl = sl->to<BaseLocation>();
-        auto it = definitions.find(bl);
-        if (it != definitions.end())
-            definitions.erase(it);
+    for (auto sl : *loc)
+        for (auto d : numbering->definitionsOf(numbering->location(sl->to<BaseLocation>())))
+            reaching.clrbit(d);
+}
+
+// Adds the program points of the definitions of location that reach here;
+// returns false if there are none.
+bool Definitions::addPoints(unsigned location, ProgramPoints* result) const {
+    bool found = false;
+    for (auto d : numbering->definitionsOf(location)) {
+        if (reaching.getbit(d)) {
+            result->add(numbering->getPoint(d));
+            found = true;
+        }
     }
+    return found;
+}
+
+const ProgramPoints* Definitions::get(const BaseLocation* location) const {
+    auto result = new ProgramPoints();
+    bool found = addPoints(numbering->location(location), result);
+    BUG_CHECK(found, "%1%: no definitions", location);
+    return result;
 }
 
 const ProgramPoints* Definitions::get(const LocationSet* locations) const {
-    const ProgramPoints* result = new ProgramPoints();
+    auto result = new ProgramPoints();
     for (auto sl : *locations->canonicalize()) {
-        auto points = get(sl->to<BaseLocation>());
-        result = result->merge(points);
+        bool found = addPoints(numbering->location(sl->to<BaseLocation>()), result);
+        BUG_CHECK(found, "%1%: no definitions", sl);
     }
     return result;
 }
 
 Definitions* Definitions::writes(ProgramPoint point, const LocationSet* locations) const {
     auto result = new Definitions(*this);
-    auto points = new ProgramPoints();
-    points->add(point);
-    auto canon = locations->canonicalize();
-    for (auto l : *canon)
-        result->set(l->to<BaseLocation>(), points);
+    result->set(locations, point);
     return result;
 }
 
-bool Definitions::operator==(const Definitions& other) const {
-    if (definitions.size() != other.definitions.size())
-        return false;
-    for (auto d : definitions) {
-        auto od = ::get(other.definitions, d.first);
-        if (od == nullptr)
-            return false;
-        if (!d.second->operator==(*od))
-            return false;
+void Definitions::dbprint(std::ostream& out) const {
+    if (reaching.empty())
+        out << "  Empty definitions";
+    bool first = true;
+    for (unsigned loc = 0; loc < numbering->locationCount(); loc++) {
+        ProgramPoints points;
+        if (!addPoints(loc, &points))
+            continue;
+        if (!first)
+            out << std::endl;
+        out << "  " << *numbering->getLocation(loc) << "=>" << points;
+        first = false;
     }
-    return true;
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////
@@ -352,10 +493,7 @@ void ComputeWriteSet::enterScope(const IR::ParameterList* parameters,
     if (!clear)
         defs = currentDefinitions;
     if (defs == nullptr)
-        defs = new Definitions();
-
-    auto startPoints = new ProgramPoints(entryPoint);
-    auto uninit = new ProgramPoints(ProgramPoint::beforeStart);
+        defs = new Definitions(definitions->numbering);
 
     if (parameters != nullptr) {
         for (auto p : *parameters->parameters) {
@@ -365,13 +503,13 @@ void ComputeWriteSet::enterScope(const IR::ParameterList* parameters,
             if (p->direction == IR::Direction::In ||
                 p->direction == IR::Direction::InOut ||
                 p->direction == IR::Direction::None)
-                defs->set(loc, startPoints);
+                defs->set(loc, entryPoint);
             else if (p->direction == IR::Direction::Out)
-                defs->set(loc, uninit);
+                defs->set(loc, ProgramPoint::beforeStart);
             auto valid = loc->getValidBits();
-            defs->set(valid, startPoints);
+            defs->set(valid, entryPoint);
             auto lastIndex = loc->getLastIndexField();
-            defs->set(lastIndex, startPoints);
+            defs->set(lastIndex, entryPoint);
         }
     }
     if (locals != nullptr) {
@@ -379,11 +517,11 @@ void ComputeWriteSet::enterScope(const IR::ParameterList* parameters,
             if (d->is<IR::Declaration_Variable>()) {
                 StorageLocation* loc = definitions->storageMap->add(d);
                 if (loc != nullptr) {
-                    defs->set(loc, uninit);
+                    defs->set(loc, ProgramPoint::beforeStart);
                     auto valid = loc->getValidBits();
-                    defs->set(valid, startPoints);
+                    defs->set(valid, entryPoint);
                     auto lastIndex = loc->getLastIndexField();
-                    defs->set(lastIndex, startPoints);
+                    defs->set(lastIndex, entryPoint);
                 }
             }
         }
@@ -487,7 +625,7 @@ bool ComputeWriteSet::preorder(const IR::PathExpression* expression) {
     auto storage = storageMap->getStorage(decl);
     const LocationSet* result;
     if (storage != nullptr)
-        result = new LocationSet(storage);
+        result = LocationSet::intern(new LocationSet(storage));
     else
         result = LocationSet::empty;
     set(expression, result);
@@ -736,8 +874,8 @@ bool ComputeWriteSet::preorder(const IR::P4Control* control) {
     LOG3("CWS Visiting " << dbp(control));
     auto startPoint = ProgramPoint(control);
     enterScope(control->type->applyParams, control->controlLocals, startPoint);
-    exitDefinitions = new Definitions();
-    returnedDefinitions = new Definitions();
+    exitDefinitions = new Definitions(definitions->numbering);
+    returnedDefinitions = new Definitions(definitions->numbering);
     for (auto l : *control->controlLocals) {
         if (l->is<IR::Declaration_Instance>())
             visit(l);  // process virtual Functions if any
@@ -773,13 +911,13 @@ bool ComputeWriteSet::preorder(const IR::ReturnStatement* statement) {
         visit(statement->expression);
     returnedDefinitions = returnedDefinitions->join(currentDefinitions);
     LOG3("Return definitions " << returnedDefinitions);
-    return setDefinitions(new Definitions());
+    return setDefinitions(new Definitions(definitions->numbering));
 }
 
 bool ComputeWriteSet::preorder(const IR::ExitStatement*) {
     exitDefinitions = exitDefinitions->join(currentDefinitions);
     LOG3("Exit definitions " << exitDefinitions);
-    return setDefinitions(new Definitions());
+    return setDefinitions(new Definitions(definitions->numbering));
 }
 
 bool ComputeWriteSet::preorder(const IR::EmptyStatement*) {
@@ -807,7 +945,7 @@ bool ComputeWriteSet::preorder(const IR::SwitchStatement* statement) {
     auto defs = currentDefinitions->writes(getProgramPoint(), locs);
     (void)setDefinitions(defs, statement->expression);
     auto save = currentDefinitions;
-    auto result = new Definitions();
+    auto result = new Definitions(definitions->numbering);
     bool seenDefault = false;
     for (auto s : statement->cases) {
         currentDefinitions = save;
@@ -830,7 +968,7 @@ bool ComputeWriteSet::preorder(const IR::SwitchStatement* statement) {
 bool ComputeWriteSet::preorder(const IR::P4Action* action) {
     LOG3("CWS Visiting " << dbp(action));
     auto saveReturned = returnedDefinitions;
-    returnedDefinitions = new Definitions();
+    returnedDefinitions = new Definitions(definitions->numbering);
 
     auto decls = new IR::IndexedVector<IR::Declaration>();
     // We assume that there are no declarations in inner scopes
@@ -871,7 +1009,7 @@ bool ComputeWriteSet::preorder(const IR::Function* function) {
     auto saveReturned = returnedDefinitions;
 
     enterScope(function->type->parameters, locals, point, false);
-    returnedDefinitions = new Definitions();
+    returnedDefinitions = new Definitions(definitions->numbering);
     visit(function->body);
     currentDefinitions = currentDefinitions->join(returnedDefinitions);
     definitions->set(callingContext, currentDefinitions);
@@ -888,7 +1026,7 @@ bool ComputeWriteSet::preorder(const IR::P4Table* table) {
     enterScope(nullptr, nullptr, pt, false);
 
     // non-deterministic call of one of the actions in the table
-    auto after = new Definitions();
+    auto after = new Definitions(definitions->numbering);
     auto beforeTable = currentDefinitions;
     auto actions = table->getActionList();
     for (auto ale : *actions->actionList) {
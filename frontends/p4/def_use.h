@@ -18,15 +18,23 @@ limitations under the License.
 #define _FRONTENDS_P4_DEF_USE_H_
 
 #include "ir/ir.h"
+#include "lib/bitvec.h"
+#include "lib/flat_hash.h"
 #include "frontends/p4/typeChecking/typeChecker.h"
 
 namespace P4 {
 
 class StorageFactory;
 class LocationSet;
+class LocationSetTables;
 
 // Abstraction for something that is has a left value (variable, parameter)
 class StorageLocation : public IHasDbPrint {
+    // The interned sets of the analysis whose StorageFactory created this
+    LocationSetTables* tables = nullptr;
+    friend class StorageFactory;
+    friend class LocationSet;
+
  public:
     virtual ~StorageLocation() {}
     const IR::Type* type;
@@ -132,11 +140,15 @@ class ArrayLocation : public StorageLocation {
     void addLastIndexField(LocationSet* result) const override;
 };
 
+// Each factory has its own table of interned LocationSets, which live as
+// long as the locations it creates.  A factory must not be used by several
+// threads at once.
 class StorageFactory {
     TypeMap* typeMap;
+    LocationSetTables* tables;
+    StorageLocation* createLocation(const IR::Type* type, cstring name) const;
  public:
-    explicit StorageFactory(TypeMap* typeMap) : typeMap(typeMap)
-    { CHECK_NULL(typeMap); }
+    explicit StorageFactory(TypeMap* typeMap);
     StorageLocation* create(const IR::Type* type, cstring name) const;
 
     static const cstring validFieldName;
@@ -145,14 +157,27 @@ class StorageFactory {
 
 // A set of locations that may be read or written by a computation.
 // In general this is a conservative approximation of the actual location set.
+// The sets returned by the operations below are interned in the tables of
+// the StorageFactory that created their locations: equal sets are the same
+// object, so the results of join, canonicalize and getField can be
+// memoized.  An interned set must not be modified.
 class LocationSet : public IHasDbPrint {
     std::set<const StorageLocation*> locations;
+    mutable std::size_t hashValue = 0;
+    bool interned = false;
+    mutable const LocationSet* canonical = nullptr;  // memoized canonicalize()
+    friend class LocationSetTables;
+
+    LocationSetTables* tables() const;
 
  public:
     LocationSet() = default;
     explicit LocationSet(const std::set<const StorageLocation*> &other) : locations(other) {}
     explicit LocationSet(const StorageLocation* location) { locations.emplace(location); }
     static const LocationSet* empty;
+    // The unique set equal to set; set is not modified any more.
+    // All locations in a set must come from the same StorageFactory.
+    static const LocationSet* intern(LocationSet* set);
 
     const LocationSet* getField(cstring field) const;
     const LocationSet* getValidField() const;
@@ -160,8 +185,9 @@ class LocationSet : public IHasDbPrint {
     const LocationSet* allElements() const;
     const LocationSet* getArrayLastIndex() const;
 
-    void add(const StorageLocation* location)
-    { locations.emplace(location); }
+    void add(const StorageLocation* location) {
+        BUG_CHECK(!interned, "Modifying an interned location set");
+        locations.emplace(location); }
     const LocationSet* join(const LocationSet* other) const;
     // express this location set only in terms of BaseLocation;
     // e.g., a StructLocation is expanded in all its fields.
@@ -218,39 +244,34 @@ class StorageMap {
 // Indicates a statement in the program.
 // The stack is for representing calls: i.e.,
 // table.apply() -> table -> action
+// Stacks are immutable linked frames that carry their hash, so copying
+// program points and hashing them does not depend on the depth of the stack;
+// points built separately for the same stack are compared frame by frame.
 class ProgramPoint : public IHasDbPrint {
-    // empty stack represents "beforeStart" (see below)
-    std::vector<const IR::Node*> stack;
+    struct Frame {
+        const Frame*     context;  // rest of the stack
+        const IR::Node*  node;     // top of the stack
+        std::size_t      hash;
+    };
+    // nullptr represents "beforeStart" (see below)
+    const Frame* frame = nullptr;
+    static const Frame* push(const Frame* context, const IR::Node* node);
+    static bool equal(const Frame* left, const Frame* right);
 
  public:
     ProgramPoint() = default;
-    ProgramPoint(const ProgramPoint& other) : stack(other.stack) {}
-    explicit ProgramPoint(const IR::Node* node) { stack.push_back(node); }
-    ProgramPoint(const ProgramPoint& context, const IR::Node* node);
+    explicit ProgramPoint(const IR::Node* node) : frame(push(nullptr, node)) {}
+    ProgramPoint(const ProgramPoint& context, const IR::Node* node)
+            : frame(push(context.frame, node)) {}
     static ProgramPoint beforeStart;  // a point logically before the program start
-    bool operator==(const ProgramPoint& other) const;
-    std::size_t hash() const;
-    void dbprint(std::ostream& out) const {
-        if (isBeforeStart()) {
-            out << "<BeforeStart>";
-        } else {
-            bool first = true;
-            for (auto n : stack) {
-                if (!first)
-                    out << "//";
-                out << dbp(n);
-                first = false;
-            }
-            auto l = stack.back();
-            if (l->is<IR::AssignmentStatement>() ||
-                l->is<IR::MethodCallStatement>())
-                out << "[[" << l << "]]";
-        }
-    }
+    bool operator==(const ProgramPoint& other) const
+    { return frame == other.frame || equal(frame, other.frame); }
+    std::size_t hash() const { return frame == nullptr ? 0 : frame->hash; }
+    void dbprint(std::ostream& out) const;
     const IR::Node* last() const
-    { return stack.empty() ? nullptr : stack.back(); }
+    { return frame == nullptr ? nullptr : frame->node; }
     bool isBeforeStart() const
-    { return stack.empty(); }
+    { return frame == nullptr; }
 };
 }  // namespace P4
 
@@ -291,42 +312,63 @@ class ProgramPoints : public IHasDbPrint {
     { return points.cend(); }
 };
 
-// List of definers for each base storage (at a specific program point)
+// Dense numbering used by the reaching definitions analysis.  Program
+// points and base locations are numbered as they are seen, and so is each
+// definition: a pair (program point, base location written at that point).
+class DefinitionNumbering {
+    std::unordered_map<ProgramPoint, unsigned> pointIds;
+    std::vector<ProgramPoint> points;
+    flat_hash_map<const BaseLocation*, unsigned> locationIds;
+    std::vector<const BaseLocation*> locations;
+    // key is (point + 1) << 32 | location, so that it is never 0
+    flat_hash_map<uint64_t, unsigned> definitionIds;
+    std::vector<unsigned> pointOf;  // program point of each definition
+    std::vector<std::vector<unsigned>> definers;  // definitions of each location
+
+ public:
+    unsigned point(const ProgramPoint& point);
+    unsigned location(const BaseLocation* location);
+    unsigned definition(unsigned point, unsigned location);
+    const ProgramPoint& getPoint(unsigned definition) const
+    { return points.at(pointOf.at(definition)); }
+    const BaseLocation* getLocation(unsigned location) const
+    { return locations.at(location); }
+    const std::vector<unsigned>& definitionsOf(unsigned location) const
+    { return definers.at(location); }
+    unsigned locationCount() const { return locations.size(); }
+};
+
+// List of definers for each base storage (at a specific program point).
+// This is the set of definitions that reach the program point, as a bit vector
+// indexed by definition number; a write kills all definitions of the locations
+// written and generates one definition for each.
 class Definitions : public IHasDbPrint {
-    // which program points have written last to each location
+    DefinitionNumbering* numbering;
+    // which definitions are the last writes to their location
     // (conservative approximation)
-    std::map<const BaseLocation*, const ProgramPoints*> definitions;
+    bitvec reaching;
+
+    void set(unsigned location, unsigned point);
+    bool addPoints(unsigned location, ProgramPoints* result) const;
 
  public:
-    Definitions() = default;
-    Definitions(const Definitions& other) : definitions(other.definitions) {}
+    explicit Definitions(DefinitionNumbering* numbering) : numbering(numbering)
+    { CHECK_NULL(numbering); }
+    Definitions(const Definitions& other) = default;
     Definitions* join(const Definitions* other) const;
     // point writes the specified LocationSet
     Definitions* writes(ProgramPoint point, const LocationSet* locations) const;
-    void set(const BaseLocation* loc, const ProgramPoints* point)
-    { CHECK_NULL(loc); CHECK_NULL(point); definitions[loc] = point; }
-    void set(const StorageLocation* loc, const ProgramPoints* point);
-    void set(const LocationSet* loc, const ProgramPoints* point);
-    const ProgramPoints* get(const BaseLocation* location) const {
-        auto r = ::get(definitions, location);
-        BUG_CHECK(r != nullptr, "%1%: no definitions", location);
-        return r; }
+    void set(const BaseLocation* loc, const ProgramPoint& point);
+    void set(const StorageLocation* loc, const ProgramPoint& point);
+    void set(const LocationSet* loc, const ProgramPoint& point);
+    const ProgramPoints* get(const BaseLocation* location) const;
     const ProgramPoints* get(const LocationSet* locations) const;
-    bool operator==(const Definitions& other) const;
-    void dbprint(std::ostream& out) const {
-        if (definitions.empty())
-            out << "  Empty definitions";
-        bool first = true;
-        for (auto d : definitions) {
-            if (!first)
-                out << std::endl;
-            out << "  " << *d.first << "=>" << *d.second;
-            first = false;
-        }
-    }
+    bool operator==(const Definitions& other) const
+    { return reaching == other.reaching; }
+    void dbprint(std::ostream& out) const;
     Definitions* clone() const { return new Definitions(*this); }
     void remove(const StorageLocation* loc);
-    bool empty() const { return definitions.empty(); }
+    bool empty() const { return reaching.empty(); }
 };
 
 class AllDefinitions : public IHasDbPrint {
@@ -337,13 +379,15 @@ class AllDefinitions : public IHasDbPrint {
 
  public:
     StorageMap* storageMap;
+    DefinitionNumbering* numbering;
     AllDefinitions(ReferenceMap* refMap, TypeMap* typeMap) :
-            storageMap(new StorageMap(refMap, typeMap)) {}
+            storageMap(new StorageMap(refMap, typeMap)),
+            numbering(new DefinitionNumbering()) {}
     Definitions* get(ProgramPoint point, bool emptyIfNotFound = false) {
         auto it = atPoint.find(point);
         if (it == atPoint.end()) {
             if (emptyIfNotFound) {
-                auto defs = new Definitions();
+                auto defs = new Definitions(numbering);
                 set(point, defs);
                 return defs;
             }
@@ -65,9 +65,17 @@ const IR::CompileTimeValue* Evaluator::getValue(const IR::Node* node) const {
 
 ////////////////////////////// visitor methods ////////////////////////////////////
 
+bool Evaluator::validFor(const IR::Node* program) const {
+    return toplevelBlock != nullptr && toplevelBlock->getProgram() == program &&
+            refMap->getGeneration() == refMapGeneration &&
+            typeMap->getGeneration() == typeMapGeneration;
+}
+
 bool Evaluator::preorder(const IR::P4Program* program) {
     LOG1("Evaluating " << program);
     toplevelBlock = new IR::ToplevelBlock(program->srcInfo, program);
+    refMapGeneration = refMap->getGeneration();
+    typeMapGeneration = typeMap->getGeneration();
 
     pushBlock(toplevelBlock);
     for (auto d : *program->declarations) {
@@ -77,9 +85,10 @@ bool Evaluator::preorder(const IR::P4Program* program) {
         visit(d);
     }
     popBlock(toplevelBlock);
-    std::stringstream str;
-    toplevelBlock->dbprint_recursive(str);
-    LOG1(str.str());
+    if (LOGGING(1)) {
+        std::stringstream str;
+        toplevelBlock->dbprint_recursive(str);
+        LOG1(str.str()); }
     return false;
 }
 
@@ -28,21 +28,31 @@ class IHasBlock {
     virtual IR::ToplevelBlock* getToplevelBlock() = 0;
 };
 
-class Evaluator final : public Inspector, public IHasBlock {
+// The toplevel block is itself an analysis of the program, valid as long as
+// neither the program nor the maps it was computed from change.
+class Evaluator final : public Inspector, public IHasBlock,
+                        public ProgramAnalysis, public AnalysisUsage {
     const ReferenceMap*      refMap;
     const TypeMap*           typeMap;
     std::vector<IR::Block*>  blockStack;
     IR::ToplevelBlock*       toplevelBlock;
+    // generations of the maps the toplevel block was computed from
+    unsigned                 refMapGeneration = 0, typeMapGeneration = 0;
 
  protected:
     void pushBlock(IR::Block* block);
     void popBlock(IR::Block* block);
 
  public:
-    Evaluator(const ReferenceMap* refMap, const TypeMap* typeMap) :
-            refMap(refMap), typeMap(typeMap), toplevelBlock(nullptr)
-    { CHECK_NULL(refMap); CHECK_NULL(typeMap); setName("Evaluator"); }
+    Evaluator(ReferenceMap* refMap, TypeMap* typeMap) :
+            refMap(refMap), typeMap(typeMap), toplevelBlock(nullptr) {
+        CHECK_NULL(refMap); CHECK_NULL(typeMap); setName("Evaluator");
+        declareComputes(this);
+        declareRequires(refMap);
+        declareRequires(typeMap); }
     IR::ToplevelBlock* getToplevelBlock() override { return toplevelBlock; }
+    bool validFor(const IR::Node* program) const override;
+    void revalidate(const IR::Node*) override { BUG("Evaluator cannot be preserved"); }
 
     IR::Block* currentBlock() const;
     void setValue(const IR::Node* node, const IR::CompileTimeValue* constant);
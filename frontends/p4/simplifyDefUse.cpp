@@ -136,7 +136,7 @@ class FindUninitialized : public Inspector {
                 if (storage == nullptr)
                     continue;
 
-                const LocationSet* loc = new LocationSet(storage);
+                const LocationSet* loc = LocationSet::intern(new LocationSet(storage));
                 auto points = defs->get(loc);
                 hasUses->add(points);
                 // Check uninitialized non-headers (headers can be invalid).
@@ -295,7 +295,7 @@ class FindUninitialized : public Inspector {
         auto storage = definitions->storageMap->getStorage(decl);
         const LocationSet* result;
         if (storage != nullptr)
-            result = new LocationSet(storage);
+            result = LocationSet::intern(new LocationSet(storage));
         else
             result = LocationSet::empty;
         reads(expression, result);
@@ -36,7 +36,7 @@ class StrengthReduction final : public Transform {
     int isPowerOf2(const IR::Expression* expr) const;
 
  public:
-    StrengthReduction() { visitDagOnce = true; setName("StrengthReduction"); }
+    StrengthReduction() { visitDagOnce = true; cloneOnWrite = true; setName("StrengthReduction"); }
 
     using Transform::postorder;
 
@@ -46,25 +46,9 @@ bool TypeVariableSubstitution::compose(const IR::Node* errorLocation,
                                 var->toString(), substitution->toString(), bound->toString());
     }
 
-    // Replace var with substitution everywhere
-    TypeVariableSubstitution *tvs = new TypeVariableSubstitution();
-    bool success = tvs->setBinding(var, substitution);
-    if (!success)
-        BUG("Cannot set binding");
-
-    TypeVariableSubstitutionVisitor visitor(tvs);
-    for (auto bound : binding) {
-        if (bound.first == var)
-            BUG("Variable %1% already bound", var->toString());
-        const IR::Type* type = bound.second;
-        const IR::Node* newType = type->apply(visitor);
-        if (newType == nullptr)
-            return false;
-
-        binding.emplace(bound.first, newType->to<IR::Type>());
-    }
-
-    success = setBinding(var, substitution);
+    // Bindings are never changed once made, so the types already bound are
+    // not rewritten to replace var.
+    bool success = setBinding(var, substitution);
     if (!success)
         BUG("Failed to insert binding");
     return true;
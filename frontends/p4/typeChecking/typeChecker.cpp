@@ -72,6 +72,10 @@ TypeChecking::TypeChecking(ReferenceMap* refMap, TypeMap* typeMap,
        updateExpressions ? new P4::ResolveReferences(refMap) : nullptr });
     setName("TypeChecking");
     setStopOnError(true);
+    if (!updateExpressions) {
+        // ApplyTypesToExpressions may still have work to do even if the maps are valid
+        declareComputes(refMap);
+        declareComputes(typeMap); }
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -103,6 +107,10 @@ TypeInference::TypeInference(ReferenceMap* refMap, TypeMap* typeMap, bool readOn
     CHECK_NULL(refMap);
     visitDagOnce = false;  // the done() method will take care of this
     setName("TypeInference");
+    if (readOnly)
+        // otherwise it may still need to insert casts
+        declareComputes(typeMap);
+    declareRequires(refMap);
 }
 
 Visitor::profile_t TypeInference::init_apply(const IR::Node* node) {
@@ -123,6 +131,21 @@ void TypeInference::end_apply(const IR::Node* node) {
         LOG2("Typemap: " << std::endl << typeMap);
 }
 
+const IR::Node* TypeInference::apply_visitor(const IR::Node* n, const char* name) {
+    // Nodes are never mutated, so a node that was checked before (as part of a
+    // whole program) still has all its subtree in the typeMap.  Only the nodes
+    // a Transform has replaced since then need to be checked again.
+    if (!n || !initialNode->is<IR::P4Program>())
+        return Transform::apply_visitor(n, name);
+    if (typeMap->isChecked(n))
+        return n;
+    auto errors = ::errorCount();
+    auto result = Transform::apply_visitor(n, name);
+    if (result == n && ::errorCount() == errors)
+        typeMap->setChecked(n);
+    return result;
+}
+
 bool TypeInference::done() const {
     auto orig = getOriginal();
     bool done = typeMap->contains(orig);
@@ -168,24 +191,33 @@ TypeVariableSubstitution* TypeInference::unify(const IR::Node* errorPosition,
     return tvs;
 }
 
-const IR::IndexedVector<IR::StructField>*
-TypeInference::canonicalizeFields(const IR::Type_StructLike* type) {
+template<class T>
+const IR::Type* TypeInference::canonicalizeFields(const T* type) {
     bool changes = false;
-    auto fields = new IR::IndexedVector<IR::StructField>();
-    for (auto field : *type->fields) {
+    std::vector<const IR::Type*> ftypes;
+    for (const IR::StructField* field : *type->fields) {
         auto ftype = canonicalize(field->type);
         if (ftype == nullptr)
             return nullptr;
         if (ftype != field->type)
             changes = true;
         BUG_CHECK(!ftype->is<IR::Type_Type>(), "%1%: TypeType in field type", ftype);
-        auto newField = new IR::StructField(field->srcInfo, field->name, field->annotations, ftype);
+        ftypes.push_back(ftype);
+    }
+    if (!changes)
+        return type;
+    if (auto canon = typeMap->getCanonical(type, ftypes))
+        return canon;
+    auto fields = new IR::IndexedVector<IR::StructField>();
+    auto ftype = ftypes.begin();
+    for (const IR::StructField* field : *type->fields) {
+        auto newField = new IR::StructField(field->srcInfo, field->name, field->annotations,
+                                            *ftype++);
         fields->push_back(newField);
     }
-    if (changes)
-        return fields;
-    else
-        return type->fields;
+    auto canon = new T(type->srcInfo, type->name, type->annotations, fields);
+    typeMap->setCanonical(type, ftypes, canon);
+    return canon;
 }
 
 const IR::ParameterList* TypeInference::canonicalizeParameters(const IR::ParameterList* params) {
@@ -293,7 +325,10 @@ const IR::Type* TypeInference::canonicalize(const IR::Type* type) {
             return nullptr;
         if (et == set->elementType)
             return type;
+        if (auto canon = typeMap->getCanonical(type, { et }))
+            return canon;
         const IR::Type* canon = new IR::Type_Set(type->srcInfo, et);
+        typeMap->setCanonical(type, { et }, canon);
         return canon;
     } else if (type->is<IR::Type_Stack>()) {
         auto stack = type->to<IR::Type_Stack>();
@@ -437,38 +472,11 @@ const IR::Type* TypeInference::canonicalize(const IR::Type* type) {
             resultType = new IR::Type_Method(mt->getSourceInfo(), tps, res, pl);
         return resultType;
     } else if (type->is<IR::Type_Header>()) {
-        auto hdr = type->to<IR::Type_Header>();
-        auto fields = canonicalizeFields(hdr);
-        if (fields == nullptr)
-            return nullptr;
-        const IR::Type* canon;
-        if (fields != hdr->fields)
-            canon = new IR::Type_Header(hdr->srcInfo, hdr->name, hdr->annotations, fields);
-        else
-            canon = hdr;
-        return canon;
+        return canonicalizeFields(type->to<IR::Type_Header>());
     } else if (type->is<IR::Type_Struct>()) {
-        auto str = type->to<IR::Type_Struct>();
-        auto fields = canonicalizeFields(str);
-        if (fields == nullptr)
-            return nullptr;
-        const IR::Type* canon;
-        if (fields != str->fields)
-            canon = new IR::Type_Struct(str->srcInfo, str->name, str->annotations, fields);
-        else
-            canon = str;
-        return canon;
+        return canonicalizeFields(type->to<IR::Type_Struct>());
     } else if (type->is<IR::Type_Union>()) {
-        auto str = type->to<IR::Type_Union>();
-        auto fields = canonicalizeFields(str);
-        if (fields == nullptr)
-            return nullptr;
-        const IR::Type* canon;
-        if (fields != str->fields)
-            canon = new IR::Type_Union(str->srcInfo, str->name, str->annotations, fields);
-        else
-            canon = str;
-        return canon;
+        return canonicalizeFields(type->to<IR::Type_Union>());
     } else if (type->is<IR::Type_Specialized>()) {
         auto st = type->to<IR::Type_Specialized>();
         auto baseCanon = canonicalize(st->baseType);
@@ -49,7 +49,7 @@ class ClearTypeMap : public Inspector {
 // TypeInference.  If updateExpressions is true, after type checking
 // it will update all Expression objects, writing the result type into
 // the Expression::type field.
-class TypeChecking : public PassManager {
+class TypeChecking : public PassManager, public AnalysisUsage {
  public:
     TypeChecking(/* out */ReferenceMap* refMap, /* out */TypeMap* typeMap,
                  bool updateExpressions = false);
@@ -62,7 +62,7 @@ class TypeChecking : public PassManager {
 // with readOnly = true, it will assert that the program is not changed.
 // It is expected that once a program has been type-checked and all casts have
 // been inserted it will not need to change ever again during type-checking.
-class TypeInference : public Transform {
+class TypeInference : public Transform, public AnalysisUsage {
     // Input: reference map
     ReferenceMap* refMap;
     // Output: type map
@@ -123,7 +123,9 @@ class TypeInference : public Transform {
 
     // Converts each type to a canonical representation.
     const IR::Type* canonicalize(const IR::Type* type);
-    const IR::IndexedVector<IR::StructField>* canonicalizeFields(const IR::Type_StructLike* type);
+    // Canonical version of a struct-like type: the same node for the same
+    // type and canonical field types.
+    template<class T> const IR::Type* canonicalizeFields(const T* type);
     const IR::ParameterList* canonicalizeParameters(const IR::ParameterList* params);
 
     // various helpers
@@ -253,12 +255,15 @@ class TypeInference : public Transform {
     const IR::Node* postorder(IR::Property* elem) override;
     const IR::Node* postorder(IR::SelectCase* elem) override;
 
+    // Skips subtrees that are unchanged since they were last checked
+    const IR::Node* apply_visitor(const IR::Node* n, const char* name = 0) override;
     Visitor::profile_t init_apply(const IR::Node* node) override;
     void end_apply(const IR::Node* Node) override;
 };
 
-// Copy types from the typeMap to expressions.  Updates the typeMap with newly created nodes
-class ApplyTypesToExpressions : public Transform {
+// Copy types from the typeMap to expressions.  Updates the typeMap with newly created nodes,
+// so it preserves the typeMap.
+class ApplyTypesToExpressions : public Transform, public AnalysisUsage {
     TypeMap *typeMap;
     IR::Node *postorder(IR::Node *n) override {
         const IR::Node *orig = getOriginal();
@@ -282,7 +287,7 @@ class ApplyTypesToExpressions : public Transform {
 
  public:
     explicit ApplyTypesToExpressions(TypeMap *typeMap) : typeMap(typeMap)
-    { setName("ApplyTypesToExpressions"); }
+    { setName("ApplyTypesToExpressions"); declarePreserves(typeMap); }
 };
 
 }  // namespace P4
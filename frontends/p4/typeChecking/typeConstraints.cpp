@@ -19,37 +19,49 @@ limitations under the License.
 
 namespace P4 {
 
+const IR::Type* TypeConstraints::find(const IR::Type* type,
+                                      const TypeVariableSubstitution* subst) {
+    std::vector<const IR::ITypeVar*> path;
+    while (isUnifiableTypeVariable(type)) {
+        auto tv = type->to<IR::ITypeVar>();
+        auto next = get(shortcuts, tv);
+        if (next == nullptr)
+            next = subst->lookup(tv);
+        if (next == nullptr)
+            break;
+        path.push_back(tv);
+        type = next;
+    }
+    if (path.size() > 1) {
+        for (auto tv : path)
+            shortcuts[tv] = type;
+    }
+    return type;
+}
+
 bool TypeConstraints::solve(const IR::Node* root, EqualityConstraint *constraint,
                             TypeVariableSubstitution *subst, bool reportErrors) {
-    if (isUnifiableTypeVariable(constraint->left)) {
-        auto leftTv = constraint->left->to<IR::ITypeVar>();
-        if (constraint->left == constraint->right)
+    // Looking through the bindings of a variable here is the same as adding
+    // a constraint for its binding, but does not walk long chains of
+    // variables bound to variables again and again.
+    auto left = find(constraint->left, subst);
+    if (isUnifiableTypeVariable(left)) {
+        auto leftTv = left->to<IR::ITypeVar>();
+        // left and right may already be in the same class
+        if (left == constraint->right || left == find(constraint->right, subst))
             return true;
-
-        // check to see whether we already have a substitution for leftTv
-        const IR::Type* leftSubst = subst->lookup(leftTv);
-        if (leftSubst == nullptr) {
-            LOG3("Binding " << leftTv << " => " << constraint->right);
-            return subst->compose(root, leftTv, constraint->right);
-        } else {
-            addEqualityConstraint(leftSubst, constraint->right);
-            return true;
-        }
+        LOG3("Binding " << leftTv << " => " << constraint->right);
+        return subst->compose(root, leftTv, constraint->right);
     }
 
-    if (isUnifiableTypeVariable(constraint->right)) {
-        auto rightTv = constraint->right->to<IR::ITypeVar>();
-        const IR::Type* rightSubst = subst->lookup(rightTv);
-        if (rightSubst == nullptr) {
-            LOG3("Binding " << rightTv << " => " << constraint->left);
-            return subst->compose(root, rightTv, constraint->left);
-        } else {
-            addEqualityConstraint(constraint->left, rightSubst);
-            return true;
-        }
+    auto right = find(constraint->right, subst);
+    if (isUnifiableTypeVariable(right)) {
+        auto rightTv = right->to<IR::ITypeVar>();
+        LOG3("Binding " << rightTv << " => " << left);
+        return subst->compose(root, rightTv, left);
     }
 
-    bool success = unification->unify(root, constraint->left, constraint->right, reportErrors);
+    bool success = unification->unify(root, left, right, reportErrors);
     // this may add more constraints
     return success;
 }
@@ -19,6 +19,7 @@ limitations under the License.
 
 #include <sstream>
 #include "ir/ir.h"
+#include "lib/flat_hash.h"
 #include "typeUnification.h"
 #include "typeConstraints.h"
 #include "frontends/p4/substitution.h"
@@ -69,10 +70,22 @@ class TypeConstraints final {
      * This example should not typecheck: because T cannot be constrained in the invocation of f.
      * While typechecking the f(data) call, T is not a type variable that can be unified.
      */
-    std::set<const IR::ITypeVar*> unifiableTypeVariables;
+    flat_hash_set<const IR::ITypeVar*> unifiableTypeVariables;
     std::vector<IConstraint*> constraints;
     TypeUnification *unification;
 
+    /*
+     * Bindings are never changed once made, so the bound type variables form
+     * union-find trees: a variable bound to another one is in the same class.
+     * For some of the bound variables this holds a type further along the
+     * chain of bindings (path compression); the substitution itself keeps
+     * the bindings as they were made.
+     */
+    flat_hash_map<const IR::ITypeVar*, const IR::Type*> shortcuts;
+    // Follows the bindings in subst starting from type, as long as it is a
+    // bound unifiable type variable; returns the type where the chain ends.
+    const IR::Type* find(const IR::Type* type, const TypeVariableSubstitution* subst);
+
  public:
     TypeConstraints() : unification(new TypeUnification(this)) {}
 
@@ -119,6 +132,7 @@ class TypeConstraints final {
         LOG1("Solving constraints:\n" << *this);
 
         auto tvs = new TypeVariableSubstitution();
+        shortcuts.clear();
         while (!constraints.empty()) {
             auto last = constraints.back();
             constraints.pop_back();
@@ -51,6 +51,7 @@ bool TypeMap::isCompileTimeConstant(const IR::Expression* expression) const {
 void TypeMap::clear() {
     LOG1("Clearing typeMap");
     typeMap.clear(); leftValues.clear(); constants.clear(); allTypeVariables.clear();
+    checked.clear();
     program = nullptr;
 }
 
@@ -113,7 +114,7 @@ bool TypeMap::equivalent(const IR::Type* left, const IR::Type* right) {
 
     // Below we are sure that it's the same Node class
     if (left->is<IR::Type_Base>())
-        return *left == *right;
+        return left == right || *left == *right;
     if (left->is<IR::Type_Type>())
         return equivalent(left->to<IR::Type_Type>()->type, right->to<IR::Type_Type>()->type);
     if (left->is<IR::Type_Error>())
@@ -256,9 +257,36 @@ bool TypeMap::equivalent(const IR::Type* left, const IR::Type* right) {
     // Type_Dontcare, Type_Unknown, Type_Name, Type_Specialized, Type_Typedef
 }
 
+size_t TypeMap::structuralHash(const IR::Type* type, bool &unsized) {
+    if (type == nullptr)
+        return 0;
+    size_t result = type->node_type_name().hash();
+    auto combine = [&result](size_t h) { result = result * 31 + h; };
+    if (auto tb = type->to<IR::Type_Bits>()) {
+        combine(tb->size * 2 + tb->isSigned);
+    } else if (auto tt = type->to<IR::Type_Type>()) {
+        combine(structuralHash(tt->type, unsized));
+    } else if (auto ts = type->to<IR::Type_Stack>()) {
+        if (ts->sizeKnown())
+            combine(ts->getSize());
+        else
+            unsized = true;
+        combine(structuralHash(ts->elementType, unsized));
+    } else if (auto sl = type->to<IR::Type_StructLike>()) {
+        for (auto f : *sl->fields) {
+            combine(f->name.name.hash());
+            combine(structuralHash(f->type, unsized)); }
+    } else if (auto tu = type->to<IR::Type_Tuple>()) {
+        for (auto t : *tu->components)
+            combine(structuralHash(t, unsized));
+    } else if (auto set = type->to<IR::Type_Set>()) {
+        combine(structuralHash(set->elementType, unsized));
+    }
+    return result;
+}
+
 // Used for tuples and stacks only
 const IR::Type* TypeMap::getCanonical(const IR::Type* type) {
-    // Currently a linear search; hopefully this won't be too expensive in practice
     std::vector<const IR::Type*>* searchIn;
     if (type->is<IR::Type_Stack>())
         searchIn = &canonicalStacks;
@@ -267,13 +295,32 @@ const IR::Type* TypeMap::getCanonical(const IR::Type* type) {
     else
         BUG("%1%: unexpected type", type);
 
-    for (auto t : *searchIn) {
-        if (TypeMap::equivalent(type, t))
-            return t;
+    bool unsized = false;
+    auto &bucket = canonicalIndex[structuralHash(type, unsized)];
+    if (unsized || unsizedCanonical) {
+        unsizedCanonical = true;
+        for (auto t : *searchIn) {
+            if (TypeMap::equivalent(type, t))
+                return t;
+        }
+    } else {
+        // Equivalent types are all in the bucket, in the order they were added
+        for (auto t : bucket) {
+            if (TypeMap::equivalent(type, t))
+                return t;
+        }
     }
     searchIn->push_back(type);
+    bucket.push_back(type);
     return type;
 }
 
+const IR::Type* TypeMap::getCanonical(const IR::Type* type,
+                                      const std::vector<const IR::Type*>& components) const {
+    auto it = canonicalOf.find(type);
+    if (it == canonicalOf.end() || it->second.first != components)
+        return nullptr;
+    return it->second.second;
+}
 
 }  // namespace P4
@@ -17,7 +17,10 @@ limitations under the License.
 #ifndef _FRONTENDS_P4_TYPEMAP_H_
 #define _FRONTENDS_P4_TYPEMAP_H_
 
+#include <unordered_map>
+
 #include "ir/ir.h"
+#include "lib/flat_hash.h"
 #include "frontends/common/programMap.h"
 #include "frontends/p4/substitution.h"
 
@@ -43,18 +46,33 @@ class TypeMap final : public ProgramMap {
     // different tuples or stacks with the same signature.
     std::vector<const IR::Type*> canonicalTuples;
     std::vector<const IR::Type*> canonicalStacks;
+    // The same canonical types, indexed by structuralHash
+    std::unordered_map<size_t, std::vector<const IR::Type*>> canonicalIndex;
+    // True if some canonical type contains a stack whose size is not known;
+    // comparing with it reports an error, so these are searched linearly.
+    bool unsizedCanonical = false;
+    // Canonical type built for a type from the canonical types of its
+    // components; reused while the components stay the same, so equal
+    // canonical types are mostly the same node.  Like the canonical tuples
+    // and stacks, these are kept when the map is cleared.
+    flat_hash_map<const IR::Type*, std::pair<std::vector<const IR::Type*>, const IR::Type*>>
+            canonicalOf;
 
     // Map each node to its canonical type
-    std::map<const IR::Node*, const IR::Type*> typeMap;
+    flat_hash_map<const IR::Node*, const IR::Type*> typeMap;
     // All left-values in the program.
-    std::set<const IR::Expression*> leftValues;
+    flat_hash_set<const IR::Expression*> leftValues;
     // All compile-time constants.  A compile-time constant
     // is not necessarily a constant - it could be a directionless
     // parameter as well.
-    std::set<const IR::Expression*> constants;
+    flat_hash_set<const IR::Expression*> constants;
     // For each type variable in the program the actual
     // type that is substituted for it.
     TypeVariableSubstitution allTypeVariables;
+    // Nodes whose whole subtree has been type-checked without errors;
+    // these need not be checked again.  Keyed by node rather than by id:
+    // ids are not unique (e.g. nodes read from JSON keep their ids).
+    flat_hash_set<const IR::Node*> checked;
 
     // checks some preconditions before setting the type
     void checkPrecondition(const IR::Node* element, const IR::Type* type) const;
@@ -80,12 +98,25 @@ class TypeMap final : public ProgramMap {
     void addSubstitutions(const TypeVariableSubstitution* tvs);
     const IR::Type* getSubstitution(const IR::Type_Var* var)
     { return allTypeVariables.lookup(var); }
+    bool isChecked(const IR::Node* node) const
+    { return checked.count(node) != 0; }
+    void setChecked(const IR::Node* node)
+    { checked.insert(node); }
 
     // deep structural equivalence between canonical types only.
     static bool equivalent(const IR::Type* left, const IR::Type* right);
+    // Hash consistent with equivalent(): equivalent types have the same hash.
+    // Sets unsized if type contains a stack whose size is not known.
+    static size_t structuralHash(const IR::Type* type, bool &unsized);
 
     // Used for tuples and stacks only
     const IR::Type* getCanonical(const IR::Type* type);
+    // Canonical type built before for type from these components, or nullptr
+    const IR::Type* getCanonical(const IR::Type* type,
+                                 const std::vector<const IR::Type*>& components) const;
+    void setCanonical(const IR::Type* type, const std::vector<const IR::Type*>& components,
+                      const IR::Type* canonical)
+    { canonicalOf[type] = std::make_pair(components, canonical); }
 };
 }  // namespace P4
 
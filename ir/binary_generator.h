@@ -0,0 +1,216 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _IR_BINARY_GENERATOR_H_
+#define _IR_BINARY_GENERATOR_H_
+
+#include <gmpxx.h>
+#include <string.h>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include "lib/cstring.h"
+#include "lib/flat_hash.h"
+#include "lib/ltbitmatrix.h"
+#include "lib/match.h"
+#include "lib/source_file.h"
+
+#include "ir.h"
+
+/* Compact binary form of the IR, written by the toBinary methods generated for
+ * every IR class and read back by BinaryLoader; the counterpart of JSONGenerator.
+ * The file starts with binary_ir_magic and binary_ir_version, followed by one
+ * value.  Values are encoded as:
+ *   integers, enums    LEB128 varints; signed ones zigzag encoded
+ *   bool               one byte
+ *   double             8 bytes, host order
+ *   mpz_class          sign (0 zero, 1 positive, 2 negative), byte count, bytes
+ *   cstring            0 for null, i for the i'th string already written, or
+ *                      one more than the number of strings written followed by
+ *                      the length and the characters of a new string
+ *   SourceInfo         0 when invalid, else start line, start column, end line
+ *                      and end column
+ *   IR::Node           0 for null, 1 followed by k for the k'th node already
+ *                      written (counting in the order their encodings end), or 2
+ *                      followed by the node type name and the fields of each
+ *                      class from Node down, as listed in the .def files
+ *   LTBitMatrix        length and characters of its text form, as in JSON
+ *   other objects      their toBinary fields; pointers to them are preceded by a
+ *                      bool telling whether they are null
+ *   containers         element count followed by the elements
+ * Strings and nodes are written once, so the output keeps the sharing of the IR. */
+constexpr char binary_ir_magic[] = "P4IR";
+constexpr unsigned binary_ir_version = 1;
+
+class BinaryGenerator {
+    std::ostream &out;
+    std::string buffer;
+    std::unordered_map<cstring, unsigned> strings;
+    flat_hash_map<const IR::Node *, unsigned> nodes;
+
+    template<typename T>
+    class has_toBinary {
+        typedef char small;
+        typedef struct { char c[2]; } big;
+
+        template<typename C> static small test(decltype(&C::toBinary));
+        template<typename C> static big test(...);
+     public:
+        static const bool value = sizeof(test<T>(0)) == sizeof(char);
+    };
+
+    void byte(uint8_t b) { buffer.push_back(b); }
+    void bytes(const void *p, size_t size) { buffer.append(static_cast<const char *>(p), size); }
+    // the raw characters of a string that is not kept in the string table
+    void text(const std::string &s) { varint(s.size()); bytes(s.data(), s.size()); }
+
+ public:
+    explicit BinaryGenerator(std::ostream &out) : out(out) {
+        bytes(binary_ir_magic, sizeof(binary_ir_magic) - 1);
+        varint(binary_ir_version); }
+    ~BinaryGenerator() { flush(); }
+    void flush() { out.write(buffer.data(), buffer.size()); buffer.clear(); }
+
+    void varint(uintmax_t v) {
+        for (; v >= 0x80; v >>= 7)
+            byte(v | 0x80);
+        byte(v); }
+    void varint_signed(intmax_t v) {
+        varint((static_cast<uintmax_t>(v) << 1) ^ static_cast<uintmax_t>(v >> 63)); }
+
+    template<typename T>
+    void generate(const vector<T> &v) {
+        varint(v.size());
+        for (auto &e : v)
+            generate(e); }
+    template<typename T>
+    void generate(const std::vector<T> &v) {
+        varint(v.size());
+        for (auto &e : v)
+            generate(e); }
+    template<typename T, typename U>
+    void generate(const std::pair<T, U> &v) {
+        generate(v.first);
+        generate(v.second); }
+    template<typename K, typename V>
+    void generate(const ordered_map<K, V> &v) {
+        varint(v.size());
+        for (auto &e : v)
+            generate(e); }
+    template<typename K, typename V>
+    void generate(const std::map<K, V> &v) {
+        varint(v.size());
+        for (auto &e : v)
+            generate(e); }
+    template<typename K, typename V>
+    void generate(const std::multimap<K, V> &v) {
+        varint(v.size());
+        for (auto &e : v)
+            generate(e); }
+    template<typename T, size_t N>
+    void generate(const T (&v)[N]) {
+        for (auto &e : v)
+            generate(e); }
+
+    void generate(bool v) { byte(v); }
+    template<typename T>
+    typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type
+    generate(T v) { varint_signed(v); }
+    template<typename T>
+    typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value>::type
+    generate(T v) { varint(v); }
+    template<typename T>
+    typename std::enable_if<std::is_enum<T>::value>::type
+    generate(T v) { varint_signed(static_cast<intmax_t>(v)); }
+    void generate(double v) { bytes(&v, sizeof(v)); }
+    void generate(const mpz_class &v) {
+        int sign = sgn(v);
+        byte(sign < 0 ? 2 : sign);
+        if (sign == 0) return;
+        size_t size = (mpz_sizeinbase(v.get_mpz_t(), 2) + 7) / 8;
+        std::string data(size, '\0');
+        mpz_export(&data[0], &size, 1, 1, 0, 0, v.get_mpz_t());
+        text(data); }
+
+    void generate(cstring v) {
+        if (!v) {
+            varint(0);
+            return; }
+        auto it = strings.emplace(v, strings.size() + 1);
+        varint(it.first->second);
+        if (it.second)
+            text(v.c_str()); }
+    void generate(const Util::SourceInfo &v) {
+        varint(v.getStart().getLineNumber());
+        if (!v.isValid()) return;
+        varint(v.getStart().getColumnNumber());
+        varint(v.getEnd().getLineNumber());
+        varint(v.getEnd().getColumnNumber()); }
+    void generate(const IR::ID &v) {
+        generate(v.srcInfo);
+        generate(v.name);
+        generate(v.originalName); }
+    void generate(const match_t &v) {
+        varint(v.word0);
+        varint(v.word1); }
+    void generate(const LTBitMatrix &v) {
+        std::stringstream tmp;
+        tmp << v;
+        text(tmp.str()); }
+
+    template<typename T>
+    typename std::enable_if<
+                    has_toBinary<T>::value &&
+                    !std::is_base_of<IR::INode, T>::value>::type
+    generate(const T &v) { v.toBinary(*this); }
+    template<typename T>
+    typename std::enable_if<std::is_base_of<IR::INode, T>::value>::type
+    generate(const T &v) { node(v.getNode()); }
+
+    template<typename T>
+    typename std::enable_if<
+                    std::is_pointer<T>::value &&
+                    has_toBinary<typename std::remove_pointer<T>::type>::value &&
+                    !std::is_base_of<IR::INode, typename std::remove_pointer<T>::type>::value
+                    >::type
+    generate(T v) {
+        generate(v != nullptr);
+        if (v) v->toBinary(*this); }
+    template<typename T>
+    typename std::enable_if<
+                    std::is_pointer<T>::value &&
+                    std::is_base_of<IR::INode, typename std::remove_pointer<T>::type>::value
+                    >::type
+    generate(T v) { node(v ? v->getNode() : nullptr); }
+
+    void node(const IR::Node *n) {
+        if (!n) {
+            varint(0);
+            return; }
+        auto it = nodes.find(n);
+        if (it != nodes.end()) {
+            varint(1);
+            varint(it->second);
+            return; }
+        varint(2);
+        generate(n->node_type_name());
+        n->toBinary(*this);
+        nodes.emplace(n, nodes.size()); }
+
+    template<typename T> BinaryGenerator &operator<<(const T &v) { generate(v); return *this; }
+};
+
+#endif /* _IR_BINARY_GENERATOR_H_ */
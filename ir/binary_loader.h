@@ -0,0 +1,249 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _IR_BINARY_LOADER_H_
+#define _IR_BINARY_LOADER_H_
+
+#include <gmpxx.h>
+#include <string.h>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+#include "lib/cstring.h"
+#include "lib/exceptions.h"
+#include "lib/ltbitmatrix.h"
+#include "lib/map.h"
+#include "lib/match.h"
+#include "lib/source_file.h"
+#include "binary_generator.h"
+
+#include "ir.h"
+
+/* Reads the IR written by BinaryGenerator (see binary_generator.h for the
+ * format) by calling the constructors generated from the .def files.  It reads
+ * from a buffer, which may be a mapped file: apart from the strings, which are
+ * interned as cstrings, nothing is copied out of it before the nodes are built. */
+class BinaryLoader {
+    template<typename T> class has_fromBinary {
+        typedef char small;
+        typedef struct { char c[2]; } big;
+
+        template<typename C> static small test(decltype(&C::fromBinary));
+        template<typename C> static big test(...);
+     public:
+        static const bool value = sizeof(test<T>(0)) == sizeof(char);
+    };
+
+    std::string                         data;   // the input, unless it is a caller's buffer
+    const uint8_t                       *pos, *end;
+    std::vector<cstring>                strings;
+    std::vector<BinaryFactoryFn>        factories;  // for each string naming a node type
+    std::vector<const IR::Node *>       nodes;
+
+    // Thrown on malformed input, which operator>> reports as an error
+    struct Malformed { const char *what; };
+    [[noreturn]] static void malformed(const char *what) { throw Malformed{what}; }
+
+    uint8_t byte() {
+        if (pos == end) malformed("truncated input");
+        return *pos++; }
+    const char *bytes(size_t size) {
+        if (size > size_t(end - pos)) malformed("truncated input");
+        auto rv = reinterpret_cast<const char *>(pos);
+        pos += size;
+        return rv; }
+    std::string text() {
+        size_t size = varint();
+        return std::string(bytes(size), size); }
+    void start() {
+        pos = reinterpret_cast<const uint8_t *>(data.data());
+        end = pos + data.size(); }
+    void header() {
+        size_t size = sizeof(binary_ir_magic) - 1;
+        if (size_t(end - pos) < size || memcmp(pos, binary_ir_magic, size) != 0) {
+            ::error("Input is not binary IR");
+            pos = end;
+            return; }
+        pos += size;
+        if (varint() != binary_ir_version) {
+            ::error("Unsupported binary IR version");
+            pos = end; } }
+    unsigned string_index() {
+        unsigned idx = varint();
+        if (idx == strings.size() + 1) {
+            size_t size = varint();
+            auto text = bytes(size);
+            strings.push_back(cstring(text, text + size));
+        } else if (idx > strings.size()) {
+            malformed("invalid string index"); }
+        return idx; }
+
+    // The factory for type T, for node types that are not in the generated table
+    // (the Vector and NameMap templates)
+    template<typename T> static
+    typename std::enable_if<has_fromBinary<T>::value, BinaryFactoryFn>::type factory() {
+        return [](BinaryLoader &bin) -> IR::Node * { return T::fromBinary(bin); }; }
+    template<typename T> static
+    typename std::enable_if<!has_fromBinary<T>::value, BinaryFactoryFn>::type factory() {
+        return nullptr; }
+    const IR::Node *node(BinaryFactoryFn fallback) {
+        switch (varint()) {
+        case 0:
+            return nullptr;
+        case 1: {
+            size_t idx = varint();
+            if (idx >= nodes.size()) malformed("invalid node reference");
+            return nodes[idx]; }
+        case 2: {
+            unsigned type = string_index();
+            if (type == 0) malformed("missing node type");
+            if (factories.size() < strings.size())
+                factories.resize(strings.size());
+            auto &fn = factories[type - 1];
+            if (!fn) {
+                fn = get(IR::binary_unpacker_table, strings[type - 1]);
+                if (!fn) fn = fallback;
+                if (!fn) malformed("unknown node type"); }
+            auto rv = fn(*this);
+            nodes.push_back(rv);
+            return rv; }
+        default:
+            malformed("invalid node tag"); } }
+    template<typename T> const T *node() {
+        const IR::Node *n = node(factory<T>());
+        if (!n) return nullptr;
+        auto rv = n->to<T>();
+        if (!rv) malformed("unexpected node type");
+        return rv; }
+
+    template<typename T> void unpack(vector<T> &v) {
+        v.resize(varint());
+        for (auto &e : v)
+            unpack(e); }
+    template<typename T> void unpack(std::vector<T> &v) {
+        v.resize(varint());
+        for (auto &e : v)
+            unpack(e); }
+    template<typename T, typename U> void unpack(std::pair<T, U> &v) {
+        unpack(v.first);
+        unpack(v.second); }
+    template<class MAP> void unpack_map(MAP &v) {
+        std::pair<typename MAP::key_type, typename MAP::mapped_type> temp;
+        for (size_t size = varint(); size > 0; --size) {
+            unpack(temp);
+            v.insert(temp); } }
+    template<typename K, typename V> void unpack(std::map<K, V> &v) { unpack_map(v); }
+    template<typename K, typename V> void unpack(ordered_map<K, V> &v) { unpack_map(v); }
+    template<typename K, typename V> void unpack(std::multimap<K, V> &v) { unpack_map(v); }
+    template<typename T, size_t N> void unpack(T (&v)[N]) {
+        for (auto &e : v)
+            unpack(e); }
+
+    void unpack(bool &v) { v = byte(); }
+    template<typename T>
+    typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type
+    unpack(T &v) { v = varint_signed(); }
+    template<typename T>
+    typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value>::type
+    unpack(T &v) { v = varint(); }
+    template<typename T>
+    typename std::enable_if<std::is_enum<T>::value>::type
+    unpack(T &v) { v = static_cast<T>(varint_signed()); }
+    void unpack(double &v) { memcpy(&v, bytes(sizeof(v)), sizeof(v)); }
+    void unpack(mpz_class &v) {
+        int sign = byte();
+        if (sign == 0) {
+            v = 0;
+            return; }
+        size_t size = varint();
+        mpz_import(v.get_mpz_t(), size, 1, 1, 0, 0, bytes(size));
+        if (sign == 2) v = -v; }
+
+    void unpack(cstring &v) {
+        unsigned idx = string_index();
+        v = idx ? strings[idx - 1] : cstring(); }
+    void unpack(Util::SourceInfo &v) {
+        unsigned line = varint();
+        if (line == 0) {
+            v = Util::SourceInfo();
+            return; }
+        unsigned column = varint();
+        Util::SourcePosition start(line, column);
+        line = varint();
+        column = varint();
+        v = Util::SourceInfo(start, Util::SourcePosition(line, column)); }
+    void unpack(IR::ID &v) {
+        unpack(v.srcInfo);
+        unpack(v.name);
+        unpack(v.originalName); }
+    void unpack(match_t &v) {
+        v.word0 = varint();
+        v.word1 = varint(); }
+    void unpack(LTBitMatrix &v) { text().c_str() >> v; }
+
+    template<typename T>
+    typename std::enable_if<has_fromBinary<T>::value && !std::is_base_of<IR::INode, T>::value>::type
+    unpack(T *&v) { v = byte() ? T::fromBinary(*this) : nullptr; }
+    template<typename T>
+    typename std::enable_if<has_fromBinary<T>::value && !std::is_base_of<IR::INode, T>::value>::type
+    unpack(T &v) { v = *(T::fromBinary(*this)); }
+
+    template<typename T> typename std::enable_if<std::is_base_of<IR::INode, T>::value>::type
+    unpack(T &v) {
+        auto n = node<T>();
+        if (!n) malformed("missing node");
+        v = *n; }
+    template<typename T> typename std::enable_if<std::is_base_of<IR::INode, T>::value>::type
+    unpack(const T *&v) { v = node<T>(); }
+
+ public:
+    explicit BinaryLoader(std::istream &in)
+    : data(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()) {
+        start();
+        header(); }
+    // 'buffer' must outlive the loader
+    BinaryLoader(const char *buffer, size_t size)
+    : pos(reinterpret_cast<const uint8_t *>(buffer)), end(pos + size) { header(); }
+
+    uintmax_t varint() {
+        uintmax_t rv = 0;
+        for (unsigned shift = 0; ; shift += 7) {
+            if (shift >= 8 * sizeof(rv)) malformed("invalid number");
+            uint8_t b = byte();
+            rv |= uintmax_t(b & 0x7f) << shift;
+            if (!(b & 0x80)) return rv; } }
+    intmax_t varint_signed() {
+        uintmax_t v = varint();
+        return static_cast<intmax_t>(v >> 1) ^ -static_cast<intmax_t>(v & 1); }
+
+    // for the generated constructors
+    template<typename T> void load(T &v) { unpack(v); }
+
+    // reads nothing if the input is not binary IR; malformed input is
+    // reported as an error and leaves v empty
+    template<typename T> BinaryLoader &operator>>(T &v) {
+        if (pos == end) return *this;
+        try {
+            unpack(v);
+        } catch (const Malformed &m) {
+            ::error("Malformed binary IR: %1%", m.what);
+            pos = end;
+            v = T(); }
+        return *this; }
+};
+
+#endif /* _IR_BINARY_LOADER_H_ */
@@ -17,6 +17,8 @@ limitations under the License.
 #ifndef IR_INDEXED_VECTOR_H_
 #define IR_INDEXED_VECTOR_H_
 
+#include <list>
+#include <unordered_map>
 
 #include "dbprint.h"
 #include "lib/enumerator.h"
@@ -41,36 +43,52 @@ class IDeclaration : public virtual INode {
 
 template<class T>
 class IndexedVector : public Vector<T> {
-    ordered_map<cstring, const IDeclaration*> declarations;
-
+    // Declarations in insertion order, with a hash index on their names.
+    // Names are interned, so the index compares and hashes them in constant time.
+    typedef std::list<const IDeclaration*> decl_list;
+    decl_list declarations;
+    std::unordered_map<cstring, typename decl_list::iterator> declIndex;
+
+    void rebuildIndex() {
+        declIndex.clear();
+        declIndex.reserve(declarations.size());
+        for (auto it = declarations.begin(); it != declarations.end(); ++it)
+            declIndex.emplace((*it)->getName().name, it); }
     void insertInMap(const T* a) {
         if (!a->template is<IDeclaration>())
             return;
         auto decl = a->template to<IDeclaration>();
         auto name = decl->getName().name;
-        auto previous = declarations.find(name);
-        if (previous != declarations.end())
-            ::error("%1%: Duplicates declaration %2%", a, previous->second);
+        auto previous = declIndex.find(name);
+        if (previous != declIndex.end())
+            ::error("%1%: Duplicates declaration %2%", a, *previous->second);
         else
-            declarations[name] = decl; }
+            declIndex.emplace(name, declarations.insert(declarations.end(), decl)); }
     void removeFromMap(const T* a) {
         auto decl = a->template to<IDeclaration>();
         if (decl == nullptr)
             return;
         cstring name = decl->getName().name;
-        auto it = declarations.find(name);
-        if (it == declarations.end())
+        auto it = declIndex.find(name);
+        if (it == declIndex.end())
             BUG("%1% does not exist", a);
-        declarations.erase(it); }
+        declarations.erase(it->second);
+        declIndex.erase(it); }
 
  public:
     using Vector<T>::begin;
     using Vector<T>::end;
 
     IndexedVector() = default;
-    IndexedVector(const IndexedVector &) = default;
+    IndexedVector(const IndexedVector &a) : Vector<T>(a), declarations(a.declarations) {
+        rebuildIndex(); }
     IndexedVector(IndexedVector &&) = default;
-    IndexedVector &operator=(const IndexedVector &) = default;
+    IndexedVector &operator=(const IndexedVector &a) {
+        if (this != &a) {
+            Vector<T>::operator=(a);
+            declarations = a.declarations;
+            rebuildIndex(); }
+        return *this; }
     IndexedVector &operator=(IndexedVector &&) = default;
     explicit IndexedVector(const T *a) {
         push_back(std::move(a)); }
@@ -79,27 +97,28 @@ class IndexedVector : public Vector<T> {
     explicit IndexedVector(const Vector<T> &a) {
         insert(typename Vector<T>::end(), a.begin(), a.end()); }
     explicit IndexedVector(JSONLoader &json);
+    explicit IndexedVector(BinaryLoader &bin);
 
-    void clear() { IR::Vector<T>::clear(); declarations.clear(); }
+    void clear() { IR::Vector<T>::clear(); declarations.clear(); declIndex.clear(); }
     // Although this is not a const_iterator, it should NOT
     // be used to modify the vector directly.  I don't know
     // how to enforce this property, though.
     typedef typename Vector<T>::iterator iterator;
 
     const IDeclaration* getDeclaration(cstring name) const {
-        auto it = declarations.find(name);
-        if (it == declarations.end())
+        auto it = declIndex.find(name);
+        if (it == declIndex.end())
             return nullptr;
-        return it->second; }
+        return *it->second; }
     template <class U>
     const U* getDeclaration(cstring name) const {
-        auto it = declarations.find(name);
-        if (it == declarations.end())
+        auto it = declIndex.find(name);
+        if (it == declIndex.end())
             return nullptr;
-        return it->second->template to<U>(); }
+        return (*it->second)->template to<U>(); }
     Util::Enumerator<const IDeclaration*>* getDeclarations() const {
         return Util::Enumerator<const IDeclaration*>::createEnumerator(
-            Values(declarations).begin(), Values(declarations).end()); }
+            declarations.begin(), declarations.end()); }
     iterator erase(iterator i) {
         removeFromMap(*i);
         return Vector<T>::erase(i); }
@@ -146,6 +165,8 @@ class IndexedVector : public Vector<T> {
 
     void toJSON(JSONGenerator &json) const override;
     static IndexedVector<T>* fromJSON(JSONLoader &json);
+    void toBinary(BinaryGenerator &bin) const override;
+    static IndexedVector<T>* fromBinary(BinaryLoader &bin);
 };
 
 }  // namespace IR
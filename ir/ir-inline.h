@@ -43,7 +43,7 @@ limitations under the License.
 #define DEFINE_VISIT_FUNCTIONS(CLASS, BASE)                                             \
     inline void Visitor::visit(const IR::CLASS *&n, const char *name) {                 \
         auto t = apply_visitor(n, name);                                                \
-        n = dynamic_cast<const IR::CLASS *>(t);                                         \
+        n = t ? t->to<IR::CLASS>() : nullptr;                                           \
         if (t && !n)                                                                    \
             BUG("visitor returned non-" #CLASS " type: %1%", t); }                      \
     inline void Visitor::visit(const IR::CLASS *const &n, const char *name) {           \
@@ -52,7 +52,7 @@ limitations under the License.
     inline void Visitor::visit(const IR::CLASS *&n, const char *name, int cidx) {       \
         ctxt->child_index = cidx;                                                       \
         auto t = apply_visitor(n, name);                                                \
-        n = dynamic_cast<const IR::CLASS *>(t);                                         \
+        n = t ? t->to<IR::CLASS>() : nullptr;                                           \
         if (t && !n)                                                                    \
             BUG("visitor returned non-" #CLASS " type: %1%", t); }                      \
     inline void Visitor::visit(const IR::CLASS *const &n, const char *name, int cidx) { \
@@ -154,6 +154,18 @@ template<class T>
 IR::Vector<T>* IR::Vector<T>::fromJSON(JSONLoader &json) {
     return new Vector<T>(json);
 }
+template<class T> void IR::Vector<T>::toBinary(BinaryGenerator &bin) const {
+    Node::toBinary(bin);
+    bin << vec;
+}
+template<class T>
+IR::Vector<T>::Vector(BinaryLoader &bin) : VectorBase(bin) {
+    bin.load(vec);
+}
+template<class T>
+IR::Vector<T>* IR::Vector<T>::fromBinary(BinaryLoader &bin) {
+    return new Vector<T>(bin);
+}
 
 
 std::ostream &operator<<(std::ostream &out, const IR::Vector<IR::Expression> &v);
@@ -186,8 +198,8 @@ void IR::IndexedVector<T>::toJSON(JSONGenerator &json) const {
     const char *sep = "";
     Vector<T>::toJSON(json);
     json << "," << std::endl << json.indent++ << "\"declarations\" : {";
-    for (auto &k : declarations) {
-        json << sep << std::endl << json.indent << k.first << " : " << k.second;
+    for (auto decl : declarations) {
+        json << sep << std::endl << json.indent << decl->getName().name << " : " << decl;
         sep = ","; }
     --json.indent;
     if (*sep) json << std::endl << json.indent;
@@ -195,12 +207,36 @@ void IR::IndexedVector<T>::toJSON(JSONGenerator &json) const {
 }
 template<class T>
 IR::IndexedVector<T>::IndexedVector(JSONLoader &json) : Vector<T>(json) {
-    json.load("declarations", declarations);
+    ordered_map<cstring, const IDeclaration*> decls;
+    json.load("declarations", decls);
+    for (auto &d : decls)
+        declIndex.emplace(d.first, declarations.insert(declarations.end(), d.second));
 }
 template<class T>
 IR::IndexedVector<T>* IR::IndexedVector<T>::fromJSON(JSONLoader &json) {
     return new IndexedVector<T>(json);
 }
+// The declarations are elements of the vector, so they are written as
+// references to the nodes already written; their order is kept
+template<class T>
+void IR::IndexedVector<T>::toBinary(BinaryGenerator &bin) const {
+    Vector<T>::toBinary(bin);
+    bin.varint(declarations.size());
+    for (auto decl : declarations)
+        bin << decl;
+}
+template<class T>
+IR::IndexedVector<T>::IndexedVector(BinaryLoader &bin) : Vector<T>(bin) {
+    for (size_t size = bin.varint(); size > 0; --size) {
+        const IDeclaration *decl = nullptr;
+        bin.load(decl);
+        declarations.push_back(decl); }
+    rebuildIndex();
+}
+template<class T>
+IR::IndexedVector<T>* IR::IndexedVector<T>::fromBinary(BinaryLoader &bin) {
+    return new IndexedVector<T>(bin);
+}
 IRNODE_DEFINE_APPLY_OVERLOAD(IndexedVector, template<class T>, <T>)
 
 #include "lib/ordered_map.h"
@@ -286,6 +322,33 @@ template<class T, template<class K, class V, class COMP, class ALLOC> class MAP
 IR::NameMap<T, MAP, COMP, ALLOC> *IR::NameMap<T, MAP, COMP, ALLOC>::fromJSON(JSONLoader &json) {
     return new IR::NameMap<T, MAP, COMP, ALLOC>(json);
 }
+template<class T, template<class K, class V, class COMP, class ALLOC> class MAP /*= std::map */,
+         class COMP /*= std::less<cstring>*/,
+         class ALLOC /*= std::allocator<std::pair<cstring, const T*>>*/>
+void IR::NameMap<T, MAP, COMP, ALLOC>::toBinary(BinaryGenerator &bin) const {
+    Node::toBinary(bin);
+    bin.varint(symbols.size());
+    for (auto &k : symbols)
+        bin << k.first << k.second;
+}
+template<class T, template<class K, class V, class COMP, class ALLOC> class MAP /*= std::map */,
+         class COMP /*= std::less<cstring>*/,
+         class ALLOC /*= std::allocator<std::pair<cstring, const T*>>*/>
+IR::NameMap<T, MAP, COMP, ALLOC>::NameMap(BinaryLoader &bin) : Node(bin) {
+    for (size_t size = bin.varint(); size > 0; --size) {
+        cstring name;
+        const T *value = nullptr;
+        bin.load(name);
+        bin.load(value);
+        symbols.emplace(name, value); }
+}
+template<class T, template<class K, class V, class COMP, class ALLOC> class MAP /*= std::map */,
+         class COMP /*= std::less<cstring>*/,
+         class ALLOC /*= std::allocator<std::pair<cstring, const T*>>*/>
+IR::NameMap<T, MAP, COMP, ALLOC> *
+IR::NameMap<T, MAP, COMP, ALLOC>::fromBinary(BinaryLoader &bin) {
+    return new IR::NameMap<T, MAP, COMP, ALLOC>(bin);
+}
 
 template<class KEY, class VALUE,
          template<class K, class V, class COMP, class ALLOC> class MAP /*= std::map */,
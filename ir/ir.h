@@ -48,6 +48,8 @@ limitations under the License.
 
 #include "json_loader.h"
 #include "json_generator.h"
+#include "binary_loader.h"
+#include "binary_generator.h"
 
 #include "pass_manager.h"
 #include "ir-inline.h"
@@ -29,6 +29,9 @@ limitations under the License.
 
 #include "ir.h"
 
+/* Builds IR nodes from the JSON written by JSONGenerator, by calling the
+ * constructors generated from the .def files.  The input is parsed into a
+ * JsonTape first; each JSONLoader refers to one value on the tape. */
 class JSONLoader {
     template<typename T> class has_fromJSON {
         typedef char small;
@@ -42,40 +45,53 @@ class JSONLoader {
 
  public:
     std::unordered_map<int, IR::Node*> &node_refs;
-    JsonData *json;
+    const JsonTape &tape;
+    size_t json;  // the value being loaded, or JsonTape::none
 
-    explicit JSONLoader(std::istream &in) : node_refs(*(new std::unordered_map<int, IR::Node*>()))
-    { in >> json; }
+    explicit JSONLoader(std::istream &in)
+    : node_refs(*(new std::unordered_map<int, IR::Node*>())), tape(*new JsonTape(in)),
+      json(tape.root()) {}
 
-    explicit JSONLoader(JsonData *json)
-    : node_refs(*(new std::unordered_map<int, IR::Node*>())), json(json) {}
+    // 'text' must outlive the loader and the nodes loaded
+    JSONLoader(const char *text, size_t size)
+    : node_refs(*(new std::unordered_map<int, IR::Node*>())), tape(*new JsonTape(text, size)),
+      json(tape.root()) {}
 
-    JSONLoader(JsonData *json, std::unordered_map<int, IR::Node*> &refs)
-    : node_refs(refs), json(json) {}
+    JSONLoader(const JSONLoader &unpacker, size_t json)
+    : node_refs(unpacker.node_refs), tape(unpacker.tape), json(json) {}
 
     JSONLoader(const JSONLoader &unpacker, const std::string &field)
-    : node_refs(unpacker.node_refs), json(nullptr) {
-        if (auto obj = dynamic_cast<JsonObject *>(unpacker.json))
-            json = get(obj, field); }
+    : node_refs(unpacker.node_refs), tape(unpacker.tape),
+      json(tape.find(unpacker.json, field.c_str())) {}
 
  private:
+    bool is(JsonTape::Kind kind) const { return tape.is(json, kind); }
+    std::string text() const { return tape.getString(json).c_str(); }
+
     const IR::Node* get_node() {
-        if (!json || !json->is<JsonObject>()) return nullptr;  // invalid json exception?
-        int id = json->to<JsonObject>()->get_id();
+        if (!is(JsonTape::Object)) return nullptr;  // invalid json exception?
+        size_t idField = tape.find(json, "Node_ID");
+        if (!tape.is(idField, JsonTape::Number)) return nullptr;
+        int id = tape.getInt(idField);
         if (id >= 0) {
-            if (node_refs.find(id) == node_refs.end()) {
-                if (auto fn = get(IR::unpacker_table, json->to<JsonObject>()->get_type()))
-                    node_refs[id] = fn(*this);
+            auto it = node_refs.find(id);
+            if (it == node_refs.end()) {
+                size_t type = tape.find(json, "Node_Type");
+                if (!tape.is(type, JsonTape::String)) return nullptr;
+                if (auto fn = get(IR::unpacker_table, tape.getString(type)))
+                    it = node_refs.emplace(id, fn(*this)).first;
                 else
                     return nullptr; }  // invalid json exception?
-            return node_refs[id]; }
+            return it->second; }
         return nullptr;  // invalid json exception?
     }
 
     template<typename T>
     void unpack_json(vector<T> &v) {
+        if (!is(JsonTape::Array)) return;
         T temp;
-        for (auto e : *json->to<JsonVector>()) {
+        size_t end = tape.next(json);
+        for (size_t e = tape.first(json); e < end; e = tape.next(e)) {
             load(e, temp);
             v.push_back(temp);
         }
@@ -96,41 +112,35 @@ class JSONLoader {
     void unpack_json(IR::NameMap<T, MAP, COMP, ALLOC> *&m) {
         m = IR::NameMap<T, MAP, COMP, ALLOC>::fromJSON(*this); }
 
-    template<typename K, typename V>
-    void unpack_json(std::map<K, V> &v) {
-        std::pair<K, V> temp;
-        for (auto e : *json->to<JsonObject>()) {
-            JsonString* k = new JsonString(e.first);
-            load(k, temp.first);
-            load(e.second, temp.second);
-            v.insert(temp);
-        }
+    // Maps are read from objects, with a key and a value for each field, or
+    // from the arrays of pairs JSONGenerator writes for ordered_maps
+    template<class MAP>
+    void unpack_map(MAP &v) {
+        std::pair<typename MAP::key_type, typename MAP::mapped_type> temp;
+        size_t end = tape.next(json);
+        if (is(JsonTape::Object)) {
+            for (size_t e = tape.first(json); e < end; e = tape.next(e + 1)) {
+                load(e, temp.first);
+                load(e + 1, temp.second);
+                v.insert(temp); }
+        } else if (is(JsonTape::Array)) {
+            for (size_t e = tape.first(json); e < end; e = tape.next(e)) {
+                load(e, temp);
+                v.insert(temp); } }
     }
     template<typename K, typename V>
-    void unpack_json(ordered_map<K, V> &v) {
-        std::pair<K, V> temp;
-        for (auto e : *json->to<JsonObject>()) {
-            JsonString* k = new JsonString(e.first);
-            load(k, temp.first);
-            load(e.second, temp.second);
-            v.insert(temp);
-        }
-    }
+    void unpack_json(std::map<K, V> &v) { unpack_map(v); }
     template<typename K, typename V>
-    void unpack_json(std::multimap<K, V> &v) {
-        std::pair<K, V> temp;
-        for (auto e : *json->to<JsonObject>()) {
-            JsonString* k = new JsonString(e.first);
-            load(k, temp.first);
-            load(e.second, temp.second);
-            v.insert(temp);
-        }
-    }
+    void unpack_json(ordered_map<K, V> &v) { unpack_map(v); }
+    template<typename K, typename V>
+    void unpack_json(std::multimap<K, V> &v) { unpack_map(v); }
 
     template<typename T>
     void unpack_json(std::vector<T> &v) {
+        if (!is(JsonTape::Array)) return;
         T temp;
-        for (auto e : *json->to<JsonVector>()) {
+        size_t end = tape.next(json);
+        for (size_t e = tape.first(json); e < end; e = tape.next(e)) {
             load(e, temp);
             v.push_back(temp);
         }
@@ -138,32 +148,38 @@ class JSONLoader {
 
     template<typename T, typename U>
     void unpack_json(std::pair<T, U> &v) {
-        const JsonObject* obj = json->to<JsonObject>();
-        load(::get(obj, "first"), v.first);
-        load(::get(obj, "second"), v.second);
+        load("first", v.first);
+        load("second", v.second);
     }
 
-    void unpack_json(bool &v) { v = *json->to<JsonBoolean>(); }
+    void unpack_json(bool &v) { v = tape.getBool(json); }
 
     template<typename T>
     typename std::enable_if<std::is_integral<T>::value>::type
-    unpack_json(T &v) { v = *json->to<JsonNumber>(); }
-    void unpack_json(mpz_class &v) { v = json->to<JsonNumber>()->val; }
-    void unpack_json(cstring &v) { v = *json->to<std::string>(); }
-    void unpack_json(IR::ID &v) { v.name = *json->to<std::string>(); }
+    unpack_json(T &v) {
+        if (tape.isInt(json))
+            v = tape.getInt(json);
+        else if (is(JsonTape::Number))
+            v = tape.getNumber(json).get_si(); }  // Does not handle overflow
+    void unpack_json(mpz_class &v) {
+        if (is(JsonTape::Number)) v = tape.getNumber(json); }
+    void unpack_json(cstring &v) {
+        v = is(JsonTape::String) ? tape.getString(json) : cstring(); }
+    void unpack_json(IR::ID &v) {
+        if (is(JsonTape::String)) v.name = tape.getString(json); }
 
     void unpack_json(LTBitMatrix &m) {
-        if (auto *s = json->to<std::string>())
-            s->c_str() >> m; }
+        if (is(JsonTape::String))
+            text().c_str() >> m; }
 
     template<typename T> typename std::enable_if<std::is_enum<T>::value>::type
     unpack_json(T &v) {
-        if (auto *s = json->to<std::string>())
-            *s >> v; }
+        if (is(JsonTape::String))
+            text() >> v; }
 
     void unpack_json(match_t &v) {
-        if (auto *s = json->to<std::string>())
-            s->c_str() >> v; }
+        if (is(JsonTape::String))
+            text().c_str() >> v; }
 
     template<typename T>
     typename std::enable_if<has_fromJSON<T>::value && !std::is_base_of<IR::Node, T>::value>::type
@@ -179,24 +195,24 @@ class JSONLoader {
 
     template<typename T, size_t N>
     void unpack_json(T (&v)[N]) {
-        if (auto *j = json->to<JsonVector>()) {
-            for (size_t i = 0; i < N && i < j->size(); ++i) {
-                json = (*j)[i];
-                unpack_json(v[i]); } } }
+        if (!is(JsonTape::Array)) return;
+        size_t e = tape.first(json);
+        for (size_t i = 0; i < N && i < tape.size(json); ++i, e = tape.next(e))
+            load(e, v[i]); }
 
  public:
     template<typename T>
-    void load(JsonData* json, T &v) {
-        JSONLoader(json, node_refs).unpack_json(v); }
+    void load(size_t json, T &v) {
+        JSONLoader(*this, json).unpack_json(v); }
 
     template<typename T>
     void load(const std::string field, T &v) {
         JSONLoader loader(*this, field);
-        if (loader.json == nullptr) return;
+        if (loader.json == JsonTape::none) return;
         loader.unpack_json(v); }
 
     template<typename T> JSONLoader& operator>>(T &v) {
-        unpack_json(v);
+        if (json != JsonTape::none) unpack_json(v);
         return *this; }
 };
 
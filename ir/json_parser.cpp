@@ -0,0 +1,143 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <string.h>
+#include <algorithm>
+#include <iterator>
+#include "json_parser.h"
+#include "lib/error.h"
+
+constexpr size_t JsonTape::none;
+
+JsonTape::JsonTape(std::istream &in)
+: buffer(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()),
+  text(buffer.data()), textSize(buffer.size()) { parse(); }
+
+JsonTape::JsonTape(const char *text, size_t size) : text(text), textSize(size) { parse(); }
+
+void JsonTape::add(Entry e, std::vector<size_t> &open) {
+    if (!open.empty())
+        entries[open.back()].length++;
+    entries.push_back(e);
+}
+
+static bool isSpace(char ch) { return ch == ' ' || ch == '\n' || ch == '\t' || ch == '\r'; }
+
+/* Like the JSON written by JSONGenerator, strings have no escapes, and
+ * separators are not checked.  Parsing stops after the first value; on an
+ * error the tape is left empty. */
+void JsonTape::parse() {
+    const char *p = text, *end = text + textSize;
+    std::vector<size_t> open;  // the containers not closed yet
+    entries.reserve(textSize / 16);
+    do {
+        while (p < end && (isSpace(*p) || *p == ',' || *p == ':'))
+            ++p;
+        if (p == end) {
+            if (!open.empty()) {
+                ::error("Unterminated JSON input");
+                entries.clear(); }
+            break; }
+        const char *start = p;
+        switch (*p) {
+        case '{':
+        case '[':
+            add(Entry(*p++ == '{' ? Object : Array), open);
+            open.push_back(entries.size() - 1);
+            break;
+        case '}':
+        case ']':
+            if (open.empty() || entries[open.back()].kind != (*p == '}' ? Object : Array)) {
+                ::error("Unbalanced '%1%' in JSON input at offset %2%", *p, p - text);
+                open.clear();
+                entries.clear();
+                p = end;
+                break; }
+            entries[open.back()].end = entries.size();
+            open.pop_back();
+            ++p;
+            break;
+        case '"': {
+            auto close = static_cast<const char *>(memchr(p + 1, '"', end - p - 1));
+            if (!close) {
+                ::error("Unterminated string in JSON input at offset %1%", p - text);
+                open.clear();
+                entries.clear();
+                p = end;
+                break; }
+            Entry e(String);
+            e.offset = p + 1 - text;
+            e.length = close - p - 1;
+            add(e, open);
+            p = close + 1;
+            break; }
+        case '-': case '0': case '1': case '2': case '3': case '4':
+        case '5': case '6': case '7': case '8': case '9': {
+            Entry e(Number);
+            bool negative = *p == '-';
+            if (negative) ++p;
+            uint64_t value = 0;
+            int digits = 0;
+            for (; p < end && *p >= '0' && *p <= '9'; ++p, ++digits)
+                value = value * 10 + (*p - '0');
+            // anything wider than 18 digits, or not an integer, is kept as text
+            while (p < end && ((*p >= '0' && *p <= '9') || (*p && strchr(".eE+-", *p))))
+                ++p, digits = 100;
+            if (digits > 18) {
+                e.wide = true;
+                e.offset = start - text;
+                e.length = p - start;
+            } else {
+                e.value = negative ? -int64_t(value) : int64_t(value); }
+            add(e, open);
+            break; }
+        case 't': case 'T':
+            add(Entry(True), open);
+            p += std::min<size_t>(4, end - p);
+            break;
+        case 'f': case 'F':
+            add(Entry(False), open);
+            p += std::min<size_t>(5, end - p);
+            break;
+        case 'n': case 'N':
+            add(Entry(Null), open);
+            p += std::min<size_t>(4, end - p);
+            break;
+        default:
+            ::error("Unexpected '%1%' in JSON input at offset %2%", *p, p - text);
+            open.clear();
+            entries.clear();
+            p = end;
+            break; }
+    } while (!open.empty());
+}
+
+size_t JsonTape::find(size_t i, const char *key) const {
+    if (!is(i, Object)) return none;
+    size_t length = strlen(key);
+    size_t end = entries[i].end;
+    for (size_t k = first(i); k < end; k = next(k + 1)) {
+        auto &e = entries[k];
+        if (e.length == length && !memcmp(text + e.offset, key, length))
+            return k + 1; }
+    return none;
+}
+
+mpz_class JsonTape::getNumber(size_t i) const {
+    auto &e = entries.at(i);
+    if (!e.wide) return mpz_class(static_cast<long>(e.value));
+    return mpz_class(std::string(text + e.offset, e.length));
+}
@@ -1,208 +1,80 @@
 #ifndef IR_JSON_PARSER_H_
 #define IR_JSON_PARSER_H_
 
-#include <vector>
-#include <map>
-#include <iostream>
-#include <fstream>
+#include <stdint.h>
+#include <string.h>
 #include <istream>
-#include <sstream>
+#include <string>
+#include <vector>
 
-#include "../lib/ordered_map.h"
+#include "../lib/cstring.h"
 #include "../lib/gmputil.h"
 
-class JsonData {
- public:
-    JsonData() {}
-    JsonData(const JsonData&) = default;
-    JsonData(JsonData&&) = default;
-    JsonData &operator=(const JsonData &) & = default;
-    JsonData &operator=(JsonData &&) & = default;
-    template<typename T> bool is() const { return to<T>() != nullptr; }
-    template<typename T> const T* to() const { return dynamic_cast<const T*>(this); }
-    virtual ~JsonData() {}
-};
-
-class JsonNumber : public JsonData {
- public:
-    JsonNumber(mpz_class v) : val(v) {}   // NOLINT(runtime/explicit)
-    operator int() const { return val.get_si(); }  // Does not handle overflow
-    mpz_class val;
-};
-
-class JsonBoolean : public JsonData {
+/* The JSON read by JSONLoader, parsed in one pass over the whole text into a
+ * 'tape': a flat vector with one entry per value, in the order they appear.
+ * An array entry is followed by its elements and an object entry by its
+ * fields, each as a string entry for the key followed by the value; container
+ * entries record where they end, so a value can be skipped in constant time.
+ * Strings and wide numbers refer back into the text, which is not copied when
+ * it is a caller's buffer (such as a mapped file).
+ * Values are referred to by their index in the tape; 'none' stands for a
+ * missing value. */
+class JsonTape {
  public:
-    JsonBoolean(bool v) : val(v) {}   // NOLINT(runtime/explicit)
-    operator bool() const { return val; }
-    bool val;
-};
-
-class JsonString : public JsonData, public std::string {
- public:
-    JsonString() {}
-    JsonString(const std::string &s) : std::string(s) {}    // NOLINT(runtime/explicit)
-    JsonString(const char *s) : std::string(s) {}           // NOLINT(runtime/explicit)
-    JsonString(const JsonString&) = default;
-    JsonString(JsonString&&) = default;
-    JsonString &operator=(const JsonString&) & = default;
-    JsonString &operator=(JsonString&&) & = default;
-    operator cstring() { return cstring(*this); }
-};
-
-class JsonVector : public JsonData, public std::vector<JsonData*> {
- public:
-    JsonVector() {}
-    JsonVector(const std::vector<JsonData*> & v)   // NOLINT(runtime/explicit)
-    : std::vector<JsonData*>(v) {}
-    JsonVector &operator=(const JsonVector&) & = default;
-    JsonVector &operator=(JsonVector&&) & = default;
-};
+    enum Kind : uint8_t { Null, True, False, Number, String, Array, Object };
+    static constexpr size_t none = ~size_t(0);
+
+ private:
+    struct Entry {
+        Kind            kind;
+        bool            wide = false;  // a Number that does not fit in 'value'
+        uint32_t        length = 0;    // children of containers, characters of text
+        union {
+            int64_t     value;         // Number
+            size_t      offset;        // String and wide Number: start in the text
+            size_t      end;           // Array and Object: index after the last child
+        };
+        explicit Entry(Kind kind) : kind(kind), value(0) {}
+    };
+    std::string         buffer;  // the text, unless it is a caller's buffer
+    const char          *text;
+    size_t              textSize;
+    std::vector<Entry>  entries;
+
+    void parse();
+    void add(Entry e, std::vector<size_t> &open);
 
-class JsonObject : public JsonData, public ordered_map<std::string, JsonData*>  {
  public:
-    JsonObject &operator=(JsonObject&&) & = default;
-    JsonObject(const ordered_map<std::string, JsonData*> & v)  // NOLINT(runtime/explicit)
-    : ordered_map<std::string, JsonData*>(v) {}
-    int get_id() const {
-        if (find("Node_ID") == end())
-            return -1;
-        else
-            return *(find("Node_ID")->second->to<JsonNumber>());
-    }
-
-    std::string get_type() const {
-        if (find("Node_Type") == end())
-            return "";
-        else
-            return *(dynamic_cast<JsonString*>(find("Node_Type")->second));
-    }
+    explicit JsonTape(std::istream &in);
+    // 'text' must outlive the tape
+    JsonTape(const char *text, size_t size);
+
+    size_t root() const { return entries.empty() ? none : 0; }
+    Kind kind(size_t i) const { return entries.at(i).kind; }
+    bool is(size_t i, Kind k) const { return i != none && entries.at(i).kind == k; }
+    // number of elements of an array or fields of an object
+    size_t size(size_t i) const {
+        auto &e = entries.at(i);
+        return e.kind == Object ? e.length / 2 : e.length; }
+    // the first element of an array, or the key of the first field of an object
+    size_t first(size_t i) const { return i + 1; }
+    // the value that follows value i
+    size_t next(size_t i) const {
+        auto &e = entries.at(i);
+        return e.kind == Array || e.kind == Object ? e.end : i + 1; }
+    // the value of field 'key' of object i, or none
+    size_t find(size_t i, const char *key) const;
+
+    bool getBool(size_t i) const { return entries.at(i).kind == True; }
+    bool isInt(size_t i) const { return entries.at(i).kind == Number && !entries.at(i).wide; }
+    int64_t getInt(size_t i) const { return entries.at(i).value; }
+    mpz_class getNumber(size_t i) const;
+    cstring getString(size_t i) const {
+        auto &e = entries.at(i);
+        return cstring(text + e.offset, text + e.offset + e.length); }
+    bool equals(size_t i, const char *s) const {
+        auto &e = entries.at(i);
+        return e.kind == String && strlen(s) == e.length && !memcmp(text + e.offset, s, e.length); }
 };
 
-class JsonNull : public JsonData {};
-
-// Hack to make << operator work multi-threaded
-static thread_local int level = 0;
-
-inline std::string getIndent(int l) {
-    std::stringstream ss;
-    for (int i = 0; i < l*4; i++) ss << " ";
-    return ss.str();
-}
-
-inline std::ostream& operator<<(std::ostream &out, JsonData* json) {
-    if (dynamic_cast<JsonObject*>(json)) {
-        auto obj = dynamic_cast<ordered_map<std::string, JsonData*>*>(json);
-        out << "{";
-        if (obj->size() > 0) {
-            level++;
-            out << std::endl;
-            for (auto &e : *obj)
-                out << getIndent(level) << e.first << " : " << e.second << "," << std::endl;
-            out << getIndent(--level);
-        }
-        out << "}";
-    } else if (dynamic_cast<JsonVector*>(json)) {
-        std::vector<JsonData*>* vec = dynamic_cast<std::vector<JsonData*>*>(json);
-        out << "[";
-        if (vec->size() > 0) {
-            level++;
-            out << std::endl;
-            for (auto &e : *vec) {
-                out << getIndent(level) << e << "," << std::endl;
-            }
-            out << getIndent(--level);
-        }
-        out << "]";
-    } else if (dynamic_cast<JsonString*>(json)) {
-        JsonString* s = dynamic_cast<JsonString*>(json);
-        out << "\"" << s->c_str() << "\"";
-
-    } else if (dynamic_cast<JsonNumber*>(json)) {
-        JsonNumber* num = dynamic_cast<JsonNumber*>(json);
-        out << num->val;
-
-    } else if (dynamic_cast<JsonBoolean*>(json)) {
-        JsonBoolean *b = dynamic_cast<JsonBoolean*>(json);
-        out << (b->val ? "true" : "false");
-    } else if (dynamic_cast<JsonNull*>(json)) {
-        out << "null";
-    }
-    return out;
-}
-
-
-inline std::istream& operator>>(std::istream &in, JsonData*& json) {
-    while (in) {
-        char ch;
-        in >> ch;
-        switch (ch) {
-        case '{': {
-            ordered_map<std::string, JsonData*> obj;
-            do {
-                in >> std::ws >> ch;
-                if (ch == '}')
-                    break;
-                in.unget();
-
-                JsonData *key, *val;
-                in >> key >> std::ws >> ch >> std::ws >> val;
-                obj[*(dynamic_cast<std::string*>(key))] = val;
-
-                in >> std::ws >> ch;
-            } while (in && ch != '}');
-
-            json = new JsonObject(obj);
-            return in;
-        }
-        case '[': {
-            std::vector<JsonData*> vec;
-            do {
-                in >> std::ws >> ch;
-                if (ch == ']')
-                    break;
-                in.unget();
-
-                JsonData *elem;
-                in >> elem;
-                vec.push_back(elem);
-
-                in >> std::ws >> ch;
-            } while (in && ch != ']');
-
-            json = new JsonVector(vec);
-            return in;
-        }
-        case '"': {
-            std::string s;
-            getline(in, s, '"');
-            json = new JsonString(s);
-            return in;
-        }
-        case '-': case '0': case '1': case '2': case '3':
-        case '4': case '5': case '6': case '7': case '8': case '9': {
-            mpz_class num;
-            in.unget();
-            in >> num;
-            json = new JsonNumber(num);
-            return in;
-        }
-        case 't': case 'T':
-            in.ignore(3);
-            json = new JsonBoolean(true);
-            return in;
-        case 'f': case 'F':
-            in.ignore(4);
-            json = new JsonBoolean(false);
-            return in;
-        case 'n': case 'N':
-            in.ignore(3);
-            json = new JsonNull();
-            return in;
-        default:
-            return in;
-        }
-    }
-    return in;
-}
-
 #endif /* IR_JSON_PARSER_H_ */
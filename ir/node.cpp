@@ -21,7 +21,7 @@ void IR::Node::traceVisit(const char* visitor) const
 
 void IR::Node::traceCreation() const { LOG5("Created node " << id); }
 
-int IR::Node::currentId = 0;
+std::atomic<int> IR::Node::currentId(0);
 
 void IR::Node::toJSON(JSONGenerator &json) const {
     json << json.indent << "\"Node_ID\" : " << id << ", " << std::endl
@@ -36,6 +36,20 @@ IR::Node::Node(JSONLoader &json) : id(-1) {
         currentId = id+1;
 }
 
+// The type name is written by BinaryGenerator::node, which needs it first
+void IR::Node::toBinary(BinaryGenerator &bin) const {
+    bin << srcInfo << id;
+}
+
+IR::Node::Node(BinaryLoader &bin) : id(-1) {
+    bin.load(srcInfo);
+    bin.load(id);
+    if (id < 0)
+        id = currentId++;
+    else if (id >= currentId)
+        currentId = id+1;
+}
+
 // Abbreviated debug print
 cstring IR::dbp(const IR::INode* node) {
     std::stringstream str;
@@ -17,7 +17,10 @@ limitations under the License.
 #ifndef _IR_NODE_H_
 #define _IR_NODE_H_
 
+#include <atomic>
 #include <memory>
+#include <type_traits>
+#include <typeinfo>
 #include "std.h"
 #include "lib/cstring.h"
 #include "lib/stringify.h"
@@ -32,10 +35,13 @@ class Modifier;
 class Transform;
 class JSONGenerator;
 class JSONLoader;
+class BinaryGenerator;
+class BinaryLoader;
 
 namespace IR {
 
 class Node;
+template<class T, class = void> struct NodeCast;
 
 template<class T> class Vector;
 template<class T> class IndexedVector;
@@ -48,6 +54,7 @@ class INode : public Util::IHasSourceInfo, public IHasDbPrint {
     virtual void dbprint(std::ostream &out) const = 0;  // for debugging
     virtual cstring toString() const = 0;  // for user consumption
     virtual void toJSON(JSONGenerator &) const = 0;
+    virtual void toBinary(BinaryGenerator &) const = 0;
     virtual cstring node_type_name() const = 0;
     virtual void validate() const {}
     template<typename T> bool is() const;
@@ -68,7 +75,7 @@ class Node : public virtual INode {
     virtual void apply_visitor_revisit(Transform &v, const Node *n) const;
 
  protected:
-    static int currentId;
+    static std::atomic<int> currentId;
     void traceVisit(const char* visitor) const;
     virtual void visit_children(Visitor &) { }
     virtual void visit_children(Visitor &) const { }
@@ -96,12 +103,19 @@ class Node : public virtual INode {
     cstring node_type_name() const override { return "Node"; }
     static cstring static_type_name() { return "Node"; }
     virtual int num_children() { return 0; }
+    /// The number of the class of this node; see NodeCast.
+    virtual unsigned node_kind() const { return 0; }
     template<typename T> bool is() const { return to<T>() != nullptr; }
-    template<typename T> const T *to() const { return dynamic_cast<const T*>(this); }
-    template<typename T> const T &as() const { return dynamic_cast<const T&>(*this); }
+    template<typename T> const T *to() const { return NodeCast<T>::to(this); }
+    template<typename T> const T &as() const {
+        auto *rv = to<T>();
+        if (!rv) throw std::bad_cast();
+        return *rv; }
     explicit Node(JSONLoader &json);
+    explicit Node(BinaryLoader &bin);
     cstring toString() const override { return node_type_name(); }
     void toJSON(JSONGenerator &json) const override;
+    void toBinary(BinaryGenerator &bin) const override;
     virtual bool operator==(const Node &a) const { return typeid(*this) == typeid(a); }
 #define DEFINE_OPEQ_FUNC(CLASS, BASE) \
     virtual bool operator==(const CLASS &) const { return false; }
@@ -111,6 +125,25 @@ class Node : public virtual INode {
     bool operator!=(const Node &n) const { return !operator==(n); }
 };
 
+/* ir-generator numbers the IR classes in a preorder walk of the class hierarchy, so
+ * the subclasses of a generated class T are exactly the classes numbered
+ * [T::static_kind, T::static_kind_end), and a downcast to T is a range check.
+ * Classes that are not generated (the Vector and map templates) and interfaces
+ * fall back to dynamic_cast. */
+template<class T, class> struct NodeCast {
+    static const T *to(const Node *n) { return dynamic_cast<const T *>(n); }
+};
+template<class T> struct NodeCast<T, typename std::enable_if<
+        std::is_same<decltype(&T::node_kind), unsigned (T::*)() const>::value>::type> {
+    static const T *to(const Node *n) {
+        // some callers rely on dynamic_cast semantics for a null pointer
+        return n && n->node_kind() - T::static_kind < T::static_kind_end - T::static_kind
+               ? static_cast<const T *>(n) : nullptr; }
+};
+template<> struct NodeCast<Node> {
+    static const Node *to(const Node *n) { return n; }
+};
+
 // simple version of dbprint
 cstring dbp(const INode* node);
 
@@ -14,6 +14,9 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+#include <atomic>
+#include <exception>
+#include <thread>
 #include "ir.h"
 #include "lib/gc.h"
 #include "lib/n4.h"
@@ -25,6 +28,13 @@ const IR::Node *PassManager::apply_visitor(const IR::Node *program, const char *
     BUG_CHECK(running, "not calling apply properly");
     for (auto it = passes.begin(); it != passes.end();) {
         Visitor* v = *it;
+        auto usage = dynamic_cast<AnalysisUsage *>(v);
+        if (usage && usage->upToDate(program)) {
+            LOG1(name() << " skipping " << v->name() << ": analyses are up to date");
+            runDebugHooks(v->name(), program);
+            seqNo++;
+            it++;
+            continue; }
         if (auto b = dynamic_cast<Backtrack *>(v)) {
             if (!b->never_backtracks()) {
                 backup.emplace_back(it, program); } }
@@ -32,7 +42,19 @@ const IR::Node *PassManager::apply_visitor(const IR::Node *program, const char *
             try {
                 size_t maxmem;
                 LOG1(name() << " invoking " << v->name());
+                vector<ProgramAnalysis *> preserved;
+                if (usage) {
+                    for (auto a : usage->required)
+                        BUG_CHECK(a->validFor(program), "%1%: required analysis is not up to "
+                                  "date", v->name());
+                    for (auto a : usage->preserved)
+                        if (a->validFor(program))
+                            preserved.push_back(a); }
+                auto before = program;
                 program = program->apply(**it);
+                if (program && program != before)
+                    for (auto a : preserved)
+                        a->revalidate(program);
                 LOG3("heap after " << v->name() << ": in use " <<
                      n4(gc_mem_inuse(&maxmem)) << "B, max " << n4(maxmem) << "B");
                 int errors = ErrorReporter::instance.getErrorCount();
@@ -67,6 +89,18 @@ const IR::Node *PassManager::apply_visitor(const IR::Node *program, const char *
     return program;
 }
 
+bool AnalysisUsage::upToDate(const IR::Node *program) const {
+    if (computed.empty())
+        return false;
+    for (auto a : computed)
+        if (!a->validFor(program))
+            return false;
+    for (auto a : required)
+        if (!a->validFor(program))
+            return false;
+    return true;
+}
+
 bool PassManager::backtrack(trigger &trig) {
     for (Visitor *v : passes)
         if (auto *bt = dynamic_cast<Backtrack *>(v))
@@ -117,3 +151,69 @@ const IR::Node *PassRepeatUntil::apply_visitor(const IR::Node *program, const ch
     } while (!done());
     return program;
 }
+
+unsigned ParallelContainers::threads = 1;
+
+bool ParallelContainers::splittable(const IR::P4Program *program) {
+    if (Log::enabled() || !threadsafe_alloc())
+        return false;
+    unsigned containers = 0;
+    for (auto decl : *program->declarations) {
+        if (decl->is<IR::P4Control>() || decl->is<IR::P4Parser>())
+            ++containers;
+        else if (decl->is<IR::P4Action>() || decl->is<IR::Function>())
+            return false;
+        else if (auto inst = decl->to<IR::Declaration_Instance>())
+            if (inst->initializer)
+                return false; }
+    return containers > 1;
+}
+
+const IR::Node *ParallelContainers::apply_visitor(const IR::Node *n, const char *) {
+    auto program = n->to<IR::P4Program>();
+    unsigned nthreads = threads ? threads : std::thread::hardware_concurrency();
+    if (!program || nthreads < 2 || !splittable(program))
+        return n->apply(*make());
+
+    vector<const IR::Node *> units;
+    for (auto decl : *program->declarations)
+        if (decl->is<IR::P4Control>() || decl->is<IR::P4Parser>())
+            units.push_back(decl);
+    vector<const IR::Node *> results(units.size());
+    vector<std::exception_ptr> failures(units.size());
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t i; (i = next++) < units.size();) {
+            try {
+                results[i] = units[i]->apply(*make());
+            } catch (...) {
+                failures[i] = std::current_exception(); } } };
+    vector<std::thread> pool;
+    nthreads = std::min<size_t>(nthreads, units.size());
+    for (unsigned i = 1; i < nthreads; ++i)
+        pool.emplace_back(worker);
+    worker();
+    for (auto &t : pool)
+        t.join();
+    // report the failure the sequential pass would have hit first
+    for (auto &f : failures)
+        if (f) std::rethrow_exception(f);
+
+    bool changed = false;
+    for (size_t i = 0; i < units.size(); ++i)
+        changed |= results[i] != units[i];
+    if (!changed)
+        return program;
+    auto declarations = new IR::IndexedVector<IR::Node>;
+    auto result = results.begin();
+    for (auto decl : *program->declarations) {
+        if (decl->is<IR::P4Control>() || decl->is<IR::P4Parser>())
+            decl = *result++;
+        if (auto vec = decl ? decl->to<IR::Vector<IR::Node>>() : nullptr)
+            declarations->append(*vec);
+        else if (decl)
+            declarations->push_back(decl); }
+    auto rv = program->clone();
+    rv->declarations = declarations;
+    return rv;
+}
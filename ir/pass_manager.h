@@ -22,6 +22,38 @@ limitations under the License.
 typedef std::function<void(const char* manager, unsigned seqNo,
                            const char* pass, const IR::Node* node)> DebugHook;
 
+// An analysis of a whole program, such as a reference or type map, that is
+// computed for one particular program.
+class ProgramAnalysis {
+ public:
+    virtual ~ProgramAnalysis() {}
+    // True if the analysis is up to date for @program
+    virtual bool validFor(const IR::Node *program) const = 0;
+    // Called after a pass that preserves the analysis changed the program
+    // into @program
+    virtual void revalidate(const IR::Node *program) = 0;
+};
+
+// Mixin for passes to declare which ProgramAnalyses they compute, require and
+// preserve.  A PassManager skips a pass whose computed analyses are all still
+// valid, and revalidates the analyses a pass preserves when it changes the
+// program.  A pass preserving an analysis must keep it up to date for every
+// node it creates.
+class AnalysisUsage {
+    vector<ProgramAnalysis *>   computed, required, preserved;
+    friend class PassManager;
+
+ protected:
+    void declareComputes(ProgramAnalysis *a) { computed.push_back(a); }
+    void declareRequires(ProgramAnalysis *a) { required.push_back(a); }
+    void declarePreserves(ProgramAnalysis *a) { preserved.push_back(a); }
+
+ public:
+    virtual ~AnalysisUsage() {}
+    // True if running the pass on @program would only recompute valid analyses
+    bool upToDate(const IR::Node *program) const;
+};
+
 class PassManager : virtual public Visitor, virtual public Backtrack {
     bool early_exit_flag;
     mutable int never_backtracks_cache = -1;
@@ -86,6 +118,36 @@ class VisitFunctor : virtual public Visitor {
     : fn([f](const IR::Node *n)->const IR::Node *{ f(); return n; }) { setName("VisitFunctor"); }
 };
 
+// Runs a pass separately on each top-level control and parser of a P4Program,
+// spreading the containers over a pool of worker threads, and stitches the
+// results back together in program order, so the output does not depend on
+// the number of threads or on scheduling -- except for the ids of the nodes
+// created by the pass, which are handed out in the order the threads ask for
+// them.  @make is called once per container to create a fresh instance of the
+// pass.
+//
+// Only suitable for passes whose effect on a container depends on nothing
+// outside it, that leave everything else in the program alone, and that don't
+// write shared state -- in particular they must not add to the TypeMap or
+// ReferenceMap (e.g., via newName) or report errors.  Reading the maps is fine.
+// Falls back to running a single instance over the whole program when there
+// is only one thread or container, when logging is on, when the allocator is
+// not threadsafe, or when there is executable code outside the containers
+// (top-level actions, functions or instance initializers), which a pass may
+// need to see while processing the containers.
+class ParallelContainers : virtual public Visitor {
+    std::function<Visitor *()>  make;
+    const IR::Node *apply_visitor(const IR::Node *, const char * = 0) override;
+    static bool splittable(const IR::P4Program *);
+
+ public:
+    // number of worker threads to use; 0 means one per core.  Defaults to 1,
+    // so that node ids, and thus the --toJSON output, are reproducible.
+    static unsigned threads;
+    explicit ParallelContainers(std::function<Visitor *()> make) : make(make)
+    { setName("ParallelContainers"); }
+};
+
 class DynamicVisitor : virtual public Visitor {
     Visitor     *visitor;
     profile_t init_apply(const IR::Node *root) override {
@@ -14,7 +14,10 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+#include <mutex>
+
 #include "ir.h"
+#include "lib/gc.h"
 
 namespace IR {
 
@@ -36,12 +39,17 @@ const cstring IR::Annotation::nameAnnotation = "name";
 std::map<int, const IR::Type_Bits*> *Type_Bits::signedTypes = nullptr;
 std::map<int, const IR::Type_Bits*> *Type_Bits::unsignedTypes = nullptr;
 
-int Type_Declaration::nextId = 0;
-int Type_InfInt::nextId = 0;
+std::atomic<int> Type_Declaration::nextId(0);
+std::atomic<int> Type_InfInt::nextId(0);
 
 Annotations* Annotations::empty = new Annotations(Vector<Annotation>());
 
+// Type_Bits::get may be called from the worker threads of ParallelContainers
+static std::mutex typeBitsMutex;
+
 const Type_Bits* Type_Bits::get(int width, bool isSigned) {
+    std::lock_guard<std::mutex> lock(typeBitsMutex);
+    OutsideArena permanent;  // the canonical types outlive the compilation
     std::map<int, const IR::Type_Bits*> *&map = isSigned ? signedTypes : unsignedTypes;
     if (map == nullptr)
         map = new std::map<int, const IR::Type_Bits*>();
@@ -52,23 +60,20 @@ const Type_Bits* Type_Bits::get(int width, bool isSigned) {
 }
 
 const Type::Unknown *Type::Unknown::get() {
-    static const Type::Unknown *singleton = nullptr;
-    if (!singleton)
-        singleton = (new Type::Unknown(Util::SourceInfo()));
+    OutsideArena permanent;
+    static const Type::Unknown *singleton = new Type::Unknown(Util::SourceInfo());
     return singleton;
 }
 
 const Type::Boolean *Type::Boolean::get() {
-    static const Type::Boolean *singleton = nullptr;
-    if (!singleton)
-        singleton = (new Type::Boolean(Util::SourceInfo()));
+    OutsideArena permanent;
+    static const Type::Boolean *singleton = new Type::Boolean(Util::SourceInfo());
     return singleton;
 }
 
 const Type_String *Type_String::get() {
-    static const Type_String *singleton = nullptr;
-    if (!singleton)
-        singleton = (new Type_String(Util::SourceInfo()));
+    OutsideArena permanent;
+    static const Type_String *singleton = new Type_String(Util::SourceInfo());
     return singleton;
 }
 
@@ -89,30 +94,26 @@ const Type::Varbits *Type::Varbits::get() {
 }
 
 const Type_Dontcare *Type_Dontcare::get() {
-    static const Type_Dontcare *singleton;
-    if (!singleton)
-        singleton = (new Type_Dontcare(Util::SourceInfo()));
+    OutsideArena permanent;
+    static const Type_Dontcare *singleton = new Type_Dontcare(Util::SourceInfo());
     return singleton;
 }
 
 const Type_State *Type_State::get() {
-    static const Type_State *singleton;
-    if (!singleton)
-        singleton = (new Type_State(Util::SourceInfo()));
+    OutsideArena permanent;
+    static const Type_State *singleton = new Type_State(Util::SourceInfo());
     return singleton;
 }
 
 const Type_Void *Type_Void::get() {
-    static const Type_Void *singleton;
-    if (!singleton)
-        singleton = (new Type_Void(Util::SourceInfo()));
+    OutsideArena permanent;
+    static const Type_Void *singleton = new Type_Void(Util::SourceInfo());
     return singleton;
 }
 
 const Type_MatchKind *Type_MatchKind::get() {
-    static const Type_MatchKind *singleton;
-    if (!singleton)
-        singleton = (new Type_MatchKind(Util::SourceInfo()));
+    OutsideArena permanent;
+    static const Type_MatchKind *singleton = new Type_MatchKind(Util::SourceInfo());
     return singleton;
 }
 
@@ -18,12 +18,14 @@ limitations under the License.
 #include "dbprint.h"
 #include "lib/gmputil.h"
 #include "lib/bitops.h"
+#include "lib/gc.h"
 
 #define SINGLETON_TYPE(NAME)                                    \
 const IR::Type_##NAME *IR::Type_##NAME::get() {                 \
     static const Type_##NAME *singleton;                        \
-    if (!singleton)                                             \
-        singleton = (new Type_##NAME(Util::SourceInfo()));      \
+    if (!singleton) {                                           \
+        OutsideArena permanent;                                 \
+        singleton = (new Type_##NAME(Util::SourceInfo())); }    \
     return singleton;                                           \
 }
 SINGLETON_TYPE(Block)
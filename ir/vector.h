@@ -43,6 +43,7 @@ class VectorBase : public Node {
     VectorBase &operator=(VectorBase &&) = default;
  protected:
     explicit VectorBase(JSONLoader &json) : Node(json) {}
+    explicit VectorBase(BinaryLoader &bin) : Node(bin) {}
 };
 
 // This class should only be used in the IR.
@@ -57,6 +58,7 @@ class Vector : public VectorBase {
     Vector(const Vector &) = default;
     Vector(Vector &&) = default;
     explicit Vector(JSONLoader &json);
+    explicit Vector(BinaryLoader &bin);
     Vector &operator=(const Vector &) = default;
     Vector &operator=(Vector &&) = default;
     explicit Vector(const T *a) {
@@ -65,6 +67,7 @@ class Vector : public VectorBase {
         vec.insert(vec.end(), a.begin(), a.end()); }
     Vector(const std::initializer_list<const T *> &a) : vec(a) {}
     static Vector<T>* fromJSON(JSONLoader &json);
+    static Vector<T>* fromBinary(BinaryLoader &bin);
     typedef typename vector<const T *>::iterator        iterator;
     typedef typename vector<const T *>::const_iterator  const_iterator;
     iterator begin() { return vec.begin(); }
@@ -140,6 +143,7 @@ class Vector : public VectorBase {
     virtual void parallel_visit_children(Visitor &v);
     virtual void parallel_visit_children(Visitor &v) const;
     void toJSON(JSONGenerator &json) const override;
+    void toBinary(BinaryGenerator &bin) const override;
     Util::Enumerator<const T*>* getEnumerator() const {
         return Util::Enumerator<const T*>::createEnumerator(vec); }
     template <typename S>
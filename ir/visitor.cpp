@@ -15,40 +15,123 @@ limitations under the License.
 */
 
 #include <time.h>
+#include <mutex>
 #include "ir.h"
+#include "lib/gc.h"
 #include "lib/log.h"
 
+/** Per-node visit state, indexed by IR::Node::id.  Node ids are dense and
+ * (almost always) unique, so lookups are array indexing rather than hashing.
+ * Nodes that share an id with another node in the same traversal (such as
+ * nodes read by JSONLoader, which keep the ids they were written with) go to
+ * an overflow hash table.  The ids touched are remembered so that the table
+ * can be cleared in time proportional to the traversal that used it, and
+ * tables are pooled and reused by successive passes. */
+template<class T> class NodeMap {
+    struct entry_t {
+        const IR::Node  *node;
+        T               value;
+    };
+    static constexpr unsigned page_bits = 12, page_size = 1U << page_bits;
+    vector<entry_t *>                           pages;  // allocated on demand
+    vector<unsigned>                            touched;
+    unordered_map<const IR::Node *, T>          overflow;
+
+    entry_t *slot(const IR::Node *n) const {
+        if (!n || n->id < 0) return nullptr;
+        unsigned id = n->id, page = id >> page_bits;
+        if (page >= pages.size() || !pages[page]) return nullptr;
+        return &pages[page][id & (page_size - 1)]; }
+    entry_t *alloc_slot(const IR::Node *n) {
+        if (!n || n->id < 0) return nullptr;
+        unsigned id = n->id, page = id >> page_bits;
+        if (page >= pages.size())
+            pages.resize(page + 1, nullptr);
+        if (!pages[page])
+            pages[page] = new entry_t[page_size]();
+        return &pages[page][id & (page_size - 1)]; }
+
+ public:
+    NodeMap() = default;
+    NodeMap(const NodeMap &) = delete;
+    ~NodeMap() { for (auto *p : pages) delete [] p; }
+    /// @return the value for @n or nullptr if @n is not in the map.  Pointers to
+    /// values remain valid until the entry is erased.
+    T *find(const IR::Node *n) const {
+        auto *e = slot(n);
+        if (e && e->node == n) return &e->value;
+        if (!overflow.empty()) {
+            auto it = overflow.find(n);
+            if (it != overflow.end()) return const_cast<T *>(&it->second); }
+        return nullptr; }
+    std::pair<T *, bool> emplace(const IR::Node *n, const T &value) {
+        if (auto *rv = find(n)) return std::make_pair(rv, false);
+        auto *e = alloc_slot(n);
+        if (e && !e->node) {
+            e->node = n;
+            e->value = value;
+            touched.push_back(n->id);
+            return std::make_pair(&e->value, true); }
+        return std::make_pair(&overflow.emplace(n, value).first->second, true); }
+    template<class F> void erase_if(F pred) {
+        for (auto &id : touched) {
+            auto &e = pages[id >> page_bits][id & (page_size - 1)];
+            if (e.node && pred(e.value)) e.node = nullptr; }
+        for (auto it = overflow.begin(); it != overflow.end();) {
+            if (pred(it->second))
+                it = overflow.erase(it);
+            else
+                ++it; } }
+    void clear() {
+        // drop all pointers, so pooled maps don't keep dead IR alive
+        for (auto id : touched)
+            pages[id >> page_bits][id & (page_size - 1)] = entry_t();
+        touched.clear();
+        overflow.clear(); }
+};
+
+class Visitor::VisitTracker : public NodeMap<bool> {};  // bool is 'done visiting'
+
 class Visitor::ChangeTracker {
-    // FIXME -- this code is really incomprehensible due to all the pairs/first/second stuff
-    // unfortunatelly maps use pairs all over the place, which is where they come from.
-    typedef unordered_map<const IR::Node *, std::pair<bool, const IR::Node *>>  visited_t;
-    visited_t           visited;
+    struct visit_info_t {
+        bool            done;           // false while the node is being visited
+        const IR::Node  *result;
+    };
+    NodeMap<visit_info_t>       visited;
 
  public:
     struct change_t {
-        bool                                    valid;
-        std::pair<visited_t::iterator, bool>    state;  // result of visited.emplace
-        change_t() : valid(false) {}
-        change_t(visited_t *visited, const IR::Node *n) : valid(true),
-            state(visited->emplace(n, std::make_pair(false, n))) {
-                if (!state.second && !state.first->second.first)
-                    BUG("IR loop detected "); }
-        explicit operator bool() { return valid; }
-        bool done() { return !state.second; }
-        const IR::Node *orig() { return state.first->first; }
-        const IR::Node *result() { return state.first->second.second; }
+        const IR::Node  *node = nullptr;
+        visit_info_t    *info = nullptr;
+        bool            inserted = false;
+        change_t() {}
+        change_t(NodeMap<visit_info_t> &visited, const IR::Node *n) : node(n) {
+            auto rv = visited.emplace(n, visit_info_t{false, n});
+            info = rv.first;
+            inserted = rv.second;
+            if (!inserted && !info->done)
+                BUG("IR loop detected "); }
+        explicit operator bool() { return node != nullptr; }
+        bool done() { return !inserted; }
+        const IR::Node *orig() { return node; }
+        const IR::Node *result() { return info->result; }
     };
-    bool done(const IR::Node *n) const { return visited.count(n) && visited.at(n).first; }
-    const IR::Node *result(IR::Node *n) const { return visited.at(n).second; }
-    change_t track(const IR::Node *n) { return change_t(&visited, n); }
-    void start(change_t &change) { change.state.first->second.first = false; }
+    bool done(const IR::Node *n) const {
+        auto *info = visited.find(n);
+        return info && info->done; }
+    const IR::Node *result(IR::Node *n) const {
+        auto *info = visited.find(n);
+        if (!info) BUG("visitor state tracker corrupted");
+        return info->result; }
+    change_t track(const IR::Node *n) { return change_t(visited, n); }
+    void start(change_t &change) { change.info->done = false; }
     bool finish(change_t &change, const IR::Node *orig, const IR::Node *final) {
-        if (!change.valid || (change.state.first = visited.find(orig)) == visited.end())
+        if (!change || !(change.info = visited.find(orig)))
             BUG("visitor state tracker corrupted");
-        change.state.first->second.first = true;
+        change.info->done = true;
         if (!final || *final != *orig) {
-            change.state.first->second.second = final;
-            visited.emplace(final, std::make_pair(true, final));
+            change.info->result = final;
+            visited.emplace(final, visit_info_t{true, final});
             return true;
         } else {
             // FIXME -- not safe if the visitor resurrects the node (which it shouldn't)
@@ -56,18 +139,41 @@ class Visitor::ChangeTracker {
             //     --IR::Node::currentId;
             return false; } }
     const IR::Node *result(const IR::Node *n) const {
-        auto it = visited.find(n);
-        if (it == visited.end())
+        auto *info = visited.find(n);
+        if (!info)
             return n;
-        if (!it->second.first) BUG("IR loop detected");
-        return it->second.second; }
+        if (!info->done) BUG("IR loop detected");
+        return info->result; }
     void revisit_visited() {
-        for (auto it = visited.begin(); it != visited.end();) {
-            if (it->second.first)
-                it = visited.erase(it);
-            else
-                ++it; } }
+        visited.erase_if([](const visit_info_t &info) { return info.done; }); }
+
+    void clear() { visited.clear(); }
+};
+
+/// Trackers are reused by successive passes rather than reallocated for each
+template<class T> class TrackerPool {
+    static std::mutex   lock;
+    static vector<T *>  pool;
+
+ public:
+    static T *get() {
+        std::lock_guard<std::mutex> acquire(lock);
+        if (pool.empty()) return new T;
+        auto *rv = pool.back();
+        pool.pop_back();
+        return rv; }
+    static void release(T *tracker) {
+        if (!tracker) return;
+        if (arena_alloc_enabled()) {
+            // its tables may be in the arena, which does not outlive the compilation
+            delete tracker;
+            return; }
+        tracker->clear();
+        std::lock_guard<std::mutex> acquire(lock);
+        pool.push_back(tracker); }
 };
+template<class T> std::mutex TrackerPool<T>::lock;
+template<class T> vector<T *> TrackerPool<T>::pool;
 
 Visitor::profile_t Visitor::init_apply(const IR::Node *root) {
     if (ctxt) BUG("previous use of visitor did not clean up properly");
@@ -77,20 +183,23 @@ Visitor::profile_t Visitor::init_apply(const IR::Node *root) {
 }
 Visitor::profile_t Modifier::init_apply(const IR::Node *root) {
     auto rv = Visitor::init_apply(root);
-    visited = new ChangeTracker();
+    visited = TrackerPool<ChangeTracker>::get();
     return rv; }
 Visitor::profile_t Inspector::init_apply(const IR::Node *root) {
     auto rv = Visitor::init_apply(root);
-    visited = new visited_t();
+    visited = TrackerPool<VisitTracker>::get();
     return rv; }
 Visitor::profile_t Transform::init_apply(const IR::Node *root) {
     auto rv = Visitor::init_apply(root);
-    visited = new ChangeTracker();
+    visited = TrackerPool<ChangeTracker>::get();
+    // ControlFlowVisitors clone and merge the visitor while visiting children, which
+    // does not mix with visiting the children before the parent is cloned
+    clone_lazily = cloneOnWrite && !dynamic_cast<ControlFlowVisitor *>(this);
     return rv; }
 void Visitor::end_apply() {}
 void Visitor::end_apply(const IR::Node*) {}
 
-static indent_t profile_indent;
+static thread_local indent_t profile_indent;
 Visitor::profile_t::profile_t(Visitor &v_) : v(v_) {
     struct timespec ts;
 #ifdef CLOCK_MONOTONIC
@@ -166,7 +275,51 @@ class ForwardChildren : public Visitor {
  public:
     explicit ForwardChildren(const ChangeTracker &v) : visited(v) {}
 };
-}
+
+/* Helpers for Transform::cloneOnWrite.  ForwardedChildrenChanged checks (without modifying
+ * the node) whether ForwardChildren would change anything.  CollectChildren visits the
+ * children of a node with the Transform, recording the results instead of storing them
+ * back into the node, and ReplayChildren stores those results into a clone of the node. */
+class ForwardedChildrenChanged : public Visitor {
+    const ChangeTracker &visited;
+    const IR::Node *apply_visitor(const IR::Node *n, const char * = 0) {
+        if (visited.result(n) != n) changed = true;
+        return n; }
+ public:
+    bool changed = false;
+    explicit ForwardedChildrenChanged(const ChangeTracker &v) : visited(v) {}
+};
+
+typedef vector<std::pair<const IR::Node *, const IR::Node *>> child_results_t;
+
+class CollectChildren : public Visitor {
+    Transform &xform;
+    const IR::Node *apply_visitor(const IR::Node *n, const char *name = 0) {
+        auto rv = xform.apply_visitor(n, name);
+        if (rv != n) changed = true;
+        results.emplace_back(n, rv);
+        return n; }
+ public:
+    child_results_t results;
+    bool changed = false;
+    explicit CollectChildren(Transform &x) : xform(x) {}
+};
+
+class ReplayChildren : public Visitor {
+    const child_results_t &results;
+    size_t next = 0;
+    const IR::Node *apply_visitor(const IR::Node *n, const char * = 0) {
+        // non-const visit_children may skip children (eg, IR::NodeMap entries whose
+        // key was removed), so search forward for the matching child
+        for (size_t i = next; i < results.size(); ++i) {
+            if (results[i].first == n) {
+                next = i + 1;
+                return results[i].second; } }
+        return n; }
+ public:
+    explicit ReplayChildren(const child_results_t &r) : results(r) {}
+};
+}  // namespace
 
 const IR::Node *Modifier::apply_visitor(const IR::Node *n, const char *name) {
     if (ctxt) ctxt->child_name = name;
@@ -188,10 +341,11 @@ const IR::Node *Modifier::apply_visitor(const IR::Node *n, const char *name) {
                 copy->apply_visitor_postorder(*this); }
             if (visited->finish(track, n, copy))
                 (n = copy)->validate(); } }
-    if (ctxt)
+    if (ctxt) {
         ctxt->child_index++;
-    else
-        visited = nullptr;
+    } else {
+        TrackerPool<ChangeTracker>::release(visited);
+        visited = nullptr; }
     return n;
 }
 
@@ -200,23 +354,24 @@ const IR::Node *Inspector::apply_visitor(const IR::Node *n, const char *name) {
     if (n && !join_flows(n)) {
         PushContext local(ctxt, n);
         auto vp = visited->emplace(n, false);
-        if (!vp.second && !vp.first->second)
+        if (!vp.second && !*vp.first)
             BUG("IR loop detected");
         if (!vp.second && visitDagOnce) {
             n->apply_visitor_revisit(*this);
         } else {
-            vp.first->second = false;
+            *vp.first = false;
             if (n->apply_visitor_preorder(*this)) {
                 n->visit_children(*this);
                 n->apply_visitor_postorder(*this); }
-            vp.first = visited->find(n);  // iterator may have been invalidated
-            if (vp.first == visited->end())
+            vp.first = visited->find(n);  // may have been erased by revisit_visited
+            if (!vp.first)
                 BUG("visitor state tracker corrupted");
-            vp.first->second = true; } }
-    if (ctxt)
+            *vp.first = true; } }
+    if (ctxt) {
         ctxt->child_index++;
-    else
-        visited = nullptr;
+    } else {
+        TrackerPool<VisitTracker>::release(visited);
+        visited = nullptr; }
     return n;
 }
 
@@ -230,15 +385,24 @@ const IR::Node *Transform::apply_visitor(const IR::Node *n, const char *name) {
             n = track.result();
         } else {
             visited->start(track);
-            auto copy = n->clone();
-            local.current.node = copy;
-            if (visitDagOnce && !dontForwardChildrenBeforePreorder) {
-                ForwardChildren forward_children(*visited);
-                copy->visit_children(forward_children); }
+            bool lazy = clone_lazily;
+            if (lazy && visitDagOnce && !dontForwardChildrenBeforePreorder) {
+                ForwardedChildrenChanged forward_check(*visited);
+                n->visit_children(forward_check);
+                lazy = !forward_check.changed; }
+            IR::Node *copy;
+            if (lazy) {
+                // not modified unless a child changes; see cloneOnWrite
+                copy = const_cast<IR::Node *>(n);
+            } else {
+                local.current.node = copy = n->clone();
+                if (visitDagOnce && !dontForwardChildrenBeforePreorder) {
+                    ForwardChildren forward_children(*visited);
+                    copy->visit_children(forward_children); } }
             prune_flag = false;
             auto preorder_result = copy->apply_visitor_preorder(*this);
             ChangeTracker::change_t preorder_result_track;
-            assert(preorder_result != n);  // should never happen
+            assert(lazy || preorder_result != n);  // should never happen
             auto final = preorder_result;
             if (preorder_result != copy) {
                 // FIXME -- not safe if the visitor resurrects the node (which it shouldn't)
@@ -252,9 +416,15 @@ const IR::Node *Transform::apply_visitor(const IR::Node *n, const char *name) {
                 } else {
                     preorder_result_track = visited->track(preorder_result);
                     visited->start(preorder_result_track);
-                    local.current.node = copy = preorder_result->clone(); } }
+                    if (lazy)
+                        local.current.node = copy = const_cast<IR::Node *>(preorder_result);
+                    else
+                        local.current.node = copy = preorder_result->clone(); } }
             if (!prune_flag) {
-                copy->visit_children(*this);
+                if (lazy)
+                    local.current.node = copy = visit_children_on_write(copy);
+                else
+                    copy->visit_children(*this);
                 final = copy->apply_visitor_postorder(*this); }
             if (final && final != preorder_result && *final == *preorder_result)
                 final = preorder_result;
@@ -262,23 +432,32 @@ const IR::Node *Transform::apply_visitor(const IR::Node *n, const char *name) {
                 final->validate();
             if (preorder_result_track)
                 visited->finish(preorder_result_track, preorder_result, final); } }
-    if (ctxt)
+    if (ctxt) {
         ctxt->child_index++;
-    else
-        visited = nullptr;
+    } else {
+        TrackerPool<ChangeTracker>::release(visited);
+        visited = nullptr; }
     return n;
 }
 
 void Inspector::revisit_visited() {
-    for (auto it = visited->begin(); it != visited->end();) {
-        if (it->second)
-            it = visited->erase(it);
-        else
-            ++it; }
+    visited->erase_if([](bool done) { return done; });
 }
 void Modifier::revisit_visited() {
     visited->revisit_visited();
 }
+// Visit the children of a node that has not been cloned, and clone it only if one
+// of the children changed.
+IR::Node *Transform::visit_children_on_write(IR::Node *n) {
+    CollectChildren collect(*this);
+    const_cast<const IR::Node *>(n)->visit_children(collect);
+    if (!collect.changed) return n;
+    auto *copy = n->clone();
+    ReplayChildren replay(collect.results);
+    copy->visit_children(replay);
+    return copy;
+}
+
 void Transform::revisit_visited() {
     visited->revisit_visited();
 }
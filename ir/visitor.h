@@ -128,7 +128,7 @@ class Visitor {
     template <class T> inline const T *findContext(const Context *&c) const {
         if (!c) c = ctxt;
         while ((c = c->parent))
-            if (auto *rv = dynamic_cast<const T *>(c->node)) return rv;
+            if (auto *rv = c->node->to<T>()) return rv;
         return nullptr; }
     template <class T> inline const T *findContext() const {
         const Context *c = ctxt;
@@ -136,7 +136,7 @@ class Visitor {
     template <class T> inline const T *findOrigCtxt(const Context *&c) const {
         if (!c) c = ctxt;
         while ((c = c->parent))
-            if (auto *rv = dynamic_cast<const T *>(c->original)) return rv;
+            if (auto *rv = c->original->to<T>()) return rv;
         return nullptr; }
     template <class T> inline const T *findOrigCtxt() const {
         const Context *c = ctxt;
@@ -144,7 +144,7 @@ class Visitor {
 
     /// @return the current node - i.e., the node that was passed to preorder()
     /// or postorder(). For Modifiers and Transforms, this is a clone of the
-    /// node returned by getOriginal().
+    /// node returned by getOriginal() (unless the Transform uses cloneOnWrite).
     const IR::Node* getCurrentNode() const { return ctxt->node; }
     template <class T>
     const T* getCurrentNode() const {
@@ -165,6 +165,7 @@ class Visitor {
     virtual bool join_flows(const IR::Node *) { return false; }
     void visit_children(const IR::Node *, std::function<void()> fn) { fn(); }
     class ChangeTracker;  // used by Modifier and Transform -- private to them
+    class VisitTracker;   // used by Inspector -- private to it
     virtual bool check_clone(const Visitor *) { return true; }
 
  private:
@@ -196,8 +197,7 @@ class Modifier : public virtual Visitor {
 };
 
 class Inspector : public virtual Visitor {
-    typedef unordered_map<const IR::Node *, bool>       visited_t;
-    visited_t   *visited = nullptr;
+    VisitTracker        *visited = nullptr;
     bool check_clone(const Visitor *) override;
  public:
     profile_t init_apply(const IR::Node *root) override;
@@ -217,8 +217,10 @@ class Inspector : public virtual Visitor {
 class Transform : public virtual Visitor {
     ChangeTracker       *visited = nullptr;
     bool prune_flag = false;
+    bool clone_lazily = false;
     void visitor_const_error() override;
     bool check_clone(const Visitor *) override;
+    IR::Node *visit_children_on_write(IR::Node *n);
 
  public:
     profile_t init_apply(const IR::Node *root) override;
@@ -241,6 +243,12 @@ class Transform : public virtual Visitor {
         auto *rv = apply_visitor(child);
         prune_flag = true;
         return rv; }
+    // if cloneOnWrite is set to 'true' (usually in the derived Transform class
+    // constructor), nodes are not cloned before being visited; a node is only cloned
+    // when one of its children changes.  preorder and postorder may then be called on
+    // the original node, so they must never modify their argument in place -- they
+    // must return a new node instead.  Ignored for ControlFlowVisitors.
+    bool cloneOnWrite = false;
 };
 
 class ControlFlowVisitor : public virtual Visitor {
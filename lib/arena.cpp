@@ -0,0 +1,114 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+constexpr size_t Arena::chunk_size;
+constexpr size_t Arena::alignment;
+
+static size_t align_up(size_t size) {
+    return (size + Arena::alignment - 1) & ~(Arena::alignment - 1); }
+
+// Allocate a chunk of at least @size bytes and record it in the (sorted) chunk
+// table.  Caller must hold the lock.
+char *Arena::new_chunk(size_t size) {
+    if (nchunks == chunks_cap) {
+        size_t cap = chunks_cap ? chunks_cap * 2 : 64;
+        auto *tmp = static_cast<chunk_t *>(realloc(chunks, cap * sizeof(chunk_t)));
+        if (!tmp) return nullptr;
+        chunks = tmp;
+        chunks_cap = cap; }
+    auto *base = static_cast<char *>(malloc(size));
+    if (!base) return nullptr;
+    size_t i = nchunks;
+    while (i > 0 && chunks[i-1].base > base) {
+        chunks[i] = chunks[i-1];
+        --i; }
+    chunks[i].base = base;
+    chunks[i].size = size;
+    ++nchunks;
+    reserved_bytes += size;
+    return base;
+}
+
+const Arena::chunk_t *Arena::find_chunk(const void *p) const {
+    const char *cp = static_cast<const char *>(p);
+    size_t lo = 0, hi = nchunks;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (chunks[mid].base + chunks[mid].size <= cp)
+            lo = mid + 1;
+        else
+            hi = mid; }
+    if (lo < nchunks && chunks[lo].base <= cp)
+        return &chunks[lo];
+    return nullptr;
+}
+
+void *Arena::allocate(size_t size) {
+    size = align_up(size ? size : 1);
+    acquire();
+    char *rv;
+    if (size > chunk_size / 4) {
+        // big objects get a chunk of their own, so we don't waste the tail of
+        // the current chunk
+        rv = new_chunk(size);
+    } else {
+        if (static_cast<size_t>(limit - next) < size) {
+            if ((next = new_chunk(chunk_size)))
+                limit = next + chunk_size;
+            else
+                limit = nullptr; }
+        rv = next;
+        if (rv) {
+            next += size;
+            last = rv; } }
+    if (rv) inuse_bytes += size;
+    unlock();
+    return rv;
+}
+
+bool Arena::deallocate(void *p) {
+    acquire();
+    bool rv = find_chunk(p) != nullptr;
+    if (rv && p == last) {
+        inuse_bytes -= next - last;
+        next = last;
+        last = nullptr; }
+    unlock();
+    return rv;
+}
+
+bool Arena::contains(const void *p) const {
+    acquire();
+    bool rv = find_chunk(p) != nullptr;
+    unlock();
+    return rv;
+}
+
+void Arena::release() {
+    acquire();
+    for (size_t i = 0; i < nchunks; ++i)
+        free(chunks[i].base);
+    free(chunks);
+    chunks = nullptr;
+    nchunks = chunks_cap = 0;
+    next = limit = last = nullptr;
+    inuse_bytes = reserved_bytes = 0;
+    unlock();
+}
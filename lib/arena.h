@@ -0,0 +1,72 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef P4C_LIB_ARENA_H_
+#define P4C_LIB_ARENA_H_
+
+#include <atomic>
+#include <cstddef>
+
+/**
+ * A bump-pointer allocator.  Memory is carved sequentially out of large chunks
+ * obtained from malloc, and is only given back in bulk, by release() or when
+ * the Arena is destroyed.  Individual deallocations are mostly ignored; freeing
+ * the most recent allocation rolls the bump pointer back so that short-lived
+ * temporaries don't waste space.
+ *
+ * The arena never calls operator new itself, so it can be used to implement
+ * the global operator new (see gc.cpp).  All operations are threadsafe.
+ */
+class Arena {
+    struct chunk_t {
+        char    *base;
+        size_t  size;
+    };
+    chunk_t     *chunks = nullptr;      // sorted by base address
+    size_t      nchunks = 0, chunks_cap = 0;
+    char        *next = nullptr, *limit = nullptr;     // current chunk
+    char        *last = nullptr;        // most recent allocation, for rollback
+    size_t      inuse_bytes = 0, reserved_bytes = 0;
+    mutable std::atomic_flag lock = ATOMIC_FLAG_INIT;
+
+    void acquire() const { while (lock.test_and_set(std::memory_order_acquire)) {} }
+    void unlock() const { lock.clear(std::memory_order_release); }
+    char *new_chunk(size_t size);
+    const chunk_t *find_chunk(const void *p) const;
+
+ public:
+    static constexpr size_t chunk_size = 1 << 20;
+    static constexpr size_t alignment = alignof(std::max_align_t);
+
+    Arena() = default;
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+    ~Arena() { release(); }
+
+    /// @return @size bytes of memory aligned for any type, or nullptr if out of memory.
+    void *allocate(size_t size);
+    /// @return false if @p was not allocated from this arena.
+    bool deallocate(void *p);
+    bool contains(const void *p) const;
+    /// Return all memory to the system.  Everything allocated from the arena
+    /// becomes invalid.
+    void release();
+
+    size_t inuse() const { return inuse_bytes; }
+    size_t reserved() const { return reserved_bytes; }
+};
+
+#endif /* P4C_LIB_ARENA_H_ */
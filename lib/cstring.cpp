@@ -15,35 +15,129 @@ limitations under the License.
 */
 
 #include "cstring.h"
+#include <stdlib.h>
+#include <mutex>
+#include <new>
 #include <string>
-#include <unordered_set>
 
-static std::unordered_set<std::string> *cache = nullptr;
+// FNV-1a
+static size_t hash_bytes(const char *s, size_t length) {
+    size_t rv = sizeof(size_t) > 4 ? 14695981039346656037ULL : 2166136261U;
+    const size_t prime = sizeof(size_t) > 4 ? 1099511628211ULL : 16777619U;
+    for (size_t i = 0; i < length; ++i) {
+        rv ^= static_cast<unsigned char>(s[i]);
+        rv *= prime; }
+    return rv;
+}
+
+// The set of interned strings, split into independently locked shards so that
+// threads interning different strings rarely contend.  Each shard is an open
+// addressing hash table of pointers to interned strings, whose headers hold
+// the hash and length needed to probe it without touching the string itself
+// except to confirm a match.  Strings are carved out of chunks obtained from
+// malloc and are never freed.
+class cstring::InternTable {
+    static constexpr int shard_bits = 6;
+    static constexpr size_t chunk_size = 64*1024;
+
+    struct shard_t {
+        std::mutex      lock;
+        const char      **table = nullptr;
+        size_t          capacity = 0, count = 0;
+        char            *next = nullptr, *limit = nullptr;
+        size_t          bytes = 0;
+
+        const char *store(const char *s, size_t length, size_t hash) {
+            size_t size = (sizeof(header_t) + length + alignof(header_t)) &
+                          ~(alignof(header_t) - 1);
+            char *mem;
+            if (size > chunk_size / 4) {
+                mem = static_cast<char *>(malloc(size));
+            } else {
+                if (static_cast<size_t>(limit - next) < size) {
+                    next = static_cast<char *>(malloc(chunk_size));
+                    limit = next ? next + chunk_size : nullptr; }
+                mem = next;
+                next += size; }
+            if (!mem) throw std::bad_alloc();
+            bytes += size;
+            auto *h = reinterpret_cast<header_t *>(mem);
+            h->length = length;
+            h->hash = hash;
+            char *rv = reinterpret_cast<char *>(h + 1);
+            memcpy(rv, s, length);
+            rv[length] = 0;
+            return rv; }
+        void grow() {
+            size_t newcap = capacity ? capacity * 2 : 64;
+            auto *newtable = static_cast<const char **>(calloc(newcap, sizeof(const char *)));
+            if (!newtable) throw std::bad_alloc();
+            for (size_t i = 0; i < capacity; ++i) {
+                if (!table[i]) continue;
+                size_t j = reinterpret_cast<const header_t *>(table[i])[-1].hash;
+                while (newtable[j & (newcap - 1)]) ++j;
+                newtable[j & (newcap - 1)] = table[i]; }
+            free(table);
+            table = newtable;
+            capacity = newcap; }
+        const char *intern(const char *s, size_t length, size_t hash) {
+            std::lock_guard<std::mutex> acquire(lock);
+            if (2 * (count + 1) > capacity) grow();
+            for (size_t i = hash;; ++i) {
+                const char *&slot = table[i & (capacity - 1)];
+                if (!slot) {
+                    ++count;
+                    return slot = store(s, length, hash); }
+                auto *h = reinterpret_cast<const header_t *>(slot) - 1;
+                if (h->hash == hash && h->length == length && memcmp(slot, s, length) == 0)
+                    return slot; } }
+    };
+    shard_t     shards[1 << shard_bits];
+
+ public:
+    const char *intern(const char *s, size_t length) {
+        size_t hash = hash_bytes(s, length);
+        // the low bits of the hash pick the slot in a shard, so use the high bits here
+        auto &shard = shards[hash >> (8 * sizeof(size_t) - shard_bits)];
+        return shard.intern(s, length, hash); }
+    size_t size(size_t &count) {
+        size_t rv = 0;
+        count = 0;
+        for (auto &shard : shards) {
+            std::lock_guard<std::mutex> acquire(shard.lock);
+            count += shard.count;
+            rv += shard.bytes; }
+        return rv; }
+};
+
+// All members are constant-initialized, so the table is usable from other
+// static initializers regardless of initialization order.
+cstring::InternTable cstring::cache;
+
+const char *cstring::intern(const char *s, size_t length) {
+    return cache.intern(s, length);
+}
 
 cstring &cstring::operator=(const char *p) {
-    if (cache == nullptr)
-        cache = new std::unordered_set<std::string>();
-    str = p ? cache->emplace(p).first->c_str() : 0;
+    str = p ? intern(p, strlen(p)) : 0;
     return *this;
 }
 
 cstring& cstring::operator=(const std::string& s) {
-    if (cache == nullptr)
-        cache = new std::unordered_set<std::string>();
-    str = cache->insert(s).first->c_str();
+    // interned strings are zero-terminated, so anything after an embedded
+    // zero byte would be unreachable anyway
+    auto *z = static_cast<const char *>(memchr(s.data(), 0, s.size()));
+    str = intern(s.data(), z ? z - s.data() : s.size());
     return *this;
 }
 
+cstring::cstring(const char *begin, const char *end) {
+    auto *z = static_cast<const char *>(memchr(begin, 0, end - begin));
+    str = intern(begin, (z ? z : end) - begin);
+}
+
 size_t cstring::cache_size(size_t &count) {
-    size_t rv = 0;
-    if (cache) {
-        count = cache->size();
-        for (auto &s : *cache)
-            rv += sizeof(s) + s.size();
-    } else {
-        count = 0;
-    }
-    return rv;
+    return cache.size(count);
 }
 
 cstring cstring::newline = cstring("\n");
@@ -66,8 +160,10 @@ cstring cstring::before(const char* at) const {
 
 cstring cstring::substr(size_t start, size_t length) const {
     if (size() <= start) return cstring::empty;
-    std::string s = str;
-    return s.substr(start, length);
+    if (length > size() - start) length = size() - start;
+    cstring rv;
+    rv.str = intern(str + start, length);
+    return rv;
 }
 
 cstring cstring::replace(char c, char with) const {
@@ -35,6 +35,8 @@ limitations under the License.
  *     strings, these operations only involve pointer assignment.
  *   - Comparing cstrings for equality is cheap; interning makes it possible to
  *     test for equality using a simple pointer comparison.
+ *   - The length and a hash of the string are computed once, when the string
+ *     is interned, so size() and hashing are constant-time operations.
  *   - The immutability of the underlying strings means that it's always safe to
  *     change a cstring, even if there are other references to it elsewhere.
  *   - The API offers a number of handy helper methods that aren't available on
@@ -44,14 +46,14 @@ limitations under the License.
  *   - Because cstring deals with immutable strings, any modification requires
  *     that the complete string be copied.
  *   - Interning has an initial cost: converting a const char*, a
- *     std::string, or a std::stringstream to a cstring requires copying it.
- *     Currently, this happens every time you perform the conversion, whether
- *     the string is already interned or not, unless the source is an
- *     std::string.
+ *     std::string, or a std::stringstream to a cstring requires hashing it
+ *     and looking it up in the intern table, and copying it if it was not
+ *     already interned.
  *   - Interned strings can never be freed, so they'll stick around for the
  *     lifetime of the program.
- *   - The string interning cstring performs is currently not threadsafe, so you
- *     can't safely use cstrings off the main thread.
+ *
+ * Interning is threadsafe; the intern table is sharded so that threads
+ * creating cstrings concurrently seldom wait for each other.
  *
  * Given these tradeoffs, the general rule of thumb to follow is that you should
  * try to convert strings to cstrings early and keep them in that form. That
@@ -71,6 +73,16 @@ limitations under the License.
 class cstring {
     const char *str;
 
+    // Every interned string is immediately preceded in memory by its header.
+    struct header_t {
+        size_t  length;
+        size_t  hash;
+    };
+    const header_t *header() const { return reinterpret_cast<const header_t *>(str) - 1; }
+    class InternTable;
+    static InternTable cache;
+    static const char *intern(const char *s, size_t length);
+
  public:
     cstring() : str(0) {}
 
@@ -92,13 +104,15 @@ class cstring {
     template <typename Iter> cstring(Iter begin, Iter end) {
         *this = std::string(begin, end);
     }
+    // the characters in [begin, end), without going through a std::string
+    cstring(const char *begin, const char *end);
 
     char get(unsigned index) const { return (index < size()) ? str[index] : 0; }
     const char *c_str() const { return str; }
     operator const char *() const { return str; }
 
-    // Size tests. Constant time except for size(), which is linear time.
-    size_t size() const { return str ? strlen(str) : 0; }
+    // Size tests. Constant time.
+    size_t size() const { return str ? header()->length : 0; }
     bool isNull() const { return str == nullptr; }
     bool isNullOrEmpty() const { return str == nullptr ? true : str[0] == 0; }
 
@@ -122,13 +136,20 @@ class cstring {
     bool operator>=(const cstring &a) const { return *this >= a.str; }
     bool operator>=(const char *a) const { return str ? !a || strcmp(str, a) >= 0 : !a; }
 
-    bool operator==(const std::string &a) const { return *this == a.c_str(); }
-    bool operator!=(const std::string &a) const { return *this != a.c_str(); }
+    bool operator==(const std::string &a) const {
+        return str && size() == a.size() && !memcmp(str, a.data(), a.size()); }
+    bool operator!=(const std::string &a) const { return !(*this == a); }
     bool operator<(const std::string &a) const { return *this < a.c_str(); }
     bool operator<=(const std::string &a) const { return *this <= a.c_str(); }
     bool operator>(const std::string &a) const { return *this > a.c_str(); }
     bool operator>=(const std::string &a) const { return *this >= a.c_str(); }
 
+    // Constant time hash of the string contents; unlike std::hash<cstring>,
+    // this does not depend on where the string was allocated, so it is the
+    // same from one run to the next.
+    size_t hash() const { return str ? header()->hash : 0; }
+
+    // Prefix/suffix tests. Linear in the size of the argument.
     bool startsWith(const cstring& prefix) const;
     bool endsWith(const cstring& suffix) const;
 
@@ -0,0 +1,173 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef P4C_LIB_FLAT_HASH_H_
+#define P4C_LIB_FLAT_HASH_H_
+
+#include <assert.h>
+#include <stdint.h>
+#include <functional>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+// Open-addressing hash tables with linear probing, stored in a single vector.
+// Meant for small keys that are cheap to compare (pointers, cstrings); the
+// default-constructed key (nullptr) marks empty slots and cannot be stored.
+// Iteration order is unspecified.  Inserting invalidates iterators; erasing
+// invalidates iterators to the elements after the erased one.
+template <class K, class T, class KEY, class HASH>
+class flat_hash_table {
+ public:
+    typedef K           key_type;
+    typedef T           value_type;
+    typedef size_t      size_type;
+
+ private:
+    std::vector<T>      slots;
+    size_t              entries = 0;
+    unsigned            shift = 64;  // 64 - log2(slots.size())
+    HASH                hasher;
+
+    static const K &key(const T &v) { return KEY()(v); }
+    static bool empty(const T &v) { return key(v) == K(); }
+    size_t mask() const { return slots.size() - 1; }
+    // Fibonacci hashing spreads keys whose low bits are all zero (aligned pointers)
+    size_t home(const K &k) const {
+        return (static_cast<uint64_t>(hasher(k)) * 0x9E3779B97F4A7C15ULL) >> shift; }
+    size_t probe(const K &k) const {
+        size_t i = home(k);
+        while (!empty(slots[i]) && !(key(slots[i]) == k))
+            i = (i + 1) & mask();
+        return i; }
+    void grow() {
+        std::vector<T> old(slots.size() ? 2 * slots.size() : 16);
+        old.swap(slots);
+        shift = 64;
+        for (size_t n = slots.size(); n > 1; n >>= 1) --shift;
+        for (auto &v : old)
+            if (!empty(v))
+                slots[probe(key(v))] = std::move(v); }
+
+    template<class TABLE, class VAL> class iter
+    : public std::iterator<std::forward_iterator_tag, VAL> {
+        friend class flat_hash_table;
+        TABLE   *table;
+        size_t  idx;
+        void skip() { while (idx < table->slots.size() && empty(table->slots[idx])) ++idx; }
+        iter(TABLE *t, size_t i) : table(t), idx(i) { skip(); }
+     public:
+        iter() : table(nullptr), idx(0) {}
+        template<class T2, class V2> iter(const iter<T2, V2> &i)  // NOLINT(runtime/explicit)
+        : table(i.table), idx(i.idx) {}
+        VAL &operator*() const { return table->slots[idx]; }
+        VAL *operator->() const { return &table->slots[idx]; }
+        iter &operator++() { ++idx; skip(); return *this; }
+        iter operator++(int) { iter rv = *this; ++*this; return rv; }
+        bool operator==(const iter &i) const { return idx == i.idx; }
+        bool operator!=(const iter &i) const { return idx != i.idx; }
+        template<class, class> friend class iter;
+    };
+
+ public:
+    typedef iter<flat_hash_table, T>                    iterator;
+    typedef iter<const flat_hash_table, const T>        const_iterator;
+
+    flat_hash_table() = default;
+    flat_hash_table(const flat_hash_table &) = default;
+    flat_hash_table(flat_hash_table &&) = default;
+    flat_hash_table &operator=(const flat_hash_table &) = default;
+    flat_hash_table &operator=(flat_hash_table &&) = default;
+
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, slots.size()); }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, slots.size()); }
+
+    bool empty() const { return entries == 0; }
+    size_t size() const { return entries; }
+    void clear() { slots.clear(); entries = 0; shift = 64; }
+    void reserve(size_t n) { while (slots.size() * 3 < n * 4) grow(); }
+
+    iterator find(const K &k) {
+        if (entries == 0) return end();
+        size_t i = probe(k);
+        return empty(slots[i]) ? end() : iterator(this, i); }
+    const_iterator find(const K &k) const {
+        if (entries == 0) return end();
+        size_t i = probe(k);
+        return empty(slots[i]) ? end() : const_iterator(this, i); }
+    size_t count(const K &k) const { return find(k) != end(); }
+
+    std::pair<iterator, bool> insert(const T &v) {
+        assert(!empty(v));
+        if ((entries + 1) * 4 > slots.size() * 3) grow();
+        size_t i = probe(key(v));
+        if (!empty(slots[i]))
+            return std::make_pair(iterator(this, i), false);
+        slots[i] = v;
+        ++entries;
+        return std::make_pair(iterator(this, i), true); }
+    template<class... ARGS> std::pair<iterator, bool> emplace(ARGS &&... args) {
+        return insert(T(std::forward<ARGS>(args)...)); }
+
+    // Backward-shift deletion: move later elements of the probe sequence into
+    // the hole, so no tombstones are needed
+    void erase(const_iterator pos) {
+        size_t hole = pos.idx;
+        for (size_t j = (hole + 1) & mask(); !empty(slots[j]); j = (j + 1) & mask()) {
+            size_t h = home(key(slots[j]));
+            // slot j can move to the hole unless its home is cyclically in (hole, j]
+            if (hole < j ? (h <= hole || h > j) : (h <= hole && h > j)) {
+                slots[hole] = std::move(slots[j]);
+                hole = j; } }
+        slots[hole] = T();
+        --entries; }
+    size_t erase(const K &k) {
+        auto it = find(k);
+        if (it == end()) return 0;
+        erase(it);
+        return 1; }
+};
+
+template <class K> struct flat_hash_set_key {
+    const K &operator()(const K &k) const { return k; } };
+template <class K, class V> struct flat_hash_map_key {
+    const K &operator()(const std::pair<K, V> &v) const { return v.first; } };
+
+template <class K, class HASH = std::hash<K>>
+class flat_hash_set : public flat_hash_table<K, K, flat_hash_set_key<K>, HASH> {};
+
+// The key of an element must not be modified through an iterator
+template <class K, class V, class HASH = std::hash<K>>
+class flat_hash_map
+: public flat_hash_table<K, std::pair<K, V>, flat_hash_map_key<K, V>, HASH> {
+ public:
+    typedef V mapped_type;
+    V &operator[](const K &k) { return this->emplace(k, V()).first->second; }
+};
+
+// get() as in map.h
+namespace GetImpl {
+template<class K, class T, class V, class HASH>
+inline V get(const flat_hash_map<K, V, HASH> &m, T key, V def = V()) {
+    auto it = m.find(key);
+    if (it != m.end()) return it->second;
+    return def; }
+}  // namespace GetImpl
+using namespace GetImpl;  // NOLINT(build/namespaces)
+
+#endif /* P4C_LIB_FLAT_HASH_H_ */
@@ -18,9 +18,12 @@ limitations under the License.
 #if HAVE_LIBGC
 #include <gc/gc_cpp.h>
 #endif  /* HAVE_LIBGC */
+#include <stdlib.h>
 #include <new>
+#include <type_traits>
 #include "log.h"
 #include "gc.h"
+#include "arena.h"
 #include "cstring.h"
 
 /* glibc++ requires defining global delete with this exception spec to avoid warnings.
@@ -29,10 +32,26 @@ limitations under the License.
 #define _GLIBCXX_USE_NOEXCEPT _NOEXCEPT
 #endif
 
+/* While an ArenaScope is active (see enable_arena_alloc), every allocation
+ * made through the global operator new comes from this arena, unless the
+ * thread is in an OutsideArena, and nothing is freed until the scope ends.
+ * Anything allocated outside the scope belongs to the GC (or malloc) and is
+ * freed there. */
+static Arena *arena = nullptr;
+static bool arena_requested = false;
+static thread_local int outside_arena = 0;
+
+static void *arena_alloc(std::size_t size) {
+    if (void *rv = arena->allocate(size))
+        return rv;
+    throw std::bad_alloc();
+}
+
 // One can disable the GC, e.g., to run under Valgrind, by editing config.h
 #if HAVE_LIBGC
 static bool done_init;
 void *operator new(std::size_t size) {
+    if (arena && !outside_arena) return arena_alloc(size);
     /* DANGER -- on OSX, can't safely call the garbage collector allocation
      * routines from a static global constructor without manually initializing
      * it first.  Since we have global constructors that want to allocate
@@ -43,13 +62,18 @@ void *operator new(std::size_t size) {
     return ::operator new(size, UseGC, 0, 0);
 }
 void *operator new[](std::size_t size) {
+    if (arena && !outside_arena) return arena_alloc(size);
     if (!done_init) {
         GC_INIT();
         done_init = true; }
     return ::operator new(size, UseGC, 0, 0);
 }
-void operator delete(void *p) _GLIBCXX_USE_NOEXCEPT { return gc::operator delete(p); }
-void operator delete[](void *p) _GLIBCXX_USE_NOEXCEPT { return gc::operator delete(p); }
+void operator delete(void *p) _GLIBCXX_USE_NOEXCEPT {
+    if (arena && arena->deallocate(p)) return;
+    return gc::operator delete(p); }
+void operator delete[](void *p) _GLIBCXX_USE_NOEXCEPT {
+    if (arena && arena->deallocate(p)) return;
+    return gc::operator delete(p); }
 
 extern "C" void (*GC_start_call_back)(void);
 extern "C" size_t GC_get_heap_size(void);
@@ -63,6 +87,25 @@ static void gc_callback() {
 }
 
 void silent(char *, GC_word) {}
+#else
+void *operator new(std::size_t size) {
+    if (arena && !outside_arena) return arena_alloc(size);
+    if (void *rv = malloc(size ? size : 1))
+        return rv;
+    throw std::bad_alloc();
+}
+void *operator new[](std::size_t size) {
+    if (arena && !outside_arena) return arena_alloc(size);
+    if (void *rv = malloc(size ? size : 1))
+        return rv;
+    throw std::bad_alloc();
+}
+void operator delete(void *p) _GLIBCXX_USE_NOEXCEPT {
+    if (arena && arena->deallocate(p)) return;
+    free(p); }
+void operator delete[](void *p) _GLIBCXX_USE_NOEXCEPT {
+    if (arena && arena->deallocate(p)) return;
+    free(p); }
 #endif  /* HAVE_LIBGC */
 
 void setup_gc_logging() {
@@ -73,7 +116,54 @@ void setup_gc_logging() {
 #endif  /* HAVE_LIBGC */
 }
 
+void enable_arena_alloc() { arena_requested = true; }
+
+ArenaScope::ArenaScope() {
+    if (!arena_requested || arena) return;
+#if HAVE_LIBGC
+    /* The collector does not scan the arena, so it would free objects that are
+     * only referenced from arena memory.  Since the arena does not free
+     * anything before the scope ends either, just stop collecting. */
+    if (!done_init) {
+        GC_INIT();
+        done_init = true; }
+    GC_disable();
+#endif  /* HAVE_LIBGC */
+    /* The arena itself is reused by the following scopes, and never destroyed,
+     * so that it does not depend on the order of static destructors. */
+    static std::aligned_storage<sizeof(Arena), alignof(Arena)>::type arena_space;
+    static Arena *instance = new(&arena_space) Arena;
+    arena = instance;
+    owner = true;
+}
+
+ArenaScope::~ArenaScope() {
+    if (!owner) return;
+    auto *done = arena;
+    arena = nullptr;
+    done->release();
+#if HAVE_LIBGC
+    GC_enable();
+#endif  /* HAVE_LIBGC */
+}
+
+OutsideArena::OutsideArena() { ++outside_arena; }
+OutsideArena::~OutsideArena() { --outside_arena; }
+
+bool arena_alloc_enabled() { return arena != nullptr; }
+
+bool threadsafe_alloc() {
+#if HAVE_LIBGC
+    return arena != nullptr;
+#else
+    return true;
+#endif  /* HAVE_LIBGC */
+}
+
 size_t gc_mem_inuse(size_t *max) {
+    if (arena) {
+        if (max) *max = arena->reserved();
+        return arena->inuse(); }
 #if HAVE_LIBGC
     GC_word heapsize, heapfree;
     GC_gcollect();
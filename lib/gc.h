@@ -22,4 +22,40 @@ limitations under the License.
 void setup_gc_logging();
 size_t gc_mem_inuse(size_t *max = 0);  // trigger GC, return inuse after
 
+// Make the next ArenaScope allocate from a bump-pointer arena instead of the
+// garbage collector.
+void enable_arena_alloc();
+// True while an ArenaScope allocates from the arena.
+bool arena_alloc_enabled();
+
+// If enable_arena_alloc was called, all memory allocated by any thread while
+// the scope exists comes from an arena that is never collected, and that is
+// returned to the system in bulk when the scope ends; the collector is turned
+// off meanwhile.  A scope covers one compilation: nothing allocated in it may
+// be used afterwards, so objects created in the scope must also be destroyed
+// in it.  Nested scopes share the arena of the outermost one.
+class ArenaScope {
+    bool owner = false;
+
+ public:
+    ArenaScope();
+    ~ArenaScope();
+    ArenaScope(const ArenaScope &) = delete;
+    ArenaScope &operator=(const ArenaScope &) = delete;
+};
+
+// Allocations made by this thread while one of these exists do not come from
+// the arena.  For caches that outlive an ArenaScope.
+class OutsideArena {
+ public:
+    OutsideArena();
+    ~OutsideArena();
+    OutsideArena(const OutsideArena &) = delete;
+    OutsideArena &operator=(const OutsideArena &) = delete;
+};
+
+// True if operator new may be called from several threads at once.  The
+// garbage collector is not built for threads, so this needs the arena.
+bool threadsafe_alloc();
+
 #endif /* LIB_GC_H_ */
@@ -14,6 +14,8 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+#include <limits.h>
+#include <stdint.h>
 #include <stdexcept>
 #include <sstream>
 #include "json.h"
@@ -21,6 +23,11 @@ limitations under the License.
 
 namespace Util {
 
+void IJson::serialize(std::ostream& out, bool compact) const {
+    JsonWriter writer(out, compact);
+    serialize(writer);
+}
+
 cstring IJson::toString() const {
     std::stringstream str;
     serialize(str);
@@ -29,42 +36,66 @@ cstring IJson::toString() const {
 
 JsonValue* JsonValue::null = new JsonValue();
 
-void JsonValue::serialize(std::ostream& out) const {
+// Inline numbers are converted to and from mpz_class through long
+static_assert(sizeof(long) == sizeof(int64_t), "JsonValue assumes a 64-bit long");
+
+JsonValue::JsonValue(const mpz_class &v)
+    : tag(Kind::Number), small(v.fits_slong_p() ? v.get_si() : 0),
+      wide(v.fits_slong_p() ? nullptr : new mpz_class(v)) {}
+
+JsonValue::JsonValue(unsigned long v)
+    : tag(Kind::Number), small(v <= INT64_MAX ? v : 0),
+      wide(v <= INT64_MAX ? nullptr : new mpz_class(v)) {}
+
+static bool fitsInt64(double v) { return v >= -0x1p63 && v < 0x1p63; }
+
+JsonValue::JsonValue(double v)
+    : tag(Kind::Number), small(fitsInt64(v) ? static_cast<int64_t>(v) : 0),
+      wide(fitsInt64(v) ? nullptr : new mpz_class(v)) {}
+
+void JsonValue::serialize(JsonWriter& out) const {
     switch (tag) {
         case Kind::String:
-            out << "\"" << str << "\"";
+            out.value(str);
             break;
         case Kind::Number:
-            out << value;
+            if (wide)
+                out.value(*wide);
+            else
+                out.value(static_cast<long>(small));
             break;
         case Kind::True:
-            out << "true";
+            out.value(true);
             break;
         case Kind::False:
-            out << "false";
+            out.value(false);
             break;
         case Kind::Null:
-            out << "null";
+            out.null();
             break;
     }
 }
 
 bool JsonValue::operator==(const bool& b) const
 { return b ? tag == Kind::True : tag == Kind::False; }
-bool JsonValue::operator==(const mpz_class& v) const
-{ return tag == Kind::Number ? v == value : false; }
+bool JsonValue::operator==(const mpz_class& v) const {
+    if (tag != Kind::Number) return false;
+    return wide ? *wide == v : v.fits_slong_p() && v.get_si() == small; }
 bool JsonValue::operator==(const int& v) const
-{ return tag == Kind::Number ? v == value : false; }
+{ return tag == Kind::Number && !wide && small == v; }
 bool JsonValue::operator==(const long& v) const
-{ return tag == Kind::Number ? v == value : false; }
+{ return tag == Kind::Number && !wide && small == v; }
 bool JsonValue::operator==(const unsigned& v) const
-{ return tag == Kind::Number ? v == value : false; }
-bool JsonValue::operator==(const unsigned long& v) const
-{ return tag == Kind::Number ? v == value : false; }
-bool JsonValue::operator==(const double& v) const
-{ return tag == Kind::Number ? v == value : false; }
+{ return tag == Kind::Number && !wide && small == v; }
+bool JsonValue::operator==(const unsigned long& v) const {
+    if (tag != Kind::Number) return false;
+    return wide ? *wide == v : small >= 0 && static_cast<unsigned long>(small) == v; }
+bool JsonValue::operator==(const double& v) const {
+    if (tag != Kind::Number) return false;
+    if (wide) return *wide == v;
+    return fitsInt64(v) && static_cast<int64_t>(v) == small && static_cast<double>(small) == v; }
 bool JsonValue::operator==(const float& v) const
-{ return tag == Kind::Number ? v == value : false; }
+{ return *this == static_cast<double>(v); }
 bool JsonValue::operator==(const cstring& s) const
 { return tag == Kind::String ? s == str : false; }
 bool JsonValue::operator==(const std::string& s) const
@@ -77,7 +108,9 @@ bool JsonValue::operator==(const JsonValue& other) const {
         case Kind::String:
             return str == other.str;
         case Kind::Number:
-            return value == other.value;
+            if (wide || other.wide)
+                return wide && other.wide && *wide == *other.wide;
+            return small == other.small;
         case Kind::True:
         case Kind::False:
         case Kind::Null:
@@ -87,33 +120,19 @@ bool JsonValue::operator==(const JsonValue& other) const {
     }
 }
 
-void JsonArray::serialize(std::ostream& out) const {
-    bool isSmall = true;
+bool JsonArray::isSmall() const {
     for (auto v : *this) {
-        if (!v->is<JsonValue>())
-            isSmall = false;
+        if (v == nullptr || !v->is<JsonValue>())
+            return false;
     }
-    out << "[";
-    if (!isSmall)
-        out << IndentCtl::indent;
-    bool first = true;
-    for (auto v : *this) {
-        if (!first) {
-            out << ",";
-            if (isSmall)
-                out << " ";
-        }
-        if (!isSmall)
-            out << IndentCtl::endl;
-        if (v == nullptr)
-            out << "null";
-        else
-            v->serialize(out);
-        first = false;
-    }
-    if (!isSmall)
-        out << IndentCtl::unindent << IndentCtl::endl;
-    out << "]";
+    return true;
+}
+
+void JsonArray::serialize(JsonWriter& out) const {
+    out.beginArray(isSmall());
+    for (auto v : *this)
+        out.value(v);
+    out.endArray();
 }
 
 bool JsonValue::getBool() const {
@@ -131,14 +150,15 @@ cstring JsonValue::getString() const {
 mpz_class JsonValue::getValue() const {
     if (!isNumber())
         throw std::logic_error("Incorrect json value kind");
-    return value;
+    return wide ? *wide : mpz_class(static_cast<long>(small));
 }
 
 int JsonValue::getInt() const {
-    auto val = getValue();
-    if (!value.fits_sint_p())
+    if (!isNumber())
+        throw std::logic_error("Incorrect json value kind");
+    if (wide || small < INT_MIN || small > INT_MAX)
         throw std::logic_error("Value too large for an int");
-    return val.get_si();
+    return small;
 }
 
 JsonArray* JsonArray::append(IJson* value) {
@@ -146,21 +166,11 @@ JsonArray* JsonArray::append(IJson* value) {
     return this;
 }
 
-void JsonObject::serialize(std::ostream& out) const {
-    out << "{" << IndentCtl::indent;
-    bool first = true;
-    for (auto &it : *this) {
-        if (!first)
-            out << ",";
-        first = false;
-        out << IndentCtl::endl;
-        out << "\"" << it.first << "\"" << " : ";
-        if (it.second == nullptr)
-            out << "null";
-        else
-            it.second->serialize(out);
-    }
-    out << IndentCtl::unindent << IndentCtl::endl << "}";
+void JsonObject::serialize(JsonWriter& out) const {
+    out.beginObject();
+    for (auto &it : *this)
+        out.key(it.first).value(it.second);
+    out.endObject();
 }
 
 JsonObject* JsonObject::emplace(cstring label, IJson* value) {
@@ -173,4 +183,76 @@ JsonObject* JsonObject::emplace(cstring label, IJson* value) {
     return this;
 }
 
+void JsonWriter::separator() {
+    if (scopes.empty())
+        return;
+    auto &scope = scopes.back();
+    if (!scope.array)
+        return;  // written by key()
+    if (!scope.first) {
+        out << ",";
+        if (scope.small && !compact)
+            out << " ";
+    }
+    scope.first = false;
+    if (!scope.small)
+        newline();
+}
+
+JsonWriter &JsonWriter::beginObject() {
+    separator();
+    out << "{";
+    ++indent;
+    scopes.emplace_back(false, false);
+    return *this;
+}
+
+JsonWriter &JsonWriter::endObject() {
+    BUG_CHECK(!scopes.empty() && !scopes.back().array, "endObject outside of a json object");
+    scopes.pop_back();
+    --indent;
+    newline();
+    out << "}";
+    return *this;
+}
+
+JsonWriter &JsonWriter::beginArray(bool small) {
+    separator();
+    out << "[";
+    if (!small)
+        ++indent;
+    scopes.emplace_back(true, small);
+    return *this;
+}
+
+JsonWriter &JsonWriter::endArray() {
+    BUG_CHECK(!scopes.empty() && scopes.back().array, "endArray outside of a json array");
+    if (!scopes.back().small) {
+        --indent;
+        newline();
+    }
+    scopes.pop_back();
+    out << "]";
+    return *this;
+}
+
+JsonWriter &JsonWriter::key(cstring label) {
+    BUG_CHECK(!scopes.empty() && !scopes.back().array, "json key %1% outside of an object",
+              label);
+    auto &scope = scopes.back();
+    if (!scope.first)
+        out << ",";
+    scope.first = false;
+    newline();
+    out << "\"" << label << "\"" << (compact ? ":" : " : ");
+    return *this;
+}
+
+JsonWriter &JsonWriter::value(const IJson *json) {
+    if (json == nullptr)
+        return null();
+    json->serialize(*this);
+    return *this;
+}
+
 }  // namespace Util
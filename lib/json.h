@@ -17,22 +17,29 @@ limitations under the License.
 #ifndef _LIB_JSON_H_
 #define _LIB_JSON_H_
 
+#include <stdint.h>
 #include <iostream>
 #include <vector>
 #include <stdexcept>
 
 #include "lib/gmputil.h"
 #include "lib/cstring.h"
+#include "lib/exceptions.h"
+#include "lib/indent.h"
 #include "lib/ordered_map.h"
 
 namespace Test { class TestJson; }
 
 namespace Util {
 
+class JsonWriter;
+
 class IJson {
  public:
     virtual ~IJson() {}
-    virtual void serialize(std::ostream& out) const = 0;
+    /// A 'compact' serialization has no indentation, line breaks or spaces
+    void serialize(std::ostream& out, bool compact = false) const;
+    virtual void serialize(JsonWriter& out) const = 0;
     cstring toString() const;
     template<typename T> bool is() const { return to<T>() != nullptr; }
     template<typename T> T* to() { return dynamic_cast<T*>(this); }
@@ -51,17 +58,18 @@ class JsonValue final : public IJson {
     };
     JsonValue() : tag(Kind::Null) {}
     JsonValue(bool b) : tag(b ? Kind::True : Kind::False) {}  // NOLINT
-    JsonValue(mpz_class v) : tag(Kind::Number), value(v) {}   // NOLINT
-    JsonValue(int v) : tag(Kind::Number), value(v) {}         // NOLINT
-    JsonValue(long v) : tag(Kind::Number), value(v) {}        // NOLINT
-    JsonValue(unsigned v) : tag(Kind::Number), value(v) {}    // NOLINT
-    JsonValue(unsigned long v) : tag(Kind::Number), value(v) {}// NOLINT
-    JsonValue(double v) : tag(Kind::Number), value(v) {}      // NOLINT
-    JsonValue(float v) : tag(Kind::Number), value(v) {}       // NOLINT
+    JsonValue(const mpz_class &v);                            // NOLINT
+    JsonValue(int v) : tag(Kind::Number), small(v) {}         // NOLINT
+    JsonValue(long v) : tag(Kind::Number), small(v) {}        // NOLINT
+    JsonValue(unsigned v) : tag(Kind::Number), small(v) {}    // NOLINT
+    JsonValue(unsigned long v);                               // NOLINT
+    JsonValue(double v);                                      // NOLINT
+    JsonValue(float v) : JsonValue(static_cast<double>(v)) {} // NOLINT
     JsonValue(cstring s) : tag(Kind::String), str(s) {}       // NOLINT
     JsonValue(std::string s) : tag(Kind::String), str(s) {}   // NOLINT
     JsonValue(const char* s) : tag(Kind::String), str(s) {}   // NOLINT
-    void serialize(std::ostream& out) const;
+    using IJson::serialize;
+    void serialize(JsonWriter& out) const override;
 
     bool operator==(const bool& b) const;
     bool operator==(const mpz_class& v) const;
@@ -95,14 +103,20 @@ class JsonValue final : public IJson {
     }
 
     const Kind tag;
-    const mpz_class value = 0;
+    // Numbers are held in 'small' when they fit in 64 bits, and in 'wide'
+    // (which is then not null) otherwise.
+    const int64_t small = 0;
+    const mpz_class *wide = nullptr;
     const cstring str = nullptr;
 };
 
 class JsonArray final : public IJson, public std::vector<IJson*> {
     friend class Test::TestJson;
  public:
-    void serialize(std::ostream& out) const;
+    using IJson::serialize;
+    void serialize(JsonWriter& out) const override;
+    // true if the array only holds values, so it is written on one line
+    bool isSmall() const;
     JsonArray* append(IJson* value);
     JsonArray* append(bool b) { append(new JsonValue(b)); return this; }
     JsonArray* append(mpz_class v) { append(new JsonValue(v)); return this; }
@@ -124,7 +138,8 @@ class JsonObject final : public IJson, public ordered_map<cstring, IJson*> {
 
  public:
     JsonObject() = default;
-    void serialize(std::ostream& out) const;
+    using IJson::serialize;
+    void serialize(JsonWriter& out) const override;
     JsonObject* emplace(cstring label, IJson* value);
     JsonObject* emplace(cstring label, bool b)
     { emplace(label, new JsonValue(b)); return this; }
@@ -151,6 +166,51 @@ class JsonObject final : public IJson, public ordered_map<cstring, IJson*> {
     IJson* get(cstring label) const { return ::get(*this, label); }
 };
 
+/// Writes JSON to a stream in the same format as IJson::serialize; the
+/// IJson classes serialize through it.  Output that is produced in document
+/// order can be written directly, without building JsonObjects first.
+/// Objects are written as beginObject(), then key() and a value for each
+/// field, then endObject(); a value is a call to value(), null(), or a nested
+/// object or array.  A 'compact' writer leaves out all the whitespace.
+class JsonWriter {
+    struct Scope {
+        bool array, small;
+        bool first = true;
+        Scope(bool array, bool small) : array(array), small(small) {}
+    };
+    std::ostream        &out;
+    std::vector<Scope>  scopes;
+    indent_t            indent;
+    bool                compact;
+
+    void newline() { if (!compact) out << '\n' << indent; }
+    void separator();
+
+ public:
+    explicit JsonWriter(std::ostream &out, bool compact = false)
+    : out(out), indent(indent_t::getindent(out)), compact(compact) {}
+
+    JsonWriter &beginObject();
+    JsonWriter &endObject();
+    /// The elements of 'small' arrays must all be values (see JsonArray::isSmall)
+    JsonWriter &beginArray(bool small = false);
+    JsonWriter &endArray();
+    JsonWriter &key(cstring label);
+
+    JsonWriter &value(const IJson *json);
+    JsonWriter &value(const IJson &json) { json.serialize(*this); return *this; }
+    JsonWriter &value(bool b) { separator(); out << (b ? "true" : "false"); return *this; }
+    JsonWriter &value(const mpz_class &v) { separator(); out << v; return *this; }
+    JsonWriter &value(int v) { separator(); out << v; return *this; }
+    JsonWriter &value(long v) { separator(); out << v; return *this; }
+    JsonWriter &value(unsigned v) { separator(); out << v; return *this; }
+    JsonWriter &value(unsigned long v) { separator(); out << v; return *this; }
+    JsonWriter &value(cstring s) { separator(); out << "\"" << s << "\""; return *this; }
+    JsonWriter &value(const std::string &s) { return value(cstring(s)); }
+    JsonWriter &value(const char *s) { return value(cstring(s)); }
+    JsonWriter &null() { separator(); out << "null"; return *this; }
+};
+
 }  // namespace Util
 
 #endif  /* _LIB_JSON_H_ */
@@ -26,6 +26,8 @@ limitations under the License.
 #include <mutex>
 #endif  // MULTITHREAD
 
+#include "gc.h"
+
 namespace Log {
 namespace Detail {
 
@@ -126,6 +128,7 @@ int fileLogLevel(const char* file) {
     // This is the slow path. We have to walk @debugSpecs to see if there are any
     // specs that match @file.
     mostRecentLevel = uncachedFileLogLevel(file);
+    OutsideArena permanent;
     logLevelCache[file] = mostRecentLevel;
     return mostRecentLevel;
 }
@@ -61,6 +61,8 @@ inline bool fileLogLevelIsAtLeast(const char* file, int level) {
 void addDebugSpec(const char* spec);
 
 inline bool verbose() { return Detail::verbosity > 0; }
+// True if logging has been turned on for any file.
+inline bool enabled() { return Detail::maximumLogLevel > 0; }
 inline int verbosity() { return Detail::verbosity; }
 void increaseVerbosity();
 
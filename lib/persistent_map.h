@@ -0,0 +1,197 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef P4C_LIB_PERSISTENT_MAP_H_
+#define P4C_LIB_PERSISTENT_MAP_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+// An ordered map whose copies share their nodes until they are written, so
+// copying is constant time.  It is a treap whose priorities are hashes of the
+// keys, so its shape depends only on the set of keys it holds; merging two
+// copies of the same map walks both trees in step and skips the subtrees they
+// still share.  Values are only accessible through const references, except
+// through operator[], which copies the path to the element (and inserts it if
+// needed): look elements up with getref() when only reading them.
+// The nodes are never freed; this relies on the garbage collector.
+template <class K, class V, class COMP = std::less<K>, class HASH = std::hash<K>>
+class persistent_map {
+ public:
+    typedef K                           key_type;
+    typedef V                           mapped_type;
+    typedef std::pair<const K, V>       value_type;
+    typedef size_t                      size_type;
+
+ private:
+    struct node {
+        value_type      value;
+        node            *left = nullptr, *right = nullptr;
+        size_t          priority;
+        unsigned        owner;  // nodes owned by a map can be modified in place
+        node(const K &k, size_t p, unsigned o) : value(k, V()), priority(p), owner(o) {}
+        node(const node &n, unsigned o)
+        : value(n.value), left(n.left), right(n.right), priority(n.priority), owner(o) {}
+    };
+    node                *root = nullptr;
+    size_t              entries = 0;
+    mutable unsigned    owner = newOwner();
+    COMP                comp;
+    HASH                hasher;
+
+    // maps are created by passes running on several threads
+    static unsigned newOwner() { static std::atomic<unsigned> next(0); return ++next; }
+    size_t priority(const K &k) const {
+        return static_cast<uint64_t>(hasher(k)) * 0x9E3779B97F4A7C15ULL; }
+    // ties between priorities are broken by key so the shape is still unique
+    bool above(const node *a, const node *b) const {
+        return a->priority > b->priority ||
+              (a->priority == b->priority && comp(a->value.first, b->value.first)); }
+    bool equal(const K &a, const K &b) const { return !comp(a, b) && !comp(b, a); }
+    node *own(node *n) const { return n->owner == owner ? n : new node(*n, owner); }
+
+    const node *lookup(const K &k) const {
+        const node *n = root;
+        while (n) {
+            if (comp(k, n->value.first)) n = n->left;
+            else if (comp(n->value.first, k)) n = n->right;
+            else
+                return n; }
+        return nullptr; }
+    node *modify(node *n, const K &k, V *&result) {
+        if (!n) {
+            ++entries;
+            n = new node(k, priority(k), owner);
+            result = &n->value.second;
+            return n; }
+        n = own(n);
+        if (comp(k, n->value.first)) {
+            n->left = modify(n->left, k, result);
+            if (above(n->left, n)) {  // rotate right
+                node *l = n->left;
+                n->left = l->right;
+                l->right = n;
+                return l; }
+        } else if (comp(n->value.first, k)) {
+            n->right = modify(n->right, k, result);
+            if (above(n->right, n)) {  // rotate left
+                node *r = n->right;
+                n->right = r->left;
+                r->left = n;
+                return r; }
+        } else {
+            result = &n->value.second; }
+        return n; }
+    // Returns 'n' if nothing in its subtree changed
+    node *rebuild(node *n, node *left, node *right, const V &val) {
+        if (left == n->left && right == n->right && val == n->value.second)
+            return n;
+        n = own(n);
+        n->left = left;
+        n->right = right;
+        n->value.second = val;
+        return n; }
+    template<class F> node *modify_all(node *n, F &fn) {
+        if (!n) return n;
+        node *left = modify_all(n->left, fn);
+        V val = n->value.second;
+        fn(n->value.first, val);
+        node *right = modify_all(n->right, fn);
+        return rebuild(n, left, right, val); }
+    // 'o' is the node at the same position in 'other' when both trees have the
+    // same shape down to here, or nullptr once they differ
+    template<class F>
+    node *merge(node *n, const node *o, const persistent_map &other, F &fn) {
+        if (!n || n == o) return n;
+        if (o && !equal(n->value.first, o->value.first)) o = nullptr;
+        node *left = merge(n->left, o ? o->left : nullptr, other, fn);
+        V val = n->value.second;
+        fn(val, o ? &o->value.second : other.getref(n->value.first));
+        node *right = merge(n->right, o ? o->right : nullptr, other, fn);
+        return rebuild(n, left, right, val); }
+
+ public:
+    class const_iterator : public std::iterator<std::forward_iterator_tag, const value_type> {
+        friend class persistent_map;
+        std::vector<const node *>       stack;  // path to the current node
+        void descend(const node *n) { for (; n; n = n->left) stack.push_back(n); }
+        explicit const_iterator(const node *root) { descend(root); }
+     public:
+        const_iterator() = default;
+        const value_type &operator*() const { return stack.back()->value; }
+        const value_type *operator->() const { return &stack.back()->value; }
+        const_iterator &operator++() {
+            const node *n = stack.back();
+            stack.pop_back();
+            descend(n->right);
+            return *this; }
+        const_iterator operator++(int) { const_iterator rv = *this; ++*this; return rv; }
+        bool operator==(const const_iterator &i) const {
+            return stack.empty() ? i.stack.empty() : !i.stack.empty() &&
+                                   stack.back() == i.stack.back(); }
+        bool operator!=(const const_iterator &i) const { return !(*this == i); }
+    };
+    typedef const_iterator iterator;
+
+    persistent_map() = default;
+    // the copy and the original both lose ownership of the shared nodes
+    persistent_map(const persistent_map &m)
+    : root(m.root), entries(m.entries), comp(m.comp), hasher(m.hasher) {
+        m.owner = newOwner(); }
+    persistent_map &operator=(const persistent_map &m) {
+        root = m.root;
+        entries = m.entries;
+        owner = newOwner();
+        m.owner = newOwner();
+        return *this; }
+
+    const_iterator begin() const { return const_iterator(root); }
+    const_iterator end() const { return const_iterator(); }
+    bool empty() const { return entries == 0; }
+    size_t size() const { return entries; }
+    void clear() { root = nullptr; entries = 0; }
+    size_t count(const K &k) const { return lookup(k) != nullptr; }
+    const V *getref(const K &k) const {
+        auto n = lookup(k);
+        return n ? &n->value.second : nullptr; }
+
+    V &operator[](const K &k) {
+        V *result = nullptr;
+        root = modify(root, k, result);
+        return *result; }
+    // Calls fn(key, value) on every element in key order; fn may change the value
+    template<class F> void modify_all(F fn) { root = modify_all(root, fn); }
+    // Calls fn(value, other_value) on every element in key order, where
+    // other_value points to the value for the same key in 'other', or is nullptr
+    // if 'other' does not have it; fn may change the value.  Elements only in
+    // 'other' are ignored.  fn(v, &v) must leave v unchanged.
+    template<class F> void merge(const persistent_map &other, F fn) {
+        root = merge(root, other.root, other, fn); }
+};
+
+// getref() as in map.h
+namespace GetImpl {
+template<class K, class T, class V, class COMP, class HASH>
+inline const V *getref(const persistent_map<K, V, COMP, HASH> &m, T key) {
+    return m.getref(key); }
+}  // namespace GetImpl
+using namespace GetImpl;  // NOLINT(build/namespaces)
+
+#endif /* P4C_LIB_PERSISTENT_MAP_H_ */
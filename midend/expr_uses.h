@@ -31,8 +31,20 @@ class exprUses : public Inspector {
         if (p->name == look_for) result = true;
         return !result; }
     bool preorder(const IR::Expression *) override { return !result; }
+    // Literals have no Path inside: BoolLiterals have no children and a Constant
+    // only visits its type
+    static bool isLiteral(const IR::Expression *e) {
+        if (e->is<IR::BoolLiteral>()) return true;
+        return e->is<IR::Constant>() && e->type &&
+               (e->type->is<IR::Type_Bits>() || e->type->is<IR::Type_InfInt>()); }
+
  public:
-    exprUses(const IR::Expression *e, cstring n) : look_for(n) { e->apply(*this); }
+    exprUses(const IR::Expression *e, cstring n) : look_for(n) {
+        // shortcuts for the most common leaves, which avoid setting up a traversal
+        if (auto path = e->to<IR::PathExpression>())
+            result = path->path->name == look_for;
+        else if (!isLiteral(e))
+            e->apply(*this); }
     explicit operator bool () { return result; }
 };
 
@@ -72,7 +72,7 @@ class FindLocationSets : public Inspector {
         auto storage = storageMap->getStorage(decl);
         const LocationSet* result;
         if (storage != nullptr)
-            result = new LocationSet(storage);
+            result = LocationSet::intern(new LocationSet(storage));
         else
             result = LocationSet::empty;
         set(expression, result);
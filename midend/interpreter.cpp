@@ -1,4 +1,7 @@
 #include "interpreter.h"
+
+#include <boost/functional/hash.hpp>
+
 #include "frontends/common/constantFolding.h"
 #include "frontends/p4/methodInstance.h"
 #include "frontends/p4/coreLibrary.h"
@@ -8,7 +11,7 @@ namespace P4 {
 unsigned SymbolicValue::crtid = 0;
 
 SymbolicValue* SymbolicValueFactory::create(const IR::Type* type, bool uninitialized) const {
-    type = typeMap->getType(type, true);
+    type = typeMap->getTypeType(type, true);
     if (type->is<IR::Type_Bits>())
         return new SymbolicInteger(ScalarValue::init(uninitialized), type->to<IR::Type_Bits>());
     if (type->is<IR::Type_Boolean>())
@@ -53,7 +56,7 @@ SymbolicValue* SymbolicValueFactory::create(const IR::Type* type, bool uninitial
 }
 
 bool SymbolicValueFactory::isFixedWidth(const IR::Type* type) const {
-    type = typeMap->getType(type, true);
+    type = typeMap->getTypeType(type, true);
     if (type->is<IR::Type_Varbits>())
         return false;
     if (type->is<IR::Type_Extern>())
@@ -79,7 +82,7 @@ bool SymbolicValueFactory::isFixedWidth(const IR::Type* type) const {
 }
 
 unsigned SymbolicValueFactory::getWidth(const IR::Type* type) const {
-    type = typeMap->getType(type, true);
+    type = typeMap->getTypeType(type, true);
     if (type->is<IR::Type_Bits>())
         return type->to<IR::Type_Bits>()->size;
     if (type->is<IR::Type_Boolean>())
@@ -153,6 +156,13 @@ bool SymbolicBool::equals(const SymbolicValue* other) const {
     return true;
 }
 
+size_t SymbolicBool::hash() const {
+    size_t result = ScalarValue::hash();
+    if (isKnown())
+        boost::hash_combine(result, value);
+    return result;
+}
+
 bool SymbolicInteger::merge(const SymbolicValue* other) {
     BUG_CHECK(other->is<SymbolicInteger>(), "%1%: expected an integer", other);
     auto io = other->to<SymbolicInteger>();
@@ -184,6 +194,13 @@ bool SymbolicInteger::equals(const SymbolicValue* other) const {
     return true;
 }
 
+size_t SymbolicInteger::hash() const {
+    size_t result = ScalarValue::hash();
+    if (isKnown())
+        boost::hash_combine(result, mpz_get_ui(constant->value.get_mpz_t()));
+    return result;
+}
+
 bool SymbolicVarbit::merge(const SymbolicValue* other) {
     BUG_CHECK(other->is<SymbolicVarbit>(), "%1%: expected a varbit", other);
     auto vo = other->to<SymbolicVarbit>();
@@ -233,6 +250,13 @@ bool SymbolicEnum::equals(const SymbolicValue* other) const {
     return true;
 }
 
+size_t SymbolicEnum::hash() const {
+    size_t result = ScalarValue::hash();
+    if (isKnown())
+        boost::hash_combine(result, value.name.hash());
+    return result;
+}
+
 //////////////////////////////////////////////////////////////////////////////////
 
 SymbolicStruct::SymbolicStruct(const IR::Type_StructLike* type, bool uninitialized,
@@ -240,23 +264,30 @@ SymbolicStruct::SymbolicStruct(const IR::Type_StructLike* type, bool uninitializ
     CHECK_NULL(type); CHECK_NULL(factory);
     for (auto f : *type->fields) {
         auto value = factory->create(f->type, uninitialized);
+        value->setOwner(owner);
         fieldValue[f->name.name] = value;
     }
 }
 
 SymbolicValue* SymbolicStruct::clone() const {
     auto result = new SymbolicStruct(type->to<IR::Type_StructLike>());
-    for (auto f : fieldValue)
-        result->fieldValue[f.first] = f.second->clone();
+    result->fieldValue = fieldValue;
+    owner = newOwner();
     return result;
 }
 
+void SymbolicStruct::setOwner(unsigned token) {
+    owner = token;
+    for (auto f : fieldValue)
+        f.second->setOwner(token);
+}
+
 void SymbolicStruct::assign(const SymbolicValue* other) {
     if (other->is<SymbolicError>()) return;
     BUG_CHECK(other->is<SymbolicStruct>(), "%1%: expected a struct", other);
     auto sv = other->to<SymbolicStruct>();
     for (auto f : sv->fieldValue)
-        fieldValue[f.first]->assign(f.second);
+        own(fieldValue[f.first])->assign(f.second);
 }
 
 bool SymbolicStruct::merge(const SymbolicValue* other) {
@@ -264,13 +295,13 @@ bool SymbolicStruct::merge(const SymbolicValue* other) {
     auto sv = other->to<SymbolicStruct>();
     bool changes = false;
     for (auto f : sv->fieldValue)
-        changes = changes || fieldValue[f.first]->merge(f.second);
+        changes = changes || own(fieldValue[f.first])->merge(f.second);
     return changes;
 }
 
 void SymbolicStruct::setAllUnknown() {
     for (auto f : *type->to<IR::Type_StructLike>()->fields)
-        fieldValue[f->name.name]->setAllUnknown();
+        own(fieldValue[f->name.name])->setAllUnknown();
 }
 
 bool SymbolicStruct::equals(const SymbolicValue* other) const {
@@ -283,6 +314,13 @@ bool SymbolicStruct::equals(const SymbolicValue* other) const {
     return true;
 }
 
+size_t SymbolicStruct::hash() const {
+    size_t result = 0;
+    for (auto f : fieldValue)
+        boost::hash_combine(result, f.second->hash());
+    return result;
+}
+
 bool SymbolicStruct::hasUninitializedParts() const {
     for (auto f : fieldValue)
         if (f.second->hasUninitializedParts())
@@ -310,12 +348,18 @@ SymbolicHeader::SymbolicHeader(const IR::Type_Header* type,
                                bool uninitialized,
                                const SymbolicValueFactory* factory) :
         SymbolicStruct(type, uninitialized, factory),
-        valid(new SymbolicBool(false)) {}
+        valid(new SymbolicBool(false)) { valid->setOwner(owner); }
 
 void SymbolicHeader::setValid(bool v) {
     if (!v)
         setAllUnknown();
     valid = new SymbolicBool(v);
+    valid->setOwner(owner);
+}
+
+void SymbolicHeader::setOwner(unsigned token) {
+    SymbolicStruct::setOwner(token);
+    valid->setOwner(token);
 }
 
 SymbolicValue* SymbolicHeader::get(const IR::Node* node, cstring field) const {
@@ -324,16 +368,22 @@ SymbolicValue* SymbolicHeader::get(const IR::Node* node, cstring field) const {
     return SymbolicStruct::get(node, field);
 }
 
+SymbolicValue* SymbolicHeader::getOwned(const IR::Node* node, cstring field) {
+    if (valid->isKnown() && !valid->value)
+        return new SymbolicStaticError(node, "Reading field from invalid header");
+    return SymbolicStruct::getOwned(node, field);
+}
+
 void SymbolicHeader::setAllUnknown() {
     SymbolicStruct::setAllUnknown();
-    valid->setAllUnknown();
+    own(valid)->setAllUnknown();
 }
 
 SymbolicValue* SymbolicHeader::clone() const {
     auto result = new SymbolicHeader(type->to<IR::Type_Header>());
-    for (auto f : fieldValue)
-        result->fieldValue[f.first] = f.second->clone();
-    result->valid = valid->clone()->to<SymbolicBool>();
+    result->fieldValue = fieldValue;
+    result->valid = valid;
+    owner = newOwner();
     return result;
 }
 
@@ -342,8 +392,8 @@ void SymbolicHeader::assign(const SymbolicValue* other) {
     BUG_CHECK(other->is<SymbolicHeader>(), "%1%: expected a header", other);
     auto hv = other->to<SymbolicHeader>();
     for (auto f : hv->fieldValue)
-        fieldValue[f.first]->assign(f.second);
-    valid->assign(hv->valid);
+        own(fieldValue[f.first])->assign(f.second);
+    own(valid)->assign(hv->valid);
 }
 
 bool SymbolicHeader::merge(const SymbolicValue* other) {
@@ -351,8 +401,8 @@ bool SymbolicHeader::merge(const SymbolicValue* other) {
     auto hv = other->to<SymbolicHeader>();
     bool changes = false;
     for (auto f : hv->fieldValue)
-        changes = changes || fieldValue[f.first]->merge(f.second);
-    changes = changes || valid->merge(hv->valid);
+        changes = changes || own(fieldValue[f.first])->merge(f.second);
+    changes = changes || own(valid)->merge(hv->valid);
     return changes;
 }
 
@@ -368,6 +418,14 @@ bool SymbolicHeader::equals(const SymbolicValue* other) const {
     return SymbolicStruct::equals(other);
 }
 
+size_t SymbolicHeader::hash() const {
+    size_t result = valid->hash();
+    if (valid->isKnown() && !valid->value)
+        return result;
+    boost::hash_combine(result, SymbolicStruct::hash());
+    return result;
+}
+
 void SymbolicHeader::dbprint(std::ostream& out) const {
     out << "{ ";
     out << "valid=>";
@@ -388,31 +446,47 @@ SymbolicArray::SymbolicArray(const IR::Type_Stack* type, bool uninitialized,
     for (unsigned i=0; i < size; i++) {
         auto elem = factory->create(elemType, uninitialized);
         BUG_CHECK(elem->is<SymbolicHeader>(), "%1%: expected a header", elem);
+        elem->setOwner(owner);
         values.push_back(elem->to<SymbolicHeader>());
     }
 }
 
+void SymbolicArray::setOwner(unsigned token) {
+    owner = token;
+    for (auto v : values)
+        v->setOwner(token);
+}
+
 void SymbolicArray::shift(int amount) {
     if (amount < 0) {
         for (unsigned i = 0; i < values.size() + amount; i++)
             values[i] = values[i - amount];
         for (unsigned i = values.size() + amount; i < values.size(); i++)
-            values[i]->setValid(false);
+            values[i] = invalid(values[i]);
     } else if (amount > 0) {
         for (unsigned i = 0; i < values.size() - amount; i++)
             values[values.size() - i - 1] = values[values.size() - i - amount - 1];
         for (unsigned i = 0; i < (unsigned)amount; i++)
-            values[i]->setValid(false);
+            values[i] = invalid(values[i]);
     }
 }
 
+// A new invalid header; the vacated slots of a shift may still hold
+// elements that were moved to another position.
+SymbolicHeader* SymbolicArray::invalid(const SymbolicHeader* value) const {
+    auto result = value->clone()->to<SymbolicHeader>();
+    result->setValid(false);  // copies all the fields
+    result->setOwner(owner);
+    return result;
+}
+
 SymbolicValue* SymbolicArray::next(const IR::Node* node) {
     for (unsigned i = 0; i < values.size(); i++) {
         auto v = values.at(i);
         if (v->valid->isUnknown() || v->valid->isUninitialized())
             return new AnyElement(this);
         if (!v->valid->value)
-            return v;
+            return own(values.at(i));
     }
     return new SymbolicException(node, P4::StandardExceptions::StackOutOfBounds);
 }
@@ -424,20 +498,20 @@ SymbolicValue* SymbolicArray::last(const IR::Node* node) {
         if (v->valid->isUnknown() || v->valid->isUninitialized())
             return new AnyElement(this);
         if (v->valid->value)
-            return v;
+            return own(values.at(index));
     }
     return new SymbolicException(node, P4::StandardExceptions::StackOutOfBounds);
 }
 
 void SymbolicArray::setAllUnknown() {
     for (unsigned i = 0; i < values.size(); i++)
-        values.at(i)->setAllUnknown();
+        own(values.at(i))->setAllUnknown();
 }
 
 SymbolicValue* SymbolicArray::clone() const {
     auto result = new SymbolicArray(type->to<IR::Type_Stack>());
-    for (unsigned i=0; i < values.size(); i++)
-        result->values.push_back(get(nullptr, i)->clone()->to<SymbolicHeader>());
+    result->values = values;
+    owner = newOwner();
     return result;
 }
 
@@ -445,14 +519,14 @@ void SymbolicArray::assign(const SymbolicValue* other) {
     if (other->is<SymbolicError>()) return;
     BUG_CHECK(other->is<SymbolicArray>(), "%1%: expected an array", other);
     for (unsigned i=0; i < values.size(); i++)
-        values.at(i)->assign(other->to<SymbolicArray>()->get(nullptr, i));
+        own(values.at(i))->assign(other->to<SymbolicArray>()->get(nullptr, i));
 }
 
 bool SymbolicArray::merge(const SymbolicValue* other) {
     BUG_CHECK(other->is<SymbolicArray>(), "%1%: expected an array", other);
     bool changes = false;
     for (unsigned i=0; i < values.size(); i++)
-        changes = changes || values.at(i)->merge(other->to<SymbolicArray>()->get(nullptr, i));
+        changes = changes || own(values.at(i))->merge(other->to<SymbolicArray>()->get(nullptr, i));
     return changes;
 }
 
@@ -467,6 +541,13 @@ bool SymbolicArray::equals(const SymbolicValue* other) const {
     return true;
 }
 
+size_t SymbolicArray::hash() const {
+    size_t result = 0;
+    for (auto v : values)
+        boost::hash_combine(result, v->hash());
+    return result;
+}
+
 bool SymbolicArray::hasUninitializedParts() const {
     for (unsigned i=0; i < values.size(); i++)
         if (values.at(i)->hasUninitializedParts())
@@ -511,19 +592,26 @@ SymbolicTuple::SymbolicTuple(const IR::Type_Tuple* type, bool uninitialized,
         SymbolicValue(type) {
     for (auto t : *type->components) {
         auto v = factory->create(t, uninitialized);
+        v->setOwner(owner);
         values.push_back(v);
     }
 }
 
+void SymbolicTuple::setOwner(unsigned token) {
+    owner = token;
+    for (auto v : values)
+        v->setOwner(token);
+}
+
 void SymbolicTuple::setAllUnknown() {
     for (unsigned i = 0; i < values.size(); i++)
-        values.at(i)->setAllUnknown();
+        own(values.at(i))->setAllUnknown();
 }
 
 SymbolicValue* SymbolicTuple::clone() const {
     auto result = new SymbolicTuple(type->to<IR::Type_Tuple>());
-    for (unsigned i=0; i < values.size(); i++)
-        result->values.push_back(get(i)->clone());
+    result->values = values;
+    owner = newOwner();
     return result;
 }
 
@@ -533,7 +621,7 @@ bool SymbolicTuple::merge(const SymbolicValue* other) {
     BUG_CHECK(values.size() == tpl->values.size(), "merging tuples with different sizes");
     bool changes = false;
     for (unsigned i=0; i < values.size(); i++)
-        changes = changes || values.at(i)->merge(tpl->get(i));
+        changes = changes || own(values.at(i))->merge(tpl->get(i));
     return changes;
 }
 
@@ -547,6 +635,13 @@ bool SymbolicTuple::equals(const SymbolicValue* other) const {
     return true;
 }
 
+size_t SymbolicTuple::hash() const {
+    size_t result = 0;
+    for (auto v : values)
+        boost::hash_combine(result, v->hash());
+    return result;
+}
+
 bool SymbolicTuple::hasUninitializedParts() const {
     for (unsigned i=0; i < values.size(); i++)
         if (values.at(i)->hasUninitializedParts())
@@ -581,8 +676,18 @@ bool SymbolicPacketIn::equals(const SymbolicValue* other) const {
     return minimumStreamOffset == sp->minimumStreamOffset;
 }
 
+size_t SymbolicPacketIn::hash() const
+{ return minimumStreamOffset; }
+
 SymbolicVoid* SymbolicVoid::instance = new SymbolicVoid();
 
+size_t ValueMap::hash() const {
+    size_t result = 0;
+    for (auto v : map)
+        boost::hash_combine(result, v.second->hash());
+    return result;
+}
+
 /*****************************************************************************************/
 
 void ExpressionEvaluator::postorder(const IR::Operation_Binary* expression) {
@@ -772,7 +877,7 @@ void ExpressionEvaluator::postorder(const IR::Member* expression) {
         set(expression, v);
     } else {
         BUG_CHECK(l->is<SymbolicStruct>(), "%1%: expected a struct", l);
-        auto v = l->to<SymbolicStruct>()->get(expression, expression->member.name);
+        auto v = l->to<SymbolicStruct>()->getOwned(expression, expression->member.name);
         set(expression, v);
     }
 }
@@ -783,6 +888,7 @@ bool ExpressionEvaluator::preorder(const IR::ArrayIndex* expression) {
     visit(expression->left);
     evaluatingLeftValue = lv;
     visit(expression->right);
+    postorder(expression);
     return false;  // prune
 }
 
@@ -816,7 +922,7 @@ void ExpressionEvaluator::postorder(const IR::ArrayIndex* expression) {
     CHECK_NULL(lv);
     auto ix = r->to<SymbolicInteger>();
     CHECK_NULL(ix);
-    auto result = lv->get(expression, ix->constant->asInt());
+    auto result = lv->getOwned(expression, ix->constant->asInt());
     set(expression, result);
 }
 
@@ -827,7 +933,7 @@ void ExpressionEvaluator::postorder(const IR::PathExpression* expression) {
     if (type->is<IR::Type_Error>())
         result = new SymbolicEnum(type, decl->getName());
     else
-        result = valueMap->get(decl);
+        result = valueMap->getOwned(decl);
     set(expression, result);
 }
 
@@ -930,7 +1036,7 @@ void ExpressionEvaluator::postorder(const IR::MethodCallExpression* expression)
                 }
 
                 auto decl = em->object;
-                auto obj = valueMap->get(decl);
+                auto obj = valueMap->getOwned(decl);
                 CHECK_NULL(obj);
                 if (obj->is<SymbolicError>()) {
                     set(expression, obj);
@@ -973,8 +1079,7 @@ void ExpressionEvaluator::postorder(const IR::MethodCallExpression* expression)
         mi->actualMethodType->returnType->is<IR::Type_Void>()) {
         set(expression, SymbolicVoid::get());
     } else {
-        auto type = typeMap->getType(mi->actualMethodType->returnType, true);
-        auto res = factory->create(type, false);
+        auto res = factory->create(mi->actualMethodType->returnType, false);
         set(expression, res);
     }
 }
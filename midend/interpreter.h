@@ -18,6 +18,7 @@ limitations under the License.
 #define _MIDEND_INTERPRETER_H_
 
 #include "ir/ir.h"
+#include "lib/persistent_map.h"
 #include "frontends/common/resolveReferences/referenceMap.h"
 #include "frontends/p4/typeMap.h"
 #include "frontends/p4/coreLibrary.h"
@@ -28,12 +29,30 @@ namespace P4 {
 
 class SymbolicValueFactory;
 
-// Base class for all abstract values
+// Base class for all abstract values.
+// Composite values share their components with their clones (copy-on-write):
+// a component can only be changed in place if it has the same owner as the
+// value that contains it; otherwise it is first replaced by a private clone.
 class SymbolicValue {
     static unsigned crtid;
+    friend class ValueMap;
 
  protected:
-    explicit SymbolicValue(const IR::Type* type) : id(crtid++), type(type) {}
+    explicit SymbolicValue(const IR::Type* type) : id(crtid++), type(type)
+    { owner = id; }
+    // Values with the same owner are modified together.
+    // Changed by clone(), so that neither the original nor the
+    // clone modifies the shared components in place.
+    mutable unsigned owner;
+    static unsigned newOwner() { return crtid++; }
+    // Make 'component' private to this value before it is modified.
+    template<typename T> T* own(T*& component) {
+        if (component->owner != owner) {
+            component = component->clone()->template to<T>();
+            component->owner = owner;
+        }
+        return component;
+    }
 
  public:
     const unsigned id;
@@ -54,6 +73,12 @@ class SymbolicValue {
     // Returns 'true' if merging changed the current value.
     virtual bool merge(const SymbolicValue* other) = 0;
     virtual bool equals(const SymbolicValue* other) const = 0;
+    // Give a value that was just created, and is not shared, and all its
+    // components the owner 'token' of the value or map that will hold it,
+    // so that its first modification does not copy it.
+    virtual void setOwner(unsigned token) { owner = token; }
+    // Values that are equal have the same hash
+    virtual size_t hash() const { return 0; }
     // True if some parts of this value are definitely uninitialized
     virtual bool hasUninitializedParts() const = 0;
 };
@@ -73,26 +98,46 @@ class SymbolicValueFactory {
     unsigned getWidth(const IR::Type* type) const;
 };
 
+// Values are shared between a ValueMap and its clones until they are modified;
+// use getOwned to obtain a value that can be modified.
 class ValueMap final : public IHasDbPrint {
+    mutable unsigned owner = SymbolicValue::newOwner();
+
  public:
-    std::map<const IR::IDeclaration*, SymbolicValue*> map;
+    // Clones share the map until one of them is written
+    persistent_map<const IR::IDeclaration*, SymbolicValue*> map;
     ValueMap* clone() const {
         auto result = new ValueMap();
-        for (auto v : map)
-            result->map.emplace(v.first, v.second->clone());
+        result->map = map;
+        owner = SymbolicValue::newOwner();
         return result;
     }
     ValueMap* filter(std::function<bool(const IR::IDeclaration*, const SymbolicValue*)> filter) {
         auto result = new ValueMap();
         for (auto v : map)
             if (filter(v.first, v.second))
-                result->map.emplace(v.first, v.second);
+                result->map[v.first] = v.second;
         return result;
     }
     void set(const IR::IDeclaration* left, SymbolicValue* right)
     { CHECK_NULL(left); CHECK_NULL(right); map[left] = right; }
-    SymbolicValue* get(const IR::IDeclaration* left) const
-    { CHECK_NULL(left); return ::get(map, left); }
+    // Like set, for a value that was just created and is not shared
+    void setOwned(const IR::IDeclaration* left, SymbolicValue* right)
+    { set(left, right); right->setOwner(owner); }
+    SymbolicValue* get(const IR::IDeclaration* left) const {
+        CHECK_NULL(left);
+        auto value = map.getref(left);
+        return value ? *value : nullptr;
+    }
+    SymbolicValue* getOwned(const IR::IDeclaration* left) {
+        auto value = get(left);
+        if (value != nullptr && value->owner != owner) {
+            value = value->clone();
+            value->owner = owner;
+            map[left] = value;
+        }
+        return value;
+    }
 
     void dbprint(std::ostream& out) const {
         bool first = true;
@@ -103,16 +148,29 @@ class ValueMap final : public IHasDbPrint {
             first = false;
         }
     }
+    // Values still shared with 'other' are skipped, and a value that
+    // does not change is not copied.
     bool merge(const ValueMap* other) {
         bool change = false;
         BUG_CHECK(map.size() == other->map.size(), "Merging incompatible maps?");
-        for (auto d : map) {
-            auto v = other->get(d.first);
-            CHECK_NULL(v);
-            change = change || d.second->merge(v);
-        }
+        map.merge(other->map, [this, &change](SymbolicValue*& value,
+                                              SymbolicValue* const* otherValue) {
+            CHECK_NULL(otherValue);
+            if (change || value == *otherValue)
+                return;
+            auto merged = value;
+            if (merged->owner != owner) {
+                merged = value->clone();
+                merged->owner = owner;
+            }
+            if (merged->merge(*otherValue)) {
+                value = merged;
+                change = true;
+            }
+        });
         return change;
     }
+    size_t hash() const;
     bool equals(const ValueMap* other) const {
         BUG_CHECK(map.size() == other->map.size(), "Incompatible maps compared");
         for (auto v : map) {
@@ -249,6 +307,7 @@ class ScalarValue : public SymbolicValue {
     }
     bool hasUninitializedParts() const override
     { return state == ValueState::Uninitialized; }
+    size_t hash() const override { return static_cast<size_t>(state); }
 };
 
 class SymbolicVoid : public SymbolicValue {
@@ -296,6 +355,7 @@ class SymbolicBool final : public ScalarValue {
     void assign(const SymbolicValue* other) override;
     bool merge(const SymbolicValue* other) override;
     bool equals(const SymbolicValue* other) const override;
+    size_t hash() const override;
 };
 
 class SymbolicInteger final : public ScalarValue {
@@ -322,6 +382,7 @@ class SymbolicInteger final : public ScalarValue {
     void assign(const SymbolicValue* other) override;
     bool merge(const SymbolicValue* other) override;
     bool equals(const SymbolicValue* other) const override;
+    size_t hash() const override;
 };
 
 class SymbolicVarbit final : public ScalarValue {
@@ -360,6 +421,7 @@ class SymbolicEnum final : public ScalarValue {
     void assign(const SymbolicValue* other) override;
     bool merge(const SymbolicValue* other) override;
     bool equals(const SymbolicValue* other) const override;
+    size_t hash() const override;
 };
 
 class SymbolicStruct : public SymbolicValue {
@@ -376,6 +438,12 @@ class SymbolicStruct : public SymbolicValue {
         CHECK_NULL(r);
         return r;
     }
+    // Like get, but the field value can be modified
+    virtual SymbolicValue* getOwned(const IR::Node*, cstring field) {
+        auto it = fieldValue.find(field);
+        BUG_CHECK(it != fieldValue.end(), "%1%: no such field", field);
+        return own(it->second);
+    }
     void set(cstring field, SymbolicValue* value) {
         CHECK_NULL(value);
         fieldValue[field] = value;
@@ -387,7 +455,9 @@ class SymbolicStruct : public SymbolicValue {
     void assign(const SymbolicValue* other) override;
     bool merge(const SymbolicValue* other) override;
     bool equals(const SymbolicValue* other) const override;
+    size_t hash() const override;
     bool hasUninitializedParts() const override;
+    void setOwner(unsigned token) override;
 };
 
 class SymbolicHeader : public SymbolicStruct {
@@ -399,16 +469,20 @@ class SymbolicHeader : public SymbolicStruct {
     virtual void setValid(bool v);
     SymbolicValue* clone() const override;
     SymbolicValue* get(const IR::Node* node, cstring field) const override;
+    SymbolicValue* getOwned(const IR::Node* node, cstring field) override;
     void setAllUnknown() override;
     void assign(const SymbolicValue* other) override;
     void dbprint(std::ostream& out) const override;
     bool merge(const SymbolicValue* other) override;
     bool equals(const SymbolicValue* other) const override;
+    size_t hash() const override;
+    void setOwner(unsigned token) override;
 };
 
 class SymbolicArray final : public SymbolicValue {
     std::vector<SymbolicHeader*> values;
     friend class AnyElement;
+    SymbolicHeader* invalid(const SymbolicHeader* value) const;
     explicit SymbolicArray(const IR::Type_Stack* type) :
             SymbolicValue(type), size(type->getSize()),
             elemType(type->elementType->to<IR::Type_Header>()) {}
@@ -423,6 +497,12 @@ class SymbolicArray final : public SymbolicValue {
             return new SymbolicStaticError(node, "Out of bounds");
         return values.at(index);
     }
+    // Like get, but the element can be modified
+    SymbolicValue* getOwned(const IR::Node* node, size_t index) {
+        if (index >= values.size())
+            return new SymbolicStaticError(node, "Out of bounds");
+        return own(values.at(index));
+    }
     void shift(int amount);  // negative = shift left
     void set(size_t index, SymbolicHeader* value) {
         CHECK_NULL(value);
@@ -437,7 +517,9 @@ class SymbolicArray final : public SymbolicValue {
     void assign(const SymbolicValue* other) override;
     bool merge(const SymbolicValue* other) override;
     bool equals(const SymbolicValue* other) const override;
+    size_t hash() const override;
     bool hasUninitializedParts() const override;
+    void setOwner(unsigned token) override;
 };
 
 // Represents any element from a stack
@@ -490,7 +572,9 @@ class SymbolicTuple final : public SymbolicValue {
     { values.push_back(value); }
     bool merge(const SymbolicValue* other) override;
     bool equals(const SymbolicValue* other) const override;
+    size_t hash() const override;
     bool hasUninitializedParts() const override;
+    void setOwner(unsigned token) override;
 };
 
 // Some extern value of an unknown type
@@ -545,6 +629,7 @@ class SymbolicPacketIn final : public SymbolicExtern {
     { minimumStreamOffset += width; }
     bool merge(const SymbolicValue* other) override;
     bool equals(const SymbolicValue* other) const override;
+    size_t hash() const override;
 };
 
 }  // namespace P4
@@ -111,29 +111,35 @@ class DoLocalCopyPropagation::RewriteTableKeys : public Transform {
 void DoLocalCopyPropagation::flow_merge(Visitor &a_) {
     auto &a = dynamic_cast<DoLocalCopyPropagation &>(a_);
     BUG_CHECK(working == a.working, "inconsitent DoLocalCopyPropagation state on merge");
-    for (auto &var : available) {
-        if (auto merge = ::getref(a.available, var.first)) {
-            if (merge->val != var.second.val)
-                var.second.val = nullptr;
+    available.merge(a.available, [](VarInfo &var, const VarInfo *merge) {
+        if (merge) {
+            if (merge->val != var.val)
+                var.val = nullptr;
             if (merge->live)
-                var.second.live = true;
+                var.live = true;
         } else {
-            var.second.val = nullptr; } }
+            var.val = nullptr; } });
     need_key_rewrite |= a.need_key_rewrite;
 }
 
 void DoLocalCopyPropagation::dropValuesUsing(cstring name) {
     LOG6("dropValuesUsing(" << name << ")");
-    for (auto &var : available) {
-        LOG7("  checking " << var.first << " = " << var.second.val);
-        if (var.first == name) {
-            LOG4("   dropping " << (var.second.val ? "" : "(nop) ") << name <<
+    available.modify_all([name](cstring var, VarInfo &info) {
+        LOG7("  checking " << var << " = " << info.val);
+        if (var == name) {
+            LOG4("   dropping " << (info.val ? "" : "(nop) ") << name <<
                  " as it is being assigned to");
-            var.second.val = nullptr;
-        } else if (var.second.val && exprUses(var.second.val, name)) {
-            LOG4("   dropping " << (var.second.val ? "" : "(nop) ") << var.first <<
+            info.val = nullptr;
+        } else if (info.val && exprUses(info.val, name)) {
+            LOG4("   dropping " << (info.val ? "" : "(nop) ") << var <<
                  " as it uses " << name);
-            var.second.val = nullptr; } }
+            info.val = nullptr; } });
+}
+
+void DoLocalCopyPropagation::markLive(cstring name) {
+    // only write when needed so unchanged entries stay shared with other flows
+    if (!available.getref(name)->live)
+        available[name].live = true;
 }
 
 void DoLocalCopyPropagation::visit_local_decl(const IR::Declaration_Variable *var) {
@@ -171,9 +177,9 @@ const IR::Expression *DoLocalCopyPropagation::postorder(IR::PathExpression *path
              * read, but we can't dead-code eliminate it without eliminating the entire
              * call, so we mark it as live.  Unfortunate as we then won't dead-code
              * remove other assignmnents. */
-            if (auto var = ::getref(available, path->path->name)) {
+            if (available.count(path->path->name)) {
                 LOG4("  using " << path->path->name << " in read-write");
-                var->live = true; }
+                markLive(path->path->name); }
             if (inferForFunc)
                 inferForFunc->reads.insert(path->path->name); }
         return path; }
@@ -183,7 +189,7 @@ const IR::Expression *DoLocalCopyPropagation::postorder(IR::PathExpression *path
             return var->val;
         } else {
             LOG4("  using " << path->path->name << " with no propagated value");
-            var->live = true; } }
+            markLive(path->path->name); } }
     if (inferForFunc)
         inferForFunc->reads.insert(path->path->name);
     return path;
@@ -253,10 +259,10 @@ IR::MethodCallExpression *DoLocalCopyPropagation::postorder(IR::MethodCallExpres
             apply_function(&actions[fn->path->name]);
             return mc; } }
     LOG3("unknown method call " << mc->method << " clears all nonlocal saved values");
-    for (auto &var : Values(available)) {
+    available.modify_all([](cstring, VarInfo &var) {
         if (!var.local) {
             var.val = nullptr;
-            var.live = true; } }
+            var.live = true; } });
     return mc;
 }
 
@@ -340,8 +346,8 @@ void DoLocalCopyPropagation::apply_function(DoLocalCopyPropagation::FuncInfo *ac
     for (auto write : act->writes)
         dropValuesUsing(write);
     for (auto read : act->reads)
-        if (auto var = ::getref(available, read))
-            var->live = true;
+        if (available.count(read))
+            markLive(read);
 }
 
 void DoLocalCopyPropagation::apply_table(DoLocalCopyPropagation::TableInfo *tbl) {
@@ -354,7 +360,7 @@ void DoLocalCopyPropagation::apply_table(DoLocalCopyPropagation::TableInfo *tbl)
                     /* FIXME -- need deep expr comparison here, not shallow */
                     LOG3("  different values used in different applies for key " << key);
                     tbl->key_remap.erase(key);
-                    var->live = true;
+                    markLive(key);
                 } else {
                     LOG3("  will propagate value into table key " << key << ": " << var->val);
                     tbl->key_remap.emplace(key, var->val);
@@ -363,7 +369,7 @@ void DoLocalCopyPropagation::apply_table(DoLocalCopyPropagation::TableInfo *tbl)
                 tbl->key_remap.erase(key);
                 LOG4("  table using " << key << " with " <<
                      (var->val ? "value to complex for key" : "no propagated value"));
-                var->live = true; } } }
+                markLive(key); } } }
     for (auto action : tbl->actions)
         apply_function(&actions[action]);
 }
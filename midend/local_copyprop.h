@@ -18,6 +18,7 @@ limitations under the License.
 #define MIDEND_LOCAL_COPYPROP_H_
 
 #include "ir/ir.h"
+#include "lib/persistent_map.h"
 #include "frontends/p4/typeChecking/typeChecker.h"
 #include "frontends/common/resolveReferences/referenceMap.h"
 
@@ -39,6 +40,8 @@ class DoLocalCopyPropagation : public ControlFlowVisitor, Transform, P4WriteCont
         bool                    local = false;
         bool                    live = false;
         const IR::Expression    *val = nullptr;
+        bool operator==(const VarInfo &a) const {
+            return local == a.local && live == a.live && val == a.val; }
     };
     struct TableInfo {
         std::set<cstring>       keyreads, actions;
@@ -48,7 +51,8 @@ class DoLocalCopyPropagation : public ControlFlowVisitor, Transform, P4WriteCont
     struct FuncInfo {
         std::set<cstring>       reads, writes;
     };
-    std::map<cstring, VarInfo>          available;
+    /* cloned at every branch of the control flow, so the copies share their contents */
+    persistent_map<cstring, VarInfo>    available;
     std::map<cstring, TableInfo>        &tables;
     std::map<cstring, FuncInfo>         &actions;
     std::map<cstring, FuncInfo>         &methods;
@@ -58,6 +62,7 @@ class DoLocalCopyPropagation : public ControlFlowVisitor, Transform, P4WriteCont
     DoLocalCopyPropagation *clone() const override { return new DoLocalCopyPropagation(*this); }
     void flow_merge(Visitor &) override;
     void dropValuesUsing(cstring);
+    void markLive(cstring);
 
     void visit_local_decl(const IR::Declaration_Variable *);
     const IR::Node *postorder(IR::Declaration_Variable *) override;
@@ -90,7 +95,7 @@ class LocalCopyPropagation : public PassManager {
  public:
     LocalCopyPropagation(ReferenceMap* refMap, TypeMap* typeMap) {
         passes.push_back(new TypeChecking(refMap, typeMap, true));
-        passes.push_back(new DoLocalCopyPropagation);
+        passes.push_back(new ParallelContainers([]() { return new DoLocalCopyPropagation; }));
         setName("LocalCopyPropagation");
     }
 };
@@ -1,4 +1,9 @@
 #include "parserUnroll.h"
+
+#include <boost/functional/hash.hpp>
+#include <chrono>
+
+#include "lib/flat_hash.h"
 #include "lib/stringify.h"
 
 namespace P4 {
@@ -50,6 +55,13 @@ class ParserSymbolicInterpreter {
     SymbolicValueFactory* factory;
     ParserInfo*         synthesizedParser;  // output produced
     bool                unroll;
+    ParserUnrollLimits  limits;
+
+    // States already evaluated, indexed by original state and the hash of
+    // the values before the state.
+    typedef std::pair<const IR::ParserState*, size_t> VisitKey;
+    flat_hash_map<VisitKey, std::vector<const ParserStateInfo*>,
+                  boost::hash<VisitKey>> visited;
 
     ValueMap* initializeVariables() {
         ValueMap* result = new ValueMap();
@@ -60,7 +72,7 @@ class ParserSymbolicInterpreter {
             bool initialized = p->direction == IR::Direction::In ||
                     p->direction == IR::Direction::InOut;
             auto value = factory->create(type, !initialized);
-            result->set(p, value);
+            result->setOwned(p, value);
         }
         for (auto d : *parser->parserLocals) {
             auto type = typeMap->getType(d);
@@ -74,14 +86,17 @@ class ParserSymbolicInterpreter {
                     value = ev.evaluate(dv->initializer, false);
             }
 
-            if (value == nullptr)
+            if (value == nullptr) {
                 value = factory->create(type, true);
+                if (value != nullptr)
+                    result->setOwned(d, value);
+                continue;
+            }
             if (value->is<SymbolicError>()) {
                 ::error("%1%: %2%", d, value->to<SymbolicError>()->message());
                 return nullptr;
             }
-            if (value != nullptr)
-                result->set(d, value);
+            result->set(d, value);
         }
         return result;
     }
@@ -92,9 +107,7 @@ class ParserSymbolicInterpreter {
             stateName == IR::ParserState::reject)
             return nullptr;
         auto state = structure->get(stateName);
-        auto pi = new ParserStateInfo(stateName, parser, state, predecessor, values->clone());
-        synthesizedParser->add(pi);
-        return pi;
+        return new ParserStateInfo(stateName, parser, state, predecessor, values->clone());
     }
 
     static void stateChain(const ParserStateInfo* state, std::stringstream& stream) {
@@ -262,7 +275,7 @@ class ParserSymbolicInterpreter {
                 auto prevPackets = crt->before->filter(filter);
                 if (packets->equals(prevPackets)) {
                     bool conservative = false;
-                    for (auto p : state->before->map) {
+                    for (auto p : packets->map) {
                         auto pkt = p.second->to<SymbolicPacketIn>();
                         if (pkt->isConservative()) {
                             conservative = true;
@@ -305,17 +318,30 @@ class ParserSymbolicInterpreter {
         return result;
     }
 
+    // True if the same original state was already evaluated starting from
+    // the same values; it would produce the same successors.
+    bool alreadyVisited(const ParserStateInfo* state) {
+        auto& same = visited[VisitKey(state->state, state->before->hash())];
+        for (auto s : same)
+            if (s->before->equals(state->before))
+                return true;
+        same.push_back(state);
+        return false;
+    }
+
  public:
     ParserSymbolicInterpreter(ParserStructure* structure, ReferenceMap* refMap,
-                              TypeMap* typeMap, bool unroll)
+                              TypeMap* typeMap, bool unroll, const ParserUnrollLimits& limits)
             : structure(structure), refMap(refMap), typeMap(typeMap),
-              synthesizedParser(nullptr), unroll(unroll) {
+              synthesizedParser(nullptr), unroll(unroll), limits(limits) {
         CHECK_NULL(structure); CHECK_NULL(refMap); CHECK_NULL(typeMap);
         factory = new SymbolicValueFactory(typeMap);
         parser = structure->parser;
     }
 
+    // Returns nullptr if the evaluation exceeds the limits
     ParserInfo* run() {
+        auto startTime = std::chrono::steady_clock::now();
         synthesizedParser = new ParserInfo();
         auto initMap = initializeVariables();
         if (initMap == nullptr)
@@ -324,15 +350,33 @@ class ParserSymbolicInterpreter {
         auto startInfo = newStateInfo(nullptr, structure->start->name.name, initMap);
         std::vector<ParserStateInfo*> toRun;  // worklist
         toRun.push_back(startInfo);
+        unsigned evaluated = 0;
 
         while (!toRun.empty()) {
             auto stateInfo = toRun.back();
             toRun.pop_back();
             LOG1("Symbolic evaluation of " << stateChain(stateInfo));
             bool infLoop = checkLoops(stateInfo);
+            if (!infLoop && alreadyVisited(stateInfo)) {
+                LOG1("Same values as a previous evaluation of " << stateInfo->state);
+                continue;
+            }
+            synthesizedParser->add(stateInfo);
             if (infLoop)
                 // don't evaluate successors anymore
                 continue;
+            if (++evaluated > limits.maxStates) {
+                ::warning("%1%: not unrolled, evaluation exceeds %2% states", parser,
+                          limits.maxStates);
+                return nullptr;
+            }
+            if (limits.maxMilliseconds != 0 &&
+                std::chrono::steady_clock::now() - startTime >
+                std::chrono::milliseconds(limits.maxMilliseconds)) {
+                ::warning("%1%: not unrolled, evaluation exceeds %2% ms",
+                          parser, limits.maxMilliseconds);
+                return nullptr;
+            }
             auto nextStates = evaluateState(stateInfo);
             if (nextStates == nullptr) {
                 LOG1("No next states");
@@ -346,8 +390,9 @@ class ParserSymbolicInterpreter {
 };
 }  // namespace ParserStructureImpl
 
-void ParserStructure::analyze(ReferenceMap* refMap, TypeMap* typeMap, bool unroll) {
-    ParserStructureImpl::ParserSymbolicInterpreter psi(this, refMap, typeMap, unroll);
+void ParserStructure::analyze(ReferenceMap* refMap, TypeMap* typeMap, bool unroll,
+                              const ParserUnrollLimits& limits) {
+    ParserStructureImpl::ParserSymbolicInterpreter psi(this, refMap, typeMap, unroll, limits);
     result = psi.run();
 }
 
@@ -26,6 +26,15 @@ limitations under the License.
 
 namespace P4 {
 
+// Bounds on the symbolic evaluation of a parser.  When a bound is exceeded the
+// evaluation stops and the parser is left as it is, without unrolling.
+struct ParserUnrollLimits {
+    // maximum number of states evaluated
+    unsigned maxStates = 2000;
+    // maximum evaluation time in milliseconds; 0 is unlimited
+    unsigned maxMilliseconds = 0;
+};
+
 //////////////////////////////////////////////
 // The following are for a single parser
 
@@ -77,6 +86,7 @@ class ParserStructure {
  public:
     const IR::P4Parser*    parser;
     const IR::ParserState* start;
+    // nullptr if the evaluation exceeded its limits
     const ParserInfo*      result;
     void setParser(const IR::P4Parser* parser) {
         CHECK_NULL(parser);
@@ -91,7 +101,8 @@ class ParserStructure {
     void calls(const IR::ParserState* caller, const IR::ParserState* callee)
     { callGraph->calls(caller, callee); }
 
-    void analyze(ReferenceMap* refMap, TypeMap* typeMap, bool unroll);
+    void analyze(ReferenceMap* refMap, TypeMap* typeMap, bool unroll,
+                 const ParserUnrollLimits& limits);
 };
 
 class AnalyzeParser : public Inspector {
@@ -127,12 +138,13 @@ class ParserUnroller : public Transform {
 class ParserRewriter : public PassManager {
     ParserStructure  current;
  public:
-    ParserRewriter(ReferenceMap* refMap, TypeMap* typeMap, bool unroll) {
+    ParserRewriter(ReferenceMap* refMap, TypeMap* typeMap, bool unroll,
+                   const ParserUnrollLimits& limits) {
         CHECK_NULL(refMap); CHECK_NULL(typeMap);
         passes.push_back(new AnalyzeParser(refMap, &current));
         passes.push_back(new VisitFunctor (
-            [this, refMap, typeMap, unroll](const IR::Node* root) -> const IR::Node* {
-                current.analyze(refMap, typeMap, unroll);
+            [this, refMap, typeMap, unroll, limits](const IR::Node* root) -> const IR::Node* {
+                current.analyze(refMap, typeMap, unroll, limits);
                 return root;
             }));
 #if 0
@@ -144,7 +156,7 @@ class ParserRewriter : public PassManager {
         LOG1("Scanning " << node);
         BUG_CHECK(node->is<IR::P4Parser>(), "%1%: expected a parser", node);
         current.parser = node->to<IR::P4Parser>();
-        return Visitor::init_apply(node);
+        return PassManager::init_apply(node);
     }
 };
 
@@ -155,21 +167,24 @@ class RewriteAllParsers : public Transform {
     ReferenceMap* refMap;
     TypeMap*      typeMap;
     bool          unroll;
+    ParserUnrollLimits limits;
  public:
-    RewriteAllParsers(ReferenceMap* refMap, TypeMap* typeMap, bool unroll) :
-            refMap(refMap), typeMap(typeMap), unroll(unroll)
+    RewriteAllParsers(ReferenceMap* refMap, TypeMap* typeMap, bool unroll,
+                      ParserUnrollLimits limits = ParserUnrollLimits()) :
+            refMap(refMap), typeMap(typeMap), unroll(unroll), limits(limits)
     { CHECK_NULL(refMap); CHECK_NULL(typeMap); }
     const IR::Node* postorder(IR::P4Parser* parser) override {
-        ParserRewriter rewriter(refMap, typeMap, unroll);
+        ParserRewriter rewriter(refMap, typeMap, unroll, limits);
         return parser->apply(rewriter);
     }
 };
 
 class ParsersUnroll : public PassManager {
  public:
-    ParsersUnroll(bool unroll, ReferenceMap* refMap, TypeMap* typeMap) {
+    ParsersUnroll(bool unroll, ReferenceMap* refMap, TypeMap* typeMap,
+                  ParserUnrollLimits limits = ParserUnrollLimits()) {
         passes.push_back(new TypeChecking(refMap, typeMap));
-        passes.push_back(new RewriteAllParsers(refMap, typeMap, unroll));
+        passes.push_back(new RewriteAllParsers(refMap, typeMap, unroll, limits));
         setName("ParsersUnroll");
     }
 };
@@ -35,7 +35,8 @@ class RemoveLeftSlices : public PassManager {
  public:
     RemoveLeftSlices(ReferenceMap* refMap, TypeMap* typeMap) {
         passes.push_back(new P4::TypeChecking(refMap, typeMap));
-        passes.push_back(new DoRemoveLeftSlices(typeMap));
+        passes.push_back(new ParallelContainers([typeMap]() {
+            return new DoRemoveLeftSlices(typeMap); }));
         setName("RemoveLeftSlices");
     }
 };
@@ -0,0 +1,69 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "gtest/gtest.h"
+
+#include "ir/ir.h"
+#include "ir/pass_manager.h"
+
+namespace {
+// Remembers the program it was computed for
+class Analysis : public ProgramAnalysis {
+ public:
+    const IR::Node *program = nullptr;
+    bool validFor(const IR::Node *p) const override { return program == p; }
+    void revalidate(const IR::Node *p) override { program = p; }
+};
+
+class Compute : public Inspector, public AnalysisUsage {
+    Analysis *analysis;
+    void end_apply(const IR::Node *root) override { analysis->program = root; ++runs; }
+ public:
+    int runs = 0;
+    explicit Compute(Analysis *a) : analysis(a) { declareComputes(a); }
+};
+
+// Replaces constants by new ones, optionally keeping the analysis up to date
+class Renumber : public Transform, public AnalysisUsage {
+    const IR::Node *postorder(IR::Constant *c) override { return new IR::Constant(c->value); }
+ public:
+    Renumber(Analysis *a, bool preserve) {
+        if (preserve) declarePreserves(a); }
+};
+}  // namespace
+
+TEST(AnalysisUsage, SkipValid) {
+    const IR::Node *root = new IR::Add(new IR::Constant(1), new IR::Constant(2));
+    Analysis a;
+    Compute c1(&a), c2(&a);
+    root = root->apply(PassManager({ &c1, &c2 }));
+    EXPECT_EQ(c1.runs, 1);
+    EXPECT_EQ(c2.runs, 0);
+    EXPECT_TRUE(a.validFor(root));
+}
+
+TEST(AnalysisUsage, Preserve) {
+    const IR::Node *root = new IR::Add(new IR::Constant(1), new IR::Constant(2));
+    Analysis a;
+    Compute c1(&a), c2(&a), c3(&a);
+    Renumber keep(&a, true), lose(&a, false);
+    auto result = root->apply(PassManager({ &c1, &keep, &c2, &lose, &c3 }));
+    EXPECT_NE(result, root);
+    EXPECT_EQ(c1.runs, 1);
+    EXPECT_EQ(c2.runs, 0);
+    EXPECT_EQ(c3.runs, 1);
+    EXPECT_TRUE(a.validFor(result));
+}
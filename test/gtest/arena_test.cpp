@@ -0,0 +1,106 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "ir/ir.h"
+#include "lib/arena.h"
+#include "lib/gc.h"
+
+namespace {
+// Returns 0 if each ArenaScope allocates from the arena, and the canonical
+// types created in a scope survive the release of its memory
+int runArenaScopes() {
+    enable_arena_alloc();
+    if (arena_alloc_enabled())
+        return 1;
+    const IR::Type_Bits *type = nullptr;
+    for (int i = 0; i < 2; ++i) {
+        ArenaScope scope;
+        std::vector<int> data(1000);
+        type = IR::Type_Bits::get(77);
+        size_t reserved;
+        if (!arena_alloc_enabled() || gc_mem_inuse(&reserved) < sizeof(int) * data.size())
+            return 2;
+        { ArenaScope nested; }
+        if (!arena_alloc_enabled())
+            return 3; }
+    if (arena_alloc_enabled())
+        return 4;
+    return type == IR::Type_Bits::get(77) && type->size == 77 ? 0 : 5;
+}
+}  // namespace
+
+TEST(Arena, BumpAllocation) {
+    Arena arena;
+    char *a = static_cast<char *>(arena.allocate(10));
+    char *b = static_cast<char *>(arena.allocate(1));
+    ASSERT_NE(a, nullptr);
+    ASSERT_NE(b, nullptr);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(a) % Arena::alignment, 0U);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(b) % Arena::alignment, 0U);
+    EXPECT_EQ(b - a, static_cast<ptrdiff_t>(Arena::alignment));
+    EXPECT_EQ(arena.inuse(), 2 * Arena::alignment);
+    EXPECT_EQ(arena.reserved(), Arena::chunk_size);
+    memset(a, 'x', 10);
+    EXPECT_TRUE(arena.contains(a));
+    EXPECT_TRUE(arena.contains(b));
+
+    int local;
+    EXPECT_FALSE(arena.contains(&local));
+    EXPECT_FALSE(arena.deallocate(&local));
+}
+
+TEST(Arena, RollbackLastAllocation) {
+    Arena arena;
+    void *a = arena.allocate(64);
+    void *b = arena.allocate(64);
+    EXPECT_TRUE(arena.deallocate(a));   // not the last one; ignored
+    EXPECT_EQ(arena.inuse(), 128U);
+    EXPECT_TRUE(arena.deallocate(b));   // rolled back
+    EXPECT_EQ(arena.inuse(), 64U);
+    EXPECT_EQ(arena.allocate(32), b);
+}
+
+TEST(Arena, ChunksAndRelease) {
+    Arena arena;
+    void *big = arena.allocate(Arena::chunk_size);
+    EXPECT_TRUE(arena.contains(big));
+    EXPECT_EQ(arena.reserved(), Arena::chunk_size);
+
+    // fill several chunks with small objects
+    std::vector<void *> objs;
+    for (size_t i = 0; i < 3 * Arena::chunk_size / 1024; ++i)
+        objs.push_back(arena.allocate(1000));
+    for (auto *p : objs)
+        EXPECT_TRUE(arena.contains(p));
+    EXPECT_GE(arena.reserved(), 4 * Arena::chunk_size);
+
+    arena.release();
+    EXPECT_EQ(arena.inuse(), 0U);
+    EXPECT_EQ(arena.reserved(), 0U);
+    EXPECT_FALSE(arena.contains(big));
+    EXPECT_NE(arena.allocate(8), nullptr);
+}
+
+// enable_arena_alloc cannot be undone, so this runs in a child process
+TEST(Arena, Scope) {
+    EXPECT_EXIT(_exit(runArenaScopes()), ::testing::ExitedWithCode(0), "");
+}
@@ -0,0 +1,150 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <string.h>
+#include <fstream>
+#include <sstream>
+
+#include "gtest/gtest.h"
+
+#include "ir/ir.h"
+#include "test/gtest/helpers.h"
+
+namespace {
+template<class T>
+const T *binaryRoundTrip(const T *node, std::string *data = nullptr) {
+    std::stringstream bin;
+    BinaryGenerator(bin) << node;
+    if (data) *data = bin.str();
+    const T *rv = nullptr;
+    BinaryLoader(bin) >> rv;
+    return rv;
+}
+
+std::string toJson(const IR::Node *node) {
+    std::stringstream json;
+    JSONGenerator(json) << node;
+    return json.str();
+}
+}  // namespace
+
+TEST(BinaryIR, RoundTrip) {
+    auto big = new IR::Constant(mpz_class("-123456789012345678901234567890"));
+    auto vec = new IR::Vector<IR::Expression>();
+    vec->push_back(big);
+    vec->push_back(new IR::Constant(0));
+    vec->push_back(new IR::BoolLiteral(true));
+    vec->push_back(new IR::StringLiteral(cstring("some text")));
+    vec->push_back(static_cast<const IR::Expression *>(nullptr));
+    auto copy = binaryRoundTrip(vec);
+    ASSERT_TRUE(copy != nullptr);
+    EXPECT_EQ(toJson(vec), toJson(copy));
+    EXPECT_EQ(copy->at(0)->to<IR::Constant>()->value, big->value);
+    EXPECT_EQ(copy->at(0)->id, big->id);
+    EXPECT_TRUE(copy->at(4) == nullptr);
+}
+
+TEST(BinaryIR, SharingAndSourceInfo) {
+    Util::SourceInfo where(Util::SourcePosition(3, 4), Util::SourcePosition(5, 6));
+    auto path = new IR::PathExpression(where, new IR::Path(IR::ID(where, "x")));
+    auto add = new IR::Add(path, path);
+    std::string data;
+    const IR::Node *node = binaryRoundTrip(add, &data);
+    ASSERT_TRUE(node != nullptr);
+    auto copy = node->to<IR::Add>();
+    ASSERT_TRUE(copy != nullptr);
+    // the shared node is written once and loaded once
+    EXPECT_EQ(copy->left, copy->right);
+    EXPECT_EQ(copy->left->srcInfo.toDebugString(), where.toDebugString());
+    auto name = copy->left->to<IR::PathExpression>()->path->name;
+    EXPECT_EQ(name.srcInfo.toDebugString(), where.toDebugString());
+    EXPECT_EQ(copy->srcInfo.toDebugString(), add->srcInfo.toDebugString());
+
+    // loading from a buffer gives the same nodes
+    const IR::Node *other = nullptr;
+    BinaryLoader(data.data(), data.size()) >> other;
+    ASSERT_TRUE(other != nullptr);
+    EXPECT_EQ(toJson(node), toJson(other));
+}
+
+// Malformed input is reported as an error and nothing is loaded.  Each case
+// runs in a child process, which keeps the errors out of the other tests.
+TEST(BinaryIR, MalformedInput) {
+    std::string data;
+    binaryRoundTrip(new IR::Add(new IR::Constant(1), new IR::Constant(2)), &data);
+    auto errors = ::errorCount();
+    auto load = [errors](const std::string &text) {
+        const IR::Node *node = nullptr;
+        BinaryLoader(text.data(), text.size()) >> node;
+        exit(node == nullptr ? ::errorCount() - errors : 100); };
+
+    EXPECT_EXIT(load(data.substr(0, 3)), ::testing::ExitedWithCode(1),
+                "not binary IR");
+    EXPECT_EXIT(load(data.substr(0, data.size() - 1)), ::testing::ExitedWithCode(1),
+                "Malformed binary IR: truncated input");
+    std::string unknown = data;
+    auto name = unknown.find("Add");
+    ASSERT_NE(name, std::string::npos);
+    unknown[name] = 'X';
+    EXPECT_EXIT(load(unknown), ::testing::ExitedWithCode(1),
+                "Malformed binary IR: unknown node type");
+}
+
+// Size and time of the binary and JSON dumps of the IR of some programs.
+// Run from the top of the source tree with --gtest_also_run_disabled_tests
+TEST(BinaryIR, DISABLED_Benchmark) {
+    const char *files[] = {
+        "testdata/p4_16_samples/flowlet_switching-bmv2.p4",
+        "testdata/p4_16_samples/vss-example.p4",
+        "testdata/p4_14_samples/switch_20160512/switch.p4",
+    };
+    const int rounds = 10;
+    for (auto file : files) {
+        if (!std::ifstream(file).good()) {
+            std::cout << file << ": not found" << std::endl;
+            continue;
+        }
+        auto program = TestUtil::parseFile(
+            file, strstr(file, "p4_14") ? CompilerOptions::FrontendVersion::P4_14
+                                        : CompilerOptions::FrontendVersion::P4_16);
+        ASSERT_TRUE(program != nullptr);
+
+        std::string bin, json;
+        double start = TestUtil::currentTime();
+        for (int i = 0; i < rounds; ++i) {
+            std::stringstream out;
+            BinaryGenerator(out) << program;
+            bin = out.str(); }
+        double binWrite = TestUtil::currentTime();
+        for (int i = 0; i < rounds; ++i) {
+            const IR::Node *node = nullptr;
+            BinaryLoader(bin.data(), bin.size()) >> node; }
+        double binRead = TestUtil::currentTime();
+        for (int i = 0; i < rounds; ++i)
+            json = toJson(program);
+        double jsonWrite = TestUtil::currentTime();
+        for (int i = 0; i < rounds; ++i) {
+            std::stringstream in(json);
+            const IR::Node *node = nullptr;
+            JSONLoader(in) >> node; }
+        double jsonRead = TestUtil::currentTime();
+        std::cout << file << ": binary " << bin.size() << " bytes, write "
+                  << (binWrite - start) / rounds * 1e3 << " ms, read "
+                  << (binRead - binWrite) / rounds * 1e3 << " ms; JSON " << json.size()
+                  << " bytes, write " << (jsonWrite - binRead) / rounds * 1e3 << " ms, read "
+                  << (jsonRead - jsonWrite) / rounds * 1e3 << " ms" << std::endl;
+    }
+}
@@ -0,0 +1,62 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include "gtest/gtest.h"
+
+#include "lib/cstring.h"
+
+TEST(cstring, Interning) {
+    cstring a = "interned";
+    cstring b = std::string("interned");
+    cstring c("interned string");
+    EXPECT_EQ(a.c_str(), b.c_str());
+    EXPECT_EQ(a.size(), 8U);
+    EXPECT_EQ(a.hash(), b.hash());
+    EXPECT_TRUE(c.startsWith(a));
+    EXPECT_TRUE(c.endsWith("string"));
+    EXPECT_EQ(c.substr(0, 8).c_str(), a.c_str());
+    EXPECT_EQ(c.substr(9), "string");
+    EXPECT_EQ(cstring(std::string("nul\0byte", 8)).c_str(), cstring("nul").c_str());
+    EXPECT_EQ(cstring().size(), 0U);
+    EXPECT_EQ(cstring::empty.size(), 0U);
+}
+
+TEST(cstring, ConcurrentInterning) {
+    // Threads intern overlapping sets of strings; every thread must get the
+    // same pointer for the same string.  (No heap allocation in the threads,
+    // as the garbage collector may not know about them.)
+    static const char *result[4][10000];
+    const int threads = 4, strings = 10000;
+    std::thread workers[4];
+    for (int t = 0; t < threads; ++t) {
+        workers[t] = std::thread([t]() {
+            char buf[32];
+            for (int i = 0; i < strings; ++i) {
+                int n = (i * (t + 1)) % strings;
+                snprintf(buf, sizeof(buf), "concurrent_%d", n);
+                result[t][n] = cstring(buf).c_str(); } }); }
+    for (auto &w : workers)
+        w.join();
+    for (int i = 0; i < strings; ++i) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "concurrent_%d", i);
+        cstring s(buf);
+        for (int t = 0; t < threads; ++t) {
+            if (result[t][i]) EXPECT_EQ(result[t][i], s.c_str()); } }
+}
@@ -0,0 +1,180 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <iterator>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "ir/ir.h"
+#include "frontends/p4/def_use.h"
+
+using namespace P4;
+
+namespace {
+// Creates bit<8> storage locations; each instance has its own LocationSets
+class Locations {
+    TypeMap typeMap;
+    StorageFactory factory;
+
+ public:
+    Locations() : factory(&typeMap) {}
+    const BaseLocation *bit(cstring name)
+    { return factory.create(IR::Type_Bits::get(8), name)->to<BaseLocation>(); }
+};
+
+// A program point for a new empty statement
+ProgramPoint newStatement()
+{ return ProgramPoint(new IR::EmptyStatement()); }
+
+bool hasPoint(const ProgramPoints *points, const ProgramPoint &point) {
+    for (auto p : *points)
+        if (p == point)
+            return true;
+    return false;
+}
+}  // namespace
+
+TEST(Definitions, WritesKillPreviousDefinitions) {
+    DefinitionNumbering numbering;
+    Locations locations;
+    auto a = locations.bit("a");
+    auto b = locations.bit("b");
+    auto first = newStatement();
+    auto second = newStatement();
+
+    Definitions start(&numbering);
+    start.set(a, ProgramPoint::beforeStart);
+    start.set(b, ProgramPoint::beforeStart);
+    auto defs = start.writes(first, new LocationSet(a));
+    defs = defs->writes(second, new LocationSet(a));
+
+    auto ofA = defs->get(a);
+    EXPECT_EQ(ofA->size(), 1U);
+    EXPECT_TRUE(hasPoint(ofA, second));
+    EXPECT_TRUE(defs->get(b)->containsBeforeStart());
+    // start is not changed by the writes
+    EXPECT_TRUE(start.get(a)->containsBeforeStart());
+}
+
+TEST(Definitions, JoinIsUnion) {
+    DefinitionNumbering numbering;
+    Locations locations;
+    auto a = locations.bit("a");
+    auto b = locations.bit("b");
+    auto left = newStatement();
+    auto right = newStatement();
+
+    Definitions start(&numbering);
+    start.set(a, ProgramPoint::beforeStart);
+    start.set(b, ProgramPoint::beforeStart);
+    auto ifTrue = start.writes(left, new LocationSet(a));
+    auto ifFalse = start.writes(right, new LocationSet(a));
+    auto joined = ifTrue->join(ifFalse);
+
+    auto ofA = joined->get(a);
+    EXPECT_EQ(ofA->size(), 2U);
+    EXPECT_TRUE(hasPoint(ofA, left));
+    EXPECT_TRUE(hasPoint(ofA, right));
+    EXPECT_FALSE(ofA->containsBeforeStart());
+    EXPECT_EQ(joined->get(b)->size(), 1U);
+
+    // joining again does not change anything: this is the fixpoint test
+    // of the parser worklist
+    EXPECT_TRUE(*joined == *joined->join(ifTrue));
+    EXPECT_FALSE(*joined == *ifTrue);
+}
+
+TEST(Definitions, Remove) {
+    DefinitionNumbering numbering;
+    Locations locations;
+    auto a = locations.bit("a");
+    auto b = locations.bit("b");
+
+    Definitions defs(&numbering);
+    EXPECT_TRUE(defs.empty());
+    defs.set(a, newStatement());
+    defs.set(b, newStatement());
+    defs.remove(a);
+    EXPECT_FALSE(defs.empty());
+    EXPECT_EQ(defs.get(b)->size(), 1U);
+    defs.remove(b);
+    EXPECT_TRUE(defs.empty());
+}
+
+TEST(LocationSet, Interned) {
+    Locations locations;
+    auto a = locations.bit("a");
+    auto b = locations.bit("b");
+    auto setA = LocationSet::intern(new LocationSet(a));
+    auto setB = LocationSet::intern(new LocationSet(b));
+    EXPECT_EQ(setA, LocationSet::intern(new LocationSet(a)));
+    auto ab = setA->join(setB);
+    EXPECT_EQ(ab, setB->join(setA));
+    EXPECT_EQ(ab->join(setA), ab);
+    EXPECT_EQ(ab->canonicalize(), ab);
+    EXPECT_EQ(setA->join(LocationSet::empty), setA);
+}
+
+TEST(ProgramPoint, Interned) {
+    auto node = new IR::EmptyStatement();
+    ProgramPoint context(node);
+    ProgramPoint inner(context, node);
+    EXPECT_TRUE(ProgramPoint(node) == context);
+    EXPECT_TRUE(ProgramPoint(ProgramPoint(node), node) == inner);
+    EXPECT_FALSE(inner == context);
+    EXPECT_EQ(inner.last(), node);
+    EXPECT_TRUE(ProgramPoint().isBeforeStart());
+    EXPECT_TRUE(ProgramPoint() == ProgramPoint::beforeStart);
+}
+
+TEST(LocationSet, TablesPerFactory) {
+    Locations first, second;
+    auto a = first.bit("a");
+    auto setA = LocationSet::intern(new LocationSet(a));
+    auto otherA = LocationSet::intern(new LocationSet(second.bit("a")));
+    EXPECT_NE(otherA, setA);
+    EXPECT_EQ(otherA, otherA->join(LocationSet::empty));
+    EXPECT_EQ(setA, LocationSet::intern(new LocationSet(a)));
+    EXPECT_EQ(LocationSet::intern(new LocationSet()), LocationSet::empty);
+    EXPECT_EQ(LocationSet::empty->canonicalize(), LocationSet::empty);
+}
+
+TEST(LocationSet, Threads) {
+    const int count = 200;
+    auto node = new IR::EmptyStatement();
+    // each thread runs its own analysis, with its own factory
+    std::vector<size_t> sizes(4);
+    std::vector<ProgramPoint> points(sizes.size());
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < sizes.size(); ++t) {
+        threads.emplace_back([&, t]() {
+            Locations locations;
+            auto set = LocationSet::empty;
+            for (int i = 0; i < count; ++i) {
+                auto l = locations.bit(cstring("l") + std::to_string((i * 7 + t * 13) % count));
+                set = set->join(LocationSet::intern(new LocationSet(l)))->canonicalize();
+            }
+            sizes[t] = std::distance(set->begin(), set->end());
+            points[t] = ProgramPoint(ProgramPoint(node), node); });
+    }
+    for (auto &t : threads)
+        t.join();
+    for (size_t t = 0; t < sizes.size(); ++t) {
+        EXPECT_EQ(sizes[t], static_cast<size_t>(count));
+        EXPECT_TRUE(points[t] == points[0]); }
+}
@@ -0,0 +1,103 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <map>
+#include <random>
+
+#include "gtest/gtest.h"
+
+#include "ir/ir.h"
+#include "lib/flat_hash.h"
+#include "test/gtest/helpers.h"
+
+namespace {
+// @n distinct constants
+std::vector<const IR::Node *> constants(size_t n) {
+    std::vector<const IR::Node *> nodes;
+    for (size_t i = 0; i < n; ++i)
+        nodes.push_back(new IR::Constant(i));
+    return nodes;
+}
+
+// Inserts every node, then looks each one up @rounds times, in random order;
+// prints millions of operations per second
+template<class MAP>
+void measure(const char *name, const std::vector<const IR::Node *> &nodes, int rounds) {
+    std::vector<const IR::Node *> order(nodes);
+    std::shuffle(order.begin(), order.end(), std::mt19937(1));
+    MAP map;
+    double start = TestUtil::currentTime();
+    for (auto n : nodes)
+        map.emplace(n, n);
+    double inserted = TestUtil::currentTime();
+    size_t found = 0;
+    for (int r = 0; r < rounds; ++r)
+        for (auto n : order)
+            found += map.find(n)->second == n;
+    double done = TestUtil::currentTime();
+    EXPECT_EQ(found, nodes.size() * rounds);
+    std::cout << name << ": insert " << nodes.size() / (inserted - start) / 1e6
+              << " M/s, lookup " << found / (done - inserted) / 1e6 << " M/s" << std::endl;
+}
+}  // namespace
+
+TEST(FlatHash, SameAsMap) {
+    auto nodes = constants(1000);
+    std::map<const IR::Node *, int> expected;
+    flat_hash_map<const IR::Node *, int> map;
+    std::mt19937 random(42);
+    for (int i = 0; i < 20000; ++i) {
+        auto n = nodes[random() % nodes.size()];
+        switch (random() % 3) {
+        case 0:
+            expected[n] = i;
+            map[n] = i;
+            break;
+        case 1:
+            EXPECT_EQ(map.emplace(n, i).second, expected.emplace(n, i).second);
+            break;
+        case 2:
+            EXPECT_EQ(map.erase(n), expected.erase(n));
+            break; }
+        ASSERT_EQ(map.size(), expected.size()); }
+    for (auto n : nodes)
+        EXPECT_EQ(get(map, n, -1), expected.count(n) ? expected.at(n) : -1);
+    size_t seen = 0;
+    for (auto &e : map) {
+        EXPECT_EQ(e.second, expected.at(e.first));
+        ++seen; }
+    EXPECT_EQ(seen, expected.size());
+}
+
+TEST(FlatHash, Set) {
+    flat_hash_set<cstring> names;
+    EXPECT_TRUE(names.insert("a").second);
+    EXPECT_FALSE(names.insert("a").second);
+    EXPECT_TRUE(names.insert("b").second);
+    EXPECT_EQ(names.count("a"), 1U);
+    EXPECT_EQ(names.erase("a"), 1U);
+    EXPECT_EQ(names.count("a"), 0U);
+    EXPECT_EQ(cstring::make_unique(names, "b", '_'), "b_0");
+}
+
+// Lookup and insert throughput for the node maps used by TypeMap and
+// ReferenceMap, before (std::map) and after (flat_hash_map).
+// Run with --gtest_also_run_disabled_tests
+TEST(FlatHash, DISABLED_Benchmark) {
+    auto nodes = constants(1 << 20);
+    measure<std::map<const IR::Node *, const IR::Node *>>("std::map", nodes, 4);
+    measure<flat_hash_map<const IR::Node *, const IR::Node *>>("flat_hash_map", nodes, 4);
+}
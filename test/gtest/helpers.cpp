@@ -0,0 +1,52 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "test/gtest/helpers.h"
+
+#include <time.h>
+#include <fstream>
+
+#include "gtest/gtest.h"
+
+#include "frontends/common/parseInput.h"
+#include "frontends/p4/frontend.h"
+
+namespace TestUtil {
+
+double currentTime() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+const IR::P4Program *parseFile(const std::string &file,
+                               CompilerOptions::FrontendVersion version) {
+    CompilerOptions options;
+    options.langVersion = version;
+    options.file = file;
+    auto program = parseP4File(options);
+    if (program != nullptr)
+        program = P4::FrontEnd().run(options, program);
+    return program;
+}
+
+const IR::P4Program *parseSource(const std::string &source) {
+    std::string file = ::testing::TempDir() + "test.p4";
+    std::ofstream(file) << source;
+    return parseFile(file);
+}
+
+}  // namespace TestUtil
@@ -0,0 +1,42 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _TEST_GTEST_HELPERS_H_
+#define _TEST_GTEST_HELPERS_H_
+
+#include <string>
+
+#include "ir/ir.h"
+#include "frontends/common/options.h"
+
+/// Helpers shared by the gtest unit tests and benchmarks.
+namespace TestUtil {
+
+/// Seconds on a monotonic clock, for timing benchmarks
+double currentTime();
+
+/// Parses the program in @file and runs the front end on it;
+/// nullptr if either fails
+const IR::P4Program *parseFile(const std::string &file,
+                               CompilerOptions::FrontendVersion version =
+                                   CompilerOptions::FrontendVersion::P4_16);
+
+/// Same for the P4-16 program @source, written to a temporary file
+const IR::P4Program *parseSource(const std::string &source);
+
+}  // namespace TestUtil
+
+#endif /* _TEST_GTEST_HELPERS_H_ */
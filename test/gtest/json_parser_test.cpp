@@ -0,0 +1,80 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <sstream>
+
+#include "gtest/gtest.h"
+
+#include "ir/ir.h"
+
+TEST(JsonTape, Values) {
+    const char *text =
+        "{ \"a\" : [1, -2, 123456789012345678901234567890, true, false, null],\n"
+        "  \"b\" : { \"c\" : \"text\", \"d\" : [] },\n"
+        "  \"e\" : \"\" }";
+    JsonTape tape(text, strlen(text));
+    size_t root = tape.root();
+    ASSERT_TRUE(tape.is(root, JsonTape::Object));
+    EXPECT_EQ(tape.size(root), 3u);
+
+    size_t a = tape.find(root, "a");
+    ASSERT_TRUE(tape.is(a, JsonTape::Array));
+    EXPECT_EQ(tape.size(a), 6u);
+    size_t e = tape.first(a);
+    EXPECT_TRUE(tape.isInt(e));
+    EXPECT_EQ(tape.getInt(e), 1);
+    e = tape.next(e);
+    EXPECT_EQ(tape.getInt(e), -2);
+    e = tape.next(e);
+    EXPECT_FALSE(tape.isInt(e));
+    EXPECT_EQ(tape.getNumber(e), mpz_class("123456789012345678901234567890"));
+    e = tape.next(e);
+    EXPECT_TRUE(tape.getBool(e));
+    e = tape.next(e);
+    EXPECT_TRUE(tape.is(e, JsonTape::False));
+    e = tape.next(e);
+    EXPECT_TRUE(tape.is(e, JsonTape::Null));
+
+    // nested containers are skipped as a whole
+    size_t b = tape.next(a) + 1;  // after the key
+    EXPECT_TRUE(tape.is(b, JsonTape::Object));
+    EXPECT_EQ(b, tape.find(root, "b"));
+    EXPECT_EQ(tape.getString(tape.find(b, "c")), "text");
+    EXPECT_TRUE(tape.equals(tape.find(b, "c"), "text"));
+    EXPECT_EQ(tape.size(tape.find(b, "d")), 0u);
+    EXPECT_EQ(tape.getString(tape.find(root, "e")), "");
+    EXPECT_EQ(tape.find(root, "f"), JsonTape::none);
+    EXPECT_EQ(tape.find(a, "a"), JsonTape::none);
+}
+
+TEST(JsonTape, LoadIR) {
+    auto c = new IR::Constant(mpz_class("-98765432109876543210"));
+    auto add = new IR::Add(c, new IR::Constant(7));
+    std::stringstream json;
+    JSONGenerator(json) << add;
+    std::string text = json.str();
+
+    const IR::Node *node = nullptr;
+    JSONLoader(text.data(), text.size()) >> node;
+    ASSERT_TRUE(node != nullptr);
+    auto copy = node->to<IR::Add>();
+    ASSERT_TRUE(copy != nullptr);
+    EXPECT_EQ(copy->left->to<IR::Constant>()->value, c->value);
+    EXPECT_EQ(copy->right->to<IR::Constant>()->value, 7);
+    std::stringstream again;
+    JSONGenerator(again) << node;
+    EXPECT_EQ(again.str(), text);
+}
@@ -0,0 +1,53 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc. 
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "gtest/gtest.h"
+
+#include "ir/ir.h"
+
+TEST(IR, NodeKind) {
+    auto *t = IR::Type::Bits::get(8);
+    const IR::Node *c = new IR::Constant(t, 1);
+    const IR::Node *add = new IR::Add(new IR::Constant(t, 1), new IR::Constant(t, 2));
+
+    EXPECT_TRUE(c->is<IR::Node>());
+    EXPECT_TRUE(c->is<IR::Expression>());
+    EXPECT_TRUE(c->is<IR::Literal>());
+    EXPECT_TRUE(c->is<IR::Constant>());
+    EXPECT_FALSE(c->is<IR::Operation_Binary>());
+    EXPECT_FALSE(c->is<IR::Type>());
+    EXPECT_EQ(add->to<IR::Operation_Binary>(), add);
+    EXPECT_EQ(add->to<IR::Operation>(), add);
+    EXPECT_EQ(add->to<IR::Sub>(), nullptr);
+    EXPECT_TRUE(t->is<IR::Type_Base>());
+    EXPECT_FALSE(t->is<IR::Expression>());
+
+    // abstract classes are numbered as well
+    unsigned binary = IR::Operation_Binary::static_kind;
+    unsigned binaryEnd = IR::Operation_Binary::static_kind_end;
+    unsigned addKind = IR::Add::static_kind;
+    EXPECT_EQ(add->node_kind(), addKind);
+    EXPECT_LT(binary, add->node_kind());
+    EXPECT_LT(add->node_kind(), binaryEnd);
+
+    // interfaces and templates are checked with dynamic_cast
+    EXPECT_TRUE(c->is<IR::CompileTimeValue>());
+    EXPECT_FALSE(add->is<IR::CompileTimeValue>());
+    const IR::Node *vec = new IR::Vector<IR::Expression>();
+    EXPECT_TRUE(vec->is<IR::Vector<IR::Expression>>());
+    EXPECT_FALSE(vec->is<IR::Expression>());
+    EXPECT_FALSE(c->is<IR::Vector<IR::Expression>>());
+}
@@ -0,0 +1,54 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "gtest/gtest.h"
+
+#include "ir/ir.h"
+#include "lib/error.h"
+#include "test/gtest/helpers.h"
+
+namespace {
+const IR::Type_Error *errorDeclaration(const IR::P4Program *program) {
+    const IR::Type_Error *result = nullptr;
+    for (auto decl : *program->declarations) {
+        if (auto error = decl->to<IR::Type_Error>()) {
+            EXPECT_TRUE(result == nullptr);
+            result = error;
+        }
+    }
+    return result;
+}
+}  // namespace
+
+// Nothing declared by one program leaks into the next one parsed.
+TEST(P4_16_Parser, StartsFromCleanState) {
+    auto errors = ::errorCount();
+    auto first = TestUtil::parseSource("header T { bit<8> f; }\n"
+                                      "error { First }\n");
+    ASSERT_TRUE(first != nullptr);
+    EXPECT_EQ(errorDeclaration(first)->members->size(), 1u);
+
+    auto second = TestUtil::parseSource("error { Second }\n"
+                                       "const bit<8> T = 1;\n"
+                                       "control c() { apply { bit<8> x = T + 1; } }\n");
+    ASSERT_TRUE(second != nullptr);
+    EXPECT_EQ(::errorCount(), errors);
+    auto error = errorDeclaration(second);
+    ASSERT_TRUE(error != nullptr);
+    ASSERT_EQ(error->members->size(), 1u);
+    EXPECT_EQ(error->members->at(0)->name.name, "Second");
+    EXPECT_EQ(errorDeclaration(first)->members->size(), 1u);
+}
@@ -0,0 +1,197 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <unistd.h>
+
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "ir/ir.h"
+#include "ir/pass_manager.h"
+#include "lib/exceptions.h"
+#include "lib/gc.h"
+
+namespace {
+const int numControls = 40;
+
+// control c<i>() { apply { x = i; } }
+const IR::P4Control *makeControl(int i) {
+    cstring name = cstring("c") + std::to_string(i);
+    auto type = new IR::Type_Control(name, IR::Annotations::empty, new IR::TypeParameters(),
+                                     new IR::ParameterList());
+    auto body = new IR::IndexedVector<IR::StatOrDecl>;
+    body->push_back(new IR::AssignmentStatement(new IR::PathExpression("x"),
+                                                new IR::Constant(i)));
+    return new IR::P4Control(name, type, new IR::ParameterList(),
+                             new IR::IndexedVector<IR::Declaration>,
+                             new IR::BlockStatement(IR::Annotations::empty, body));
+}
+
+const IR::P4Program *makeProgram() {
+    auto decls = new IR::IndexedVector<IR::Node>;
+    decls->push_back(new IR::Type_Error("error", new IR::IndexedVector<IR::Declaration_ID>));
+    for (int i = 0; i < numControls; ++i)
+        decls->push_back(makeControl(i));
+    return new IR::P4Program(decls);
+}
+
+int assignedValue(const IR::Node *control) {
+    auto stat = control->to<IR::P4Control>()->body->components->at(0);
+    return stat->to<IR::AssignmentStatement>()->right->to<IR::Constant>()->asInt();
+}
+
+// Adds @inc to every assigned constant; throws on @fail
+class Bump : public Transform {
+    int inc, fail;
+    const IR::Node *postorder(IR::AssignmentStatement *as) override {
+        auto value = as->right->to<IR::Constant>()->asInt();
+        if (value == fail)
+            BUG("failing on %1%", value);
+        if (inc)
+            as->right = new IR::Constant(value + inc);
+        return as; }
+
+ public:
+    explicit Bump(int inc, int fail = -1) : inc(inc), fail(fail) {}
+};
+
+const int numLocals = 64;
+
+// Adds locals that allocate declaration ids and canonical bit types
+class AddLocals : public Transform {
+    const IR::Node *postorder(IR::P4Control *control) override {
+        auto locals = control->controlLocals->clone();
+        for (int k = 0; k < numLocals; ++k) {
+            cstring name = cstring("v") + std::to_string(k);
+            locals->push_back(new IR::Declaration_Variable(
+                name, IR::Annotations::empty, IR::Type_Bits::get(k % 32 + 1),
+                new IR::Constant(new IR::Type_InfInt(), k))); }
+        auto type = new IR::Type_Typedef("t", IR::Annotations::empty, IR::Type_Bits::get(8));
+        locals->push_back(new IR::Declaration_Variable("t", IR::Annotations::empty, type,
+                                                       new IR::This()));
+        control->controlLocals = locals;
+        return control; }
+};
+
+// Records the threads that run it
+class RecordThreads : public Inspector {
+    static std::mutex lock;
+    bool preorder(const IR::P4Control *) override {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        std::lock_guard<std::mutex> acquire(lock);
+        threads.insert(std::this_thread::get_id());
+        return false; }
+
+ public:
+    static std::set<std::thread::id> threads;
+};
+std::mutex RecordThreads::lock;
+std::set<std::thread::id> RecordThreads::threads;
+
+// Returns 0 if the containers were processed by several threads, with the
+// same result as the sequential pass
+int runThreadsWithArena() {
+    enable_arena_alloc();
+    ArenaScope arena;
+    ParallelContainers::threads = 4;
+    PassManager passes = {
+        new ParallelContainers([]() { return new RecordThreads; }),
+        new ParallelContainers([]() { return new Bump(100); }),
+    };
+    auto result = makeProgram()->apply(passes);
+    for (int i = 0; i < numControls; ++i)
+        if (assignedValue(result->declarations->at(i + 1)) != i + 100)
+            return 1;
+    return RecordThreads::threads.size() > 1 ? 0 : 2;
+}
+
+class ParallelContainersTest : public ::testing::Test {
+    unsigned saved;
+ protected:
+    void SetUp() override { saved = ParallelContainers::threads; }
+    void TearDown() override { ParallelContainers::threads = saved; }
+};
+}  // namespace
+
+TEST_F(ParallelContainersTest, SameAsSequential) {
+    auto program = makeProgram();
+    ParallelContainers pass([]() { return new Bump(100); });
+    ParallelContainers::threads = 1;
+    auto seq = program->apply(pass);
+    ParallelContainers::threads = 4;
+    auto par = program->apply(pass);
+
+    ASSERT_NE(par, program);
+    ASSERT_EQ(par->declarations->size(), program->declarations->size());
+    EXPECT_EQ(par->declarations->at(0), program->declarations->at(0));
+    for (int i = 0; i < numControls; ++i) {
+        EXPECT_EQ(assignedValue(par->declarations->at(i + 1)), i + 100);
+        EXPECT_EQ(assignedValue(seq->declarations->at(i + 1)), i + 100); }
+    EXPECT_NE(par->getDeclByName("c7"), nullptr);
+}
+
+TEST_F(ParallelContainersTest, Unchanged) {
+    auto program = makeProgram();
+    ParallelContainers::threads = 4;
+    EXPECT_EQ(program->apply(ParallelContainers([]() { return new Bump(0); })), program);
+}
+
+TEST_F(ParallelContainersTest, Failure) {
+    auto program = makeProgram();
+    ParallelContainers::threads = 4;
+    EXPECT_THROW(program->apply(ParallelContainers([]() { return new Bump(1, 17); })),
+                 Util::CompilerBug);
+}
+
+TEST_F(ParallelContainersTest, AllocatesSharedState) {
+    auto program = makeProgram();
+    ParallelContainers::threads = 4;
+    auto result = program->apply(ParallelContainers([]() { return new AddLocals; }));
+
+    std::set<int> declIds, typeIds, intIds, thisIds;
+    for (int i = 0; i < numControls; ++i) {
+        auto control = result->declarations->at(i + 1)->to<IR::P4Control>();
+        ASSERT_EQ(control->controlLocals->size(), size_t(numLocals + 1));
+        for (int k = 0; k < numLocals; ++k) {
+            auto var = control->controlLocals->at(k)->to<IR::Declaration_Variable>();
+            declIds.insert(var->declid);
+            intIds.insert(var->initializer->type->to<IR::Type_InfInt>()->declid);
+            EXPECT_EQ(var->type, IR::Type_Bits::get(k % 32 + 1)); }
+        auto last = control->controlLocals->at(numLocals)->to<IR::Declaration_Variable>();
+        declIds.insert(last->declid);
+        typeIds.insert(last->type->to<IR::Type_Typedef>()->declid);
+        thisIds.insert(last->initializer->to<IR::This>()->id); }
+    EXPECT_EQ(declIds.size(), size_t(numControls * (numLocals + 1)));
+    EXPECT_EQ(intIds.size(), size_t(numControls * numLocals));
+    EXPECT_EQ(typeIds.size(), size_t(numControls));
+    EXPECT_EQ(thisIds.size(), size_t(numControls));
+}
+
+TEST_F(ParallelContainersTest, SequentialByDefault) {
+    EXPECT_EQ(ParallelContainers::threads, 1U);
+}
+
+// The other tests fall back to a sequential run when operator new is not
+// threadsafe (with the garbage collector); with the arena, the containers
+// must really be spread over the threads.  The arena cannot be turned off, so
+// this runs in a child process.
+TEST_F(ParallelContainersTest, ThreadsWithArena) {
+    EXPECT_EXIT(_exit(runThreadsWithArena()), ::testing::ExitedWithCode(0), "");
+}
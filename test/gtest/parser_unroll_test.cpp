@@ -0,0 +1,373 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "ir/ir.h"
+#include "lib/error.h"
+#include "lib/stringify.h"
+#include "midend/interpreter.h"
+#include "midend/parserUnroll.h"
+#include "test/gtest/helpers.h"
+
+using namespace P4;
+
+namespace {
+// A stack of @size headers of type header h { bit<8> a; }, with the types
+// of its components recorded in @typeMap
+const IR::Type_Stack *headerStackType(TypeMap *typeMap, int size) {
+    auto bits = IR::Type_Bits::get(8);
+    auto fields = new IR::IndexedVector<IR::StructField>();
+    fields->push_back(new IR::StructField(IR::ID("a"), IR::Annotations::empty, bits));
+    auto header = new IR::Type_Header(IR::ID("h"), fields);
+    auto stack = new IR::Type_Stack(header, new IR::Constant(size));
+    typeMap->setType(bits, new IR::Type_Type(bits));
+    typeMap->setType(header, new IR::Type_Type(header));
+    typeMap->setType(stack, new IR::Type_Type(stack));
+    return stack;
+}
+
+// A symbolic bit<8> value
+SymbolicInteger *bit8Value(int value)
+{ return new SymbolicInteger(new IR::Constant(IR::Type_Bits::get(8), value)); }
+
+// A parser with @stages selects whose two cases lead to the same next
+// state with the same values: there are 2^stages paths through it.
+const IR::P4Program *diamondParser(int stages) {
+    std::stringstream source;
+    source << "#include <core.p4>\n"
+           << "header h_t { bit<8> f; }\n"
+           << "struct headers { h_t[" << stages << "] h; }\n"
+           << "parser p(packet_in b, out headers hdr) {\n"
+           << "    state start { transition s0; }\n";
+    for (int i = 0; i < stages; ++i) {
+        source << "    state s" << i << " { b.extract(hdr.h[" << i << "]);\n"
+               << "        transition select(hdr.h[" << i << "].f) { "
+               << "0: l" << i << "; default: r" << i << "; } }\n";
+        cstring next = i + 1 < stages ? "s" + Util::toString(i + 1) : cstring("accept");
+        source << "    state l" << i << " { transition " << next << "; }\n"
+               << "    state r" << i << " { transition " << next << "; }\n";
+    }
+    source << "}\n"
+           << "parser proto(packet_in b, out headers hdr);\n"
+           << "package top(proto p);\n"
+           << "top(p()) main;\n";
+    return TestUtil::parseSource(source.str());
+}
+
+// A parser with 'headers' headers besides a stack of 'size' headers
+// extracted by a loop.
+const IR::P4Program *makeStackLoopParser(int headers, int size) {
+    std::stringstream source;
+    source << "#include <core.p4>\n"
+           << "header h_t { bit<8> f; }\n"
+           << "struct headers { h_t[" << size << "] s;\n";
+    for (int i = 0; i < headers; ++i)
+        source << "    h_t h" << i << ";\n";
+    source << "}\n"
+           << "parser p(packet_in b, out headers hdr) {\n"
+           << "    state start { b.extract(hdr.h0); transition loop; }\n"
+           << "    state loop { b.extract(hdr.s.next);\n"
+           << "        transition select(hdr.s.last.f) { 0: accept; default: loop; } }\n"
+           << "}\n"
+           << "parser proto(packet_in b, out headers hdr);\n"
+           << "package top(proto p);\n"
+           << "top(p()) main;\n";
+    return TestUtil::parseSource(source.str());
+}
+}  // namespace
+
+TEST(ParserUnroll, RunsOnParser) {
+    auto program = TestUtil::parseSource(
+        "#include <core.p4>\n"
+        "parser p() { state start { transition accept; } }\n"
+        "parser proto();\n"
+        "package top(proto p);\n"
+        "top(p()) main;\n");
+    ASSERT_TRUE(program != nullptr);
+    ASSERT_EQ(::errorCount(), 0U);
+
+    ReferenceMap refMap;
+    TypeMap typeMap;
+    program = program->apply(ParsersUnroll(true, &refMap, &typeMap));
+    EXPECT_TRUE(program != nullptr);
+    EXPECT_EQ(::errorCount(), 0U);
+}
+
+TEST(ParserUnroll, EvaluatesMethodResults) {
+    auto program = TestUtil::parseSource(
+        "#include <core.p4>\n"
+        "header h_t { bit<8> f; }\n"
+        "struct headers { h_t h; }\n"
+        "parser p(packet_in b, out headers hdr) {\n"
+        "    state start { transition select(b.lookahead<bit<8>>()) {\n"
+        "        0: accept; default: next; } }\n"
+        "    state next { b.extract(hdr.h); transition accept; }\n"
+        "}\n"
+        "parser proto(packet_in b, out headers hdr);\n"
+        "package top(proto p);\n"
+        "top(p()) main;\n");
+    ASSERT_TRUE(program != nullptr);
+    ASSERT_EQ(::errorCount(), 0U);
+
+    ReferenceMap refMap;
+    TypeMap typeMap;
+    program = program->apply(ParsersUnroll(true, &refMap, &typeMap));
+    EXPECT_TRUE(program != nullptr);
+    EXPECT_EQ(::errorCount(), 0U);
+}
+
+TEST(SymbolicValue, CreateFromType) {
+    TypeMap typeMap;
+    SymbolicValueFactory factory(&typeMap);
+    auto type = headerStackType(&typeMap, 2);
+    auto stack = factory.create(type, false);
+    ASSERT_TRUE(stack->is<SymbolicArray>());
+    EXPECT_TRUE(stack->to<SymbolicArray>()->get(nullptr, 1)->is<SymbolicHeader>());
+    EXPECT_TRUE(factory.isFixedWidth(type));
+    EXPECT_EQ(factory.getWidth(type), 16u);
+}
+
+TEST(ParserUnroll, EvaluatesStackElements) {
+    auto program = TestUtil::parseSource(
+        "#include <core.p4>\n"
+        "header h_t { bit<8> f; }\n"
+        "struct headers { h_t[2] h; }\n"
+        "parser p(packet_in b, out headers hdr) {\n"
+        "    state start { b.extract(hdr.h[0]);\n"
+        "        transition select(hdr.h[0].f) { 0: accept; default: next; } }\n"
+        "    state next { b.extract(hdr.h[1]); transition accept; }\n"
+        "}\n"
+        "parser proto(packet_in b, out headers hdr);\n"
+        "package top(proto p);\n"
+        "top(p()) main;\n");
+    ASSERT_TRUE(program != nullptr);
+    ASSERT_EQ(::errorCount(), 0U);
+
+    ReferenceMap refMap;
+    TypeMap typeMap;
+    auto warnings = ErrorReporter::instance.getWarningCount();
+    program = program->apply(ParsersUnroll(true, &refMap, &typeMap));
+    EXPECT_TRUE(program != nullptr);
+    EXPECT_EQ(::errorCount(), 0U);
+    EXPECT_EQ(ErrorReporter::instance.getWarningCount(), warnings);
+}
+
+TEST(SymbolicValue, ShiftInvalidatesVacatedSlots) {
+    TypeMap typeMap;
+    SymbolicValueFactory factory(&typeMap);
+    auto stack = factory.create(headerStackType(&typeMap, 2), false)->to<SymbolicArray>();
+    stack->get(nullptr, 0)->to<SymbolicHeader>()->setValid(true);
+
+    stack->shift(1);
+    EXPECT_FALSE(stack->get(nullptr, 0)->to<SymbolicHeader>()->valid->value);
+    EXPECT_TRUE(stack->get(nullptr, 1)->to<SymbolicHeader>()->valid->value);
+    stack->shift(-1);
+    EXPECT_TRUE(stack->get(nullptr, 0)->to<SymbolicHeader>()->valid->value);
+    EXPECT_FALSE(stack->get(nullptr, 1)->to<SymbolicHeader>()->valid->value);
+}
+
+TEST(SymbolicValue, CloneIsIndependent) {
+    TypeMap typeMap;
+    SymbolicValueFactory factory(&typeMap);
+    auto stack = factory.create(headerStackType(&typeMap, 2), false)->to<SymbolicArray>();
+
+    auto copy = stack->clone()->to<SymbolicArray>();
+    auto element = stack->getOwned(nullptr, 1)->to<SymbolicHeader>();
+    element->setValid(true);
+    element->getOwned(nullptr, "a")->assign(bit8Value(5));
+
+    EXPECT_TRUE(stack->get(nullptr, 1)->to<SymbolicHeader>()->valid->value);
+    EXPECT_FALSE(copy->get(nullptr, 1)->to<SymbolicHeader>()->valid->value);
+    EXPECT_FALSE(copy->equals(stack));
+    EXPECT_TRUE(copy->get(nullptr, 0)->equals(stack->get(nullptr, 0)));
+
+    // changing the copy does not change the original either
+    auto other = copy->getOwned(nullptr, 1)->to<SymbolicHeader>();
+    other->setValid(true);
+    other->getOwned(nullptr, "a")->assign(bit8Value(5));
+    EXPECT_TRUE(copy->equals(stack));
+    other->getOwned(nullptr, "a")->assign(bit8Value(6));
+    EXPECT_FALSE(copy->equals(stack));
+    auto a = stack->get(nullptr, 1)->to<SymbolicHeader>()->get(nullptr, "a");
+    EXPECT_EQ(a->to<SymbolicInteger>()->constant->asInt(), 5);
+}
+
+// New values own their components: the first write does not copy them
+TEST(SymbolicValue, NewValuesAreWrittenInPlace) {
+    TypeMap typeMap;
+    SymbolicValueFactory factory(&typeMap);
+    auto type = headerStackType(&typeMap, 2);
+    auto stack = factory.create(type, false)->to<SymbolicArray>();
+    auto element = stack->getOwned(nullptr, 0)->to<SymbolicHeader>();
+    EXPECT_EQ(element, stack->get(nullptr, 0));
+    auto a = element->SymbolicStruct::getOwned(nullptr, "a");
+    EXPECT_EQ(a, element->SymbolicStruct::get(nullptr, "a"));
+
+    auto decl = new IR::Declaration_Variable(IR::ID("s"), IR::Annotations::empty, type, nullptr);
+    ValueMap map;
+    auto value = factory.create(type, false)->to<SymbolicArray>();
+    map.setOwned(decl, value);
+    EXPECT_EQ(map.getOwned(decl), value);
+    EXPECT_EQ(value->getOwned(nullptr, 1), value->get(nullptr, 1));
+
+    // after a clone neither value writes the shared components in place
+    auto copy = stack->clone()->to<SymbolicArray>();
+    EXPECT_NE(stack->getOwned(nullptr, 0), element);
+    EXPECT_NE(copy->getOwned(nullptr, 0), element);
+    EXPECT_EQ(copy->get(nullptr, 1), stack->get(nullptr, 1));
+}
+
+TEST(SymbolicValue, ValueMapCloneIsIndependent) {
+    TypeMap typeMap;
+    SymbolicValueFactory factory(&typeMap);
+    auto type = headerStackType(&typeMap, 2);
+    auto decl = new IR::Declaration_Variable(IR::ID("s"), IR::Annotations::empty, type, nullptr);
+    auto before = new ValueMap();
+    before->set(decl, factory.create(type, false));
+
+    auto after = before->clone();
+    auto stack = after->getOwned(decl)->to<SymbolicArray>();
+    stack->getOwned(nullptr, 0)->to<SymbolicHeader>()->setValid(true);
+    stack->shift(1);
+    EXPECT_TRUE(stack->get(nullptr, 1)->to<SymbolicHeader>()->valid->value);
+    EXPECT_FALSE(after->equals(before));
+    EXPECT_TRUE(before->clone()->equals(before));
+    // merging the state before into the state after changes it
+    EXPECT_TRUE(after->merge(before));
+    EXPECT_FALSE(after->merge(before));
+}
+
+// Clones share the values of the map; merging does not copy values that
+// are still shared or that do not change.
+TEST(SymbolicValue, ValueMapSharesValues) {
+    TypeMap typeMap;
+    SymbolicValueFactory factory(&typeMap);
+    auto type = headerStackType(&typeMap, 2);
+    auto before = new ValueMap();
+    std::vector<const IR::Declaration_Variable *> decls;
+    for (int i = 0; i < 8; ++i) {
+        decls.push_back(new IR::Declaration_Variable(
+            IR::ID(cstring("s") + std::to_string(i)), IR::Annotations::empty, type, nullptr));
+        before->set(decls.back(), factory.create(type, false)); }
+
+    auto after = before->clone();
+    for (auto d : decls)
+        EXPECT_EQ(after->get(d), before->get(d));
+    EXPECT_FALSE(after->merge(before));
+    for (auto d : decls)
+        EXPECT_EQ(after->get(d), before->get(d));
+
+    auto written = after->getOwned(decls[3]);
+    EXPECT_NE(written, before->get(decls[3]));
+    EXPECT_FALSE(after->merge(before));
+    EXPECT_EQ(after->get(decls[3]), written);
+    EXPECT_EQ(after->get(decls[4]), before->get(decls[4]));
+
+    written->to<SymbolicArray>()->getOwned(nullptr, 0)->to<SymbolicHeader>()->setValid(true);
+    auto original = before->get(decls[3]);
+    EXPECT_TRUE(before->merge(after));
+    EXPECT_NE(before->get(decls[3]), original);
+    EXPECT_EQ(before->get(decls[4]), after->get(decls[4]));
+}
+
+TEST(SymbolicValue, EqualValuesHaveEqualHashes) {
+    TypeMap typeMap;
+    SymbolicValueFactory factory(&typeMap);
+    auto stack = factory.create(headerStackType(&typeMap, 2), false)->to<SymbolicArray>();
+    auto copy = stack->clone()->to<SymbolicArray>();
+    EXPECT_EQ(stack->hash(), copy->hash());
+
+    // fields of invalid headers are not compared
+    stack->getOwned(nullptr, 0)->to<SymbolicHeader>()->
+            SymbolicStruct::getOwned(nullptr, "a")->assign(bit8Value(1));
+    EXPECT_TRUE(stack->equals(copy));
+    EXPECT_EQ(stack->hash(), copy->hash());
+
+    auto element = stack->getOwned(nullptr, 1)->to<SymbolicHeader>();
+    auto other = copy->getOwned(nullptr, 1)->to<SymbolicHeader>();
+    element->setValid(true);
+    other->setValid(true);
+    element->getOwned(nullptr, "a")->assign(bit8Value(5));
+    other->getOwned(nullptr, "a")->assign(bit8Value(5));
+    EXPECT_TRUE(stack->equals(copy));
+    EXPECT_EQ(stack->hash(), copy->hash());
+    other->getOwned(nullptr, "a")->assign(bit8Value(6));
+    EXPECT_FALSE(stack->equals(copy));
+    EXPECT_NE(stack->hash(), copy->hash());
+}
+
+TEST(ParserUnroll, EquivalentStatesAreMerged) {
+    auto program = diamondParser(20);
+    ASSERT_TRUE(program != nullptr);
+    ASSERT_EQ(::errorCount(), 0U);
+
+    ReferenceMap refMap;
+    TypeMap typeMap;
+    auto warnings = ErrorReporter::instance.getWarningCount();
+    // without merging there would be 2^20 paths to evaluate
+    program->apply(ParsersUnroll(true, &refMap, &typeMap));
+    EXPECT_EQ(ErrorReporter::instance.getWarningCount(), warnings);
+    EXPECT_EQ(::errorCount(), 0U);
+
+    ParserUnrollLimits limits;
+    limits.maxStates = 10;
+    program->apply(ParsersUnroll(true, &refMap, &typeMap, limits));
+    EXPECT_EQ(ErrorReporter::instance.getWarningCount(), warnings + 1);
+    EXPECT_EQ(::errorCount(), 0U);
+}
+
+// Time taken by the symbolic evaluation of parsers with header stacks.
+// Run from the top of the source tree with --gtest_also_run_disabled_tests
+TEST(ParserUnroll, DISABLED_Benchmark) {
+    const char *files[] = {
+        "testdata/p4_16_samples/stack.p4",
+        "testdata/p4_16_samples/stack-bmv2.p4",
+        "testdata/p4_16_samples/stack_complex-bmv2.p4",
+        "testdata/p4_16_samples/inline-stack-bmv2.p4",
+    };
+    std::vector<std::pair<std::string, const IR::P4Program *>> programs;
+    for (auto file : files) {
+        if (!std::ifstream(file).good()) {
+            std::cout << file << ": not found" << std::endl;
+            continue;
+        }
+        programs.emplace_back(file, TestUtil::parseFile(file));
+    }
+    programs.emplace_back("60 headers, 32-entry stack loop", makeStackLoopParser(60, 32));
+
+    const int rounds = 200;
+    for (auto &p : programs) {
+        auto program = p.second;
+        ASSERT_TRUE(program != nullptr);
+        ASSERT_EQ(::errorCount(), 0U);
+
+        ReferenceMap refMap;
+        TypeMap typeMap;
+        program = program->apply(ParsersUnroll(true, &refMap, &typeMap));
+        double start = TestUtil::currentTime();
+        for (int i = 0; i < rounds; ++i)
+            program->apply(RewriteAllParsers(&refMap, &typeMap, true));
+        double done = TestUtil::currentTime();
+        std::cout << p.first << ": " << (done - start) / rounds * 1e3 << " ms" << std::endl;
+    }
+}
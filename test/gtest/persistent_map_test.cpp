@@ -0,0 +1,153 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <map>
+#include <random>
+#include <sstream>
+
+#include "gtest/gtest.h"
+
+#include "ir/ir.h"
+#include "lib/persistent_map.h"
+#include "lib/stringify.h"
+#include "midend/local_copyprop.h"
+#include "test/gtest/helpers.h"
+
+namespace {
+template<class MAP>
+void expectSame(const persistent_map<int, int> &map, const MAP &expected) {
+    ASSERT_EQ(map.size(), expected.size());
+    auto it = expected.begin();
+    for (auto &e : map) {
+        EXPECT_EQ(e.first, it->first);
+        EXPECT_EQ(e.second, it->second);
+        ++it; }
+}
+
+// The reference for persistent_map::merge, with the merge function of
+// LocalCopyPropagation: values that differ are cleared
+void mergeInto(std::map<int, int> &map, const std::map<int, int> &other) {
+    for (auto &e : map)
+        if (!other.count(e.first) || other.at(e.first) != e.second)
+            e.second = 0;
+}
+
+void mergeValue(int &val, const int *other) {
+    if (!other || *other != val)
+        val = 0;
+}
+
+// A control with 'count' locals and as many if statements that each assign
+// one of them in each branch
+const IR::P4Program *makeCopyPropProgram(int count) {
+    std::stringstream source;
+    source << "#include <core.p4>\n"
+           << "header h_t { bit<32> f; bit<32> g; }\n"
+           << "control c(inout h_t h) {\n";
+    for (int i = 0; i < count; ++i)
+        source << "    bit<32> v" << i << " = " << i << ";\n";
+    source << "    apply {\n";
+    for (int i = 0; i < count; ++i)
+        source << "        if (h.f == " << i << ") { v" << i << " = v" << (i + 7) % count
+               << " + h.g; } else { v" << (i + 3) % count << " = h.g; }\n";
+    source << "        h.g = v0";
+    for (int i = 1; i < count; i += 5)
+        source << " + v" << i;
+    source << ";\n    } }\n"
+           << "control proto(inout h_t h);\n"
+           << "package top(proto p);\n"
+           << "top(c()) main;\n";
+    return TestUtil::parseSource(source.str());
+}
+}  // namespace
+
+TEST(PersistentMap, SameAsMap) {
+    std::map<int, int> expected;
+    persistent_map<int, int> map;
+    std::mt19937 random(42);
+    for (int i = 0; i < 20000; ++i) {
+        int key = random() % 1000;
+        if (random() % 2) {
+            expected[key] = i;
+            map[key] = i;
+        } else {
+            EXPECT_EQ(map.count(key), expected.count(key));
+            if (auto val = getref(map, key)) {
+                EXPECT_EQ(*val, expected.at(key)); } } }
+    expectSame(map, expected);
+    map.clear();
+    EXPECT_TRUE(map.empty());
+    EXPECT_TRUE(map.begin() == map.end());
+}
+
+TEST(PersistentMap, CopiesAreIndependent) {
+    persistent_map<int, int> map;
+    for (int i = 0; i < 100; ++i)
+        map[i] = i;
+    auto copy = map;
+    std::map<int, int> expected(copy.begin(), copy.end());
+    for (int i = 0; i < 100; i += 3)
+        map[i] = -i;
+    map[200] = 200;
+    expectSame(copy, expected);
+    copy[1] = 1000;
+    EXPECT_EQ(*getref(map, 1), 1);
+    EXPECT_EQ(*getref(map, 3), -3);
+    EXPECT_EQ(getref(copy, 200), nullptr);
+
+    map.modify_all([](int key, int &val) { if (key % 2) val = 0; });
+    EXPECT_EQ(*getref(map, 1), 0);
+    EXPECT_EQ(*getref(copy, 1), 1000);
+    EXPECT_EQ(*getref(copy, 3), 3);
+}
+
+TEST(PersistentMap, MergeSameAsMap) {
+    std::mt19937 random(7);
+    persistent_map<int, int> base;
+    for (int i = 0; i < 500; ++i)
+        base[random() % 1000] = i + 1;
+    for (int round = 0; round < 20; ++round) {
+        // two branches from the same state, the second one with a few new keys
+        auto left = base, right = base;
+        for (int i = 0; i < round * 5; ++i) {
+            left[random() % 1000] = random() % 4 + 1;
+            right[random() % (round % 2 ? 2000 : 1000)] = random() % 4 + 1; }
+        std::map<int, int> expected(left.begin(), left.end());
+        mergeInto(expected, std::map<int, int>(right.begin(), right.end()));
+        auto before = left;
+        left.merge(right, mergeValue);
+        expectSame(left, expected);
+        before.merge(before, mergeValue);
+        expectSame(before, std::map<int, int>(before.begin(), before.end()));
+        base = left; }
+}
+
+// Time taken by LocalCopyPropagation on a control with many locals and
+// branches, which copies and merges its state at each of them.
+// Run with --gtest_also_run_disabled_tests
+TEST(PersistentMap, DISABLED_CopyPropBenchmark) {
+    for (int count : { 400, 800, 1600 }) {
+        auto program = makeCopyPropProgram(count);
+        ASSERT_TRUE(program != nullptr);
+        ASSERT_EQ(::errorCount(), 0U);
+        P4::ReferenceMap refMap;
+        P4::TypeMap typeMap;
+        double start = TestUtil::currentTime();
+        program = program->apply(P4::LocalCopyPropagation(&refMap, &typeMap));
+        double done = TestUtil::currentTime();
+        ASSERT_TRUE(program != nullptr);
+        std::cout << count << " locals: " << (done - start) * 1e3 << " ms" << std::endl; }
+}
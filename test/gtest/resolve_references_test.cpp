@@ -0,0 +1,138 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "gtest/gtest.h"
+
+#include "ir/ir.h"
+#include "frontends/common/resolveReferences/resolveReferences.h"
+
+using namespace P4;
+
+namespace {
+const int numReaders = 8;
+
+const IR::Declaration_Constant *makeConstant(int value) {
+    return new IR::Declaration_Constant("K", IR::Annotations::empty, IR::Type_Bits::get(32),
+                                        new IR::Constant(value));
+}
+
+const IR::StatOrDecl *assign(cstring left, cstring right) {
+    return new IR::AssignmentStatement(new IR::PathExpression(left),
+                                       new IR::PathExpression(right));
+}
+
+// action a() { v = K; }
+const IR::P4Action *makeAction() {
+    auto body = new IR::IndexedVector<IR::StatOrDecl>;
+    body->push_back(assign("v", "K"));
+    return new IR::P4Action("a", IR::Annotations::empty, new IR::ParameterList(),
+                            new IR::BlockStatement(IR::Annotations::empty, body));
+}
+
+// control c<i>() { bit<32> v; <locals> apply { v = K; } }
+const IR::P4Control *makeReaderControl(int i, const IR::P4Action *action,
+                                        const IR::Declaration *local = nullptr) {
+    cstring name = cstring("c") + std::to_string(i);
+    auto type = new IR::Type_Control(name, IR::Annotations::empty, new IR::TypeParameters(),
+                                     new IR::ParameterList());
+    auto locals = new IR::IndexedVector<IR::Declaration>;
+    locals->push_back(new IR::Declaration_Variable("v", IR::Annotations::empty,
+                                                   IR::Type_Bits::get(32), nullptr));
+    if (local)
+        locals->push_back(local);
+    locals->push_back(action);
+    auto body = new IR::IndexedVector<IR::StatOrDecl>;
+    body->push_back(assign("v", "K"));
+    return new IR::P4Control(name, type, new IR::ParameterList(), locals,
+                             new IR::BlockStatement(IR::Annotations::empty, body));
+}
+
+// K = 1 followed by numReaders controls that read K
+const IR::P4Program *makeReaderProgram() {
+    auto decls = new IR::IndexedVector<IR::Node>;
+    decls->push_back(makeConstant(1));
+    for (int i = 0; i < numReaders; ++i)
+        decls->push_back(makeReaderControl(i, makeAction()));
+    return new IR::P4Program(decls);
+}
+
+// Program with declaration index replaced by decl
+const IR::P4Program *replace(const IR::P4Program *program, size_t index, const IR::Node *decl) {
+    auto decls = new IR::IndexedVector<IR::Node>(*program->declarations);
+    decls->replace(decls->begin() + index, decl);
+    return new IR::P4Program(decls);
+}
+
+class Paths : public Inspector {
+    bool preorder(const IR::Path *path) override { paths.push_back(path); return true; }
+ public:
+    std::vector<const IR::Path *> paths;
+};
+
+// Checks that refMap resolves program in the same way as a new map does
+void expectResolved(const IR::P4Program *program, const ReferenceMap &refMap) {
+    ReferenceMap fresh;
+    program->apply(ResolveReferences(&fresh));
+    Paths paths;
+    program->apply(paths);
+    for (auto path : paths.paths) {
+        auto decl = fresh.getDeclaration(path);
+        ASSERT_NE(decl, nullptr);
+        EXPECT_EQ(refMap.getDeclaration(path), decl);
+        EXPECT_TRUE(refMap.isUsed(decl)); }
+}
+
+const IR::IDeclaration *resolvedInAction(const IR::Node *control, const ReferenceMap &refMap) {
+    auto action = control->to<IR::P4Control>()->controlLocals->getDeclaration<IR::P4Action>("a");
+    auto stat = action->body->components->at(0)->to<IR::AssignmentStatement>();
+    return refMap.getDeclaration(stat->right->to<IR::PathExpression>()->path);
+}
+}  // namespace
+
+TEST(ResolveReferences, ChangedContainer) {
+    ReferenceMap refMap;
+    auto program = makeReaderProgram();
+    program->apply(ResolveReferences(&refMap));
+    auto updated = replace(program, 3, makeReaderControl(42, makeAction()));
+    updated->apply(ResolveReferences(&refMap));
+    expectResolved(updated, refMap);
+}
+
+TEST(ResolveReferences, ChangedDeclaration) {
+    ReferenceMap refMap;
+    auto program = makeReaderProgram();
+    program->apply(ResolveReferences(&refMap));
+    auto updated = replace(program, 0, makeConstant(2));
+    updated->apply(ResolveReferences(&refMap));
+    expectResolved(updated, refMap);
+    EXPECT_FALSE(refMap.isUsed(program->declarations->at(0)->to<IR::IDeclaration>()));
+    EXPECT_EQ(resolvedInAction(updated->declarations->at(5), refMap),
+              updated->declarations->at(0)->to<IR::IDeclaration>());
+}
+
+TEST(ResolveReferences, Shadowed) {
+    ReferenceMap refMap;
+    auto program = makeReaderProgram();
+    program->apply(ResolveReferences(&refMap));
+    // Keep the action, but declare a local K before it
+    auto control = program->declarations->at(1)->to<IR::P4Control>();
+    auto action = control->controlLocals->getDeclaration<IR::P4Action>("a");
+    auto local = makeConstant(3);
+    auto updated = replace(program, 1, makeReaderControl(0, action, local));
+    updated->apply(ResolveReferences(&refMap));
+    expectResolved(updated, refMap);
+    EXPECT_EQ(resolvedInAction(updated->declarations->at(1), refMap), local);
+}
@@ -0,0 +1,50 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc. 
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "gtest/gtest.h"
+
+#include "ir/ir.h"
+#include "ir/visitor.h"
+
+namespace {
+// Replaces the constant 1 by the constant 2
+class ReplaceOne : public Transform {
+ public:
+    explicit ReplaceOne(bool lazy) { cloneOnWrite = lazy; }
+    const IR::Node *postorder(IR::Constant *c) override {
+        if (c->value == 1) return new IR::Constant(c->type, 2);
+        return c; }
+};
+}  // namespace
+
+TEST(Transform, CloneOnWrite) {
+    auto *t = IR::Type::Bits::get(8);
+    auto *left = new IR::Add(new IR::Constant(t, 3), new IR::Constant(t, 4));
+    auto *right = new IR::Add(new IR::Constant(t, 1), new IR::Constant(t, 5));
+    const IR::Expression *root = new IR::Mul(left, right);
+    for (bool lazy : { false, true }) {
+        auto *result = root->apply(ReplaceOne(lazy))->to<IR::Mul>();
+        ASSERT_NE(result, nullptr);
+        EXPECT_NE(result, root);
+        EXPECT_EQ(result->left, left);
+        EXPECT_NE(result->right, right);
+        EXPECT_EQ(result->right->to<IR::Add>()->left->to<IR::Constant>()->value, 2);
+        // the original tree is unchanged
+        EXPECT_EQ(right->left->to<IR::Constant>()->value, 1); }
+
+    // nothing is cloned if nothing changes
+    EXPECT_EQ(left->apply(ReplaceOne(true)), left);
+}
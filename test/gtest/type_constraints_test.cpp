@@ -0,0 +1,84 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "ir/ir.h"
+#include "frontends/p4/typeChecking/typeConstraints.h"
+
+using namespace P4;
+
+namespace {
+const int numTypeVars = 2000;
+
+// The type variables T0, T1, ...
+std::vector<const IR::Type_Var *> typeVariables() {
+    std::vector<const IR::Type_Var *> vars;
+    for (int i = 0; i < numTypeVars; ++i)
+        vars.push_back(new IR::Type_Var(IR::ID(cstring("T") + std::to_string(i))));
+    return vars;
+}
+}  // namespace
+
+// T0 = T1, T1 = T2, ..., then T0 = bit<8> many times: every use of T0 goes
+// through the whole chain of bindings.
+TEST(TypeConstraints, Chain) {
+    auto vars = typeVariables();
+    auto bits = IR::Type_Bits::get(8);
+    TypeConstraints constraints;
+    for (auto tv : vars)
+        constraints.addUnifiableTypeVariable(tv);
+    for (int i = 0; i < numTypeVars; ++i)
+        constraints.addEqualityConstraint(vars[0], bits);
+    for (int i = 0; i + 1 < numTypeVars; ++i)
+        constraints.addEqualityConstraint(vars[i], vars[i + 1]);
+
+    auto tvs = constraints.solve(nullptr, true);
+    ASSERT_NE(tvs, nullptr);
+    for (int i = 0; i + 1 < numTypeVars; ++i)
+        EXPECT_EQ(tvs->lookup(vars[i]), vars[i + 1]);
+    EXPECT_EQ(tvs->lookup(vars.back()), bits);
+}
+
+// A call to f<T0, ..., Tn>(in T0 x0, ..., in Tn xn) with arguments of types
+// bit<1>, ..., bit<n+1>.
+TEST(TypeConstraints, ManyTypeParameters) {
+    auto vars = typeVariables();
+    auto typeParams = new IR::IndexedVector<IR::Type_Var>();
+    auto params = new IR::IndexedVector<IR::Parameter>();
+    auto args = new IR::Vector<IR::ArgumentInfo>();
+    for (int i = 0; i < numTypeVars; ++i) {
+        typeParams->push_back(vars[i]);
+        params->push_back(
+            new IR::Parameter(IR::ID(cstring("x") + std::to_string(i)),
+                              IR::Direction::In, vars[i]));
+        args->push_back(new IR::ArgumentInfo(false, false, IR::Type_Bits::get(i + 1)));
+    }
+    auto method = new IR::Type_Method(new IR::TypeParameters(typeParams), IR::Type_Void::get(),
+                                      new IR::ParameterList(params));
+    auto call = new IR::Type_MethodCall(new IR::Vector<IR::Type>(),
+                                        new IR::Type_Var(IR::ID("R")), args);
+
+    TypeConstraints constraints;
+    constraints.addEqualityConstraint(method, call);
+    auto tvs = constraints.solve(nullptr, true);
+    ASSERT_NE(tvs, nullptr);
+    for (int i = 0; i < numTypeVars; ++i)
+        EXPECT_EQ(tvs->lookup(vars[i]), IR::Type_Bits::get(i + 1));
+    EXPECT_EQ(tvs->lookup(call->returnType), IR::Type_Void::get());
+}
@@ -0,0 +1,72 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <sstream>
+
+#include "gtest/gtest.h"
+
+#include "ir/ir.h"
+#include "frontends/p4/typeMap.h"
+
+using namespace P4;
+
+// Nodes read back from JSON keep the ids of the nodes they were written
+// from, so the record of checked nodes must not go by id.
+TEST(TypeMap, CheckedByNode) {
+    auto add = new IR::Add(new IR::Constant(1), new IR::Constant(2));
+    std::stringstream json;
+    JSONGenerator(json) << add;
+    std::string text = json.str();
+    const IR::Node *copy = nullptr;
+    JSONLoader(text.data(), text.size()) >> copy;
+    ASSERT_NE(copy, nullptr);
+    ASSERT_EQ(copy->id, add->id);
+
+    TypeMap typeMap;
+    typeMap.setChecked(add);
+    EXPECT_TRUE(typeMap.isChecked(add));
+    EXPECT_FALSE(typeMap.isChecked(copy));
+    typeMap.clear();
+    EXPECT_FALSE(typeMap.isChecked(add));
+}
+
+// A type is not simply equivalent to itself: comparing a stack of unknown
+// size reports an error even when it is nested in a struct, and types that
+// are never compared are a bug.
+TEST(TypeMap, EquivalentToItself) {
+    auto bit8 = IR::Type_Bits::get(8);
+    auto fields = new IR::IndexedVector<IR::StructField>();
+    fields->push_back(new IR::StructField(IR::ID("a"), IR::Annotations::empty, bit8));
+    auto header = new IR::Type_Header(IR::ID("h"), fields);
+    auto size = new IR::Constant(4);
+    auto stack = new IR::Type_Stack(Util::SourceInfo(), header, size);
+    EXPECT_TRUE(TypeMap::equivalent(bit8, bit8));
+    EXPECT_TRUE(TypeMap::equivalent(header, header));
+    EXPECT_TRUE(TypeMap::equivalent(stack, stack));
+
+    auto unsized = new IR::Type_Stack(Util::SourceInfo(), header,
+                                      new IR::PathExpression(IR::ID("n")));
+    auto outer = new IR::IndexedVector<IR::StructField>();
+    outer->push_back(new IR::StructField(IR::ID("s"), IR::Annotations::empty, unsized));
+    auto st = new IR::Type_Struct(IR::ID("s_t"), outer);
+    // run in a child process, which keeps the error out of the other tests
+    auto errors = ::errorCount();
+    EXPECT_EXIT(exit(TypeMap::equivalent(st, st) ? 0 : ::errorCount() - errors),
+                ::testing::ExitedWithCode(1), "Size of header stack type should be a constant");
+
+    auto name = new IR::Type_Name(new IR::Path(IR::ID("h")));
+    EXPECT_THROW(TypeMap::equivalent(name, name), Util::CompilerBug);
+}
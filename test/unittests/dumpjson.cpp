@@ -37,7 +37,6 @@ int main() {
     JSONGenerator(ss) << e1 << std::endl;
     std::cout << ss.str();
     JSONLoader loader(ss);
-    std::cout << loader.json;
     const IR::Node* e2 = nullptr;
     loader >> e2;
     JSONGenerator(std::cout) << e2 << std::endl;
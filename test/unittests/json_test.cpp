@@ -14,6 +14,7 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+#include <sstream>
 #include "../../lib/json.h"
 #include "test.h"
 
@@ -55,9 +56,85 @@ class TestJson : public TestBase {
 
         return SUCCESS;
     }
+
+    int testJsonWriter() {
+        auto arr = new JsonArray();
+        arr->append(5);
+        arr->append(new JsonArray({ new JsonValue("a"), new JsonValue(false) }));
+        arr->append(new JsonObject());
+        auto obj = new JsonObject();
+        obj->emplace("x", "x");
+        obj->emplace("y", arr);
+        obj->emplace("z", new JsonArray());
+        obj->emplace("n", static_cast<IJson*>(nullptr));
+
+        // the same object written without building it
+        std::stringstream out;
+        JsonWriter writer(out);
+        writer.beginObject();
+        writer.key("x").value("x");
+        writer.key("y").beginArray();
+        writer.value(5);
+        writer.beginArray(true).value("a").value(false).endArray();
+        writer.beginObject().endObject();
+        writer.endArray();
+        writer.key("z").beginArray(true).endArray();
+        writer.key("n").null();
+        writer.endObject();
+        ASSERT_EQ(cstring(out.str()), obj->toString());
+        ASSERT_EQ(obj->toString(), "{\n  \"x\" : \"x\",\n  \"y\" : [\n    5,\n"
+                  "    [\"a\", false],\n    {\n    }\n  ],\n  \"z\" : [],\n  \"n\" : null\n}");
+
+        // DOM values can be written inside streamed ones
+        std::stringstream mixed;
+        JsonWriter(mixed).beginArray().value(obj).value(new JsonValue(7)).endArray();
+        auto outer = new JsonArray({ obj, new JsonValue(7) });
+        ASSERT_EQ(cstring(mixed.str()), outer->toString());
+
+        // compact output has no whitespace at all
+        std::stringstream compact;
+        obj->serialize(compact, true);
+        ASSERT_EQ(compact.str(), "{\"x\":\"x\",\"y\":[5,[\"a\",false],{}],\"z\":[],\"n\":null}");
+
+        return SUCCESS;
+    }
+
+    int testJsonNumbers() {
+        // numbers that fit in 64 bits are held inline, wider ones in an mpz_class
+        mpz_class big("123456789012345678901234567890");
+        JsonValue small(-42), max(9223372036854775807L), wide(big);
+        JsonValue ulong(18446744073709551615UL), dbl(3.0);
+        ASSERT_EQ(small.toString(), "-42");
+        ASSERT_EQ(max.toString(), "9223372036854775807");
+        ASSERT_EQ(wide.toString(), "123456789012345678901234567890");
+        ASSERT_EQ(ulong.toString(), "18446744073709551615");
+        ASSERT_EQ(dbl.toString(), "3");
+
+        ASSERT_EQ(small == -42, true);
+        ASSERT_EQ(small == mpz_class(-42), true);
+        ASSERT_EQ(small == JsonValue(mpz_class(-42)), true);
+        ASSERT_EQ(small == 4294967254U, false);
+        ASSERT_EQ(small == 18446744073709551574UL, false);
+        ASSERT_EQ(wide == big, true);
+        ASSERT_EQ(wide == JsonValue(big), true);
+        ASSERT_EQ(wide == max, false);
+        ASSERT_EQ(ulong == 18446744073709551615UL, true);
+        ASSERT_EQ(ulong == JsonValue(mpz_class("18446744073709551615")), true);
+        ASSERT_EQ(dbl == 3, true);
+        ASSERT_EQ(dbl == 3.0, true);
+        ASSERT_EQ(dbl == 3.5, false);
+
+        ASSERT_EQ(small.getInt(), -42);
+        ASSERT_EQ(wide.getValue() == big, true);
+        ASSERT_EQ(max.getValue() == mpz_class("9223372036854775807"), true);
+        return SUCCESS;
+    }
+
  public:
     int run() {
         RUNTEST(testJson);
+        RUNTEST(testJsonWriter);
+        RUNTEST(testJsonNumbers);
         return SUCCESS;
     }
 };
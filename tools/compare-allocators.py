@@ -0,0 +1,116 @@
+#!/usr/bin/env python
+# Copyright 2013-present Barefoot Networks, Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#    http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Compares the garbage collector, plain malloc and arena allocation (--arena)
+# by compiling a set of P4 programs each way and reporting CPU time and peak
+# memory use of each compilation.
+#
+# The garbage collector and the arena are measured with the given compiler,
+# which should be a standard build (configured with libgc).  malloc needs a
+# second build of the same compiler, configured without the collector
+# (HAVE_LIBGC set to 0 in config.h), given with --malloc.
+#
+# usage: compare-allocators.py [-n runs] [--malloc compiler] compiler
+#                              [sample-dir-or-file ...] [-- compiler-args]
+
+from __future__ import print_function
+import sys
+import os
+import glob
+import argparse
+
+
+def run(argv):
+    """Run a command with output discarded; return (status, cpu seconds, max rss in KB)."""
+    devnull = os.open(os.devnull, os.O_WRONLY)
+    pid = os.fork()
+    if pid == 0:
+        os.dup2(devnull, 1)
+        os.dup2(devnull, 2)
+        try:
+            os.execvp(argv[0], argv)
+        finally:
+            os._exit(127)
+    os.close(devnull)
+    _, status, usage = os.wait4(pid, 0)
+    return status, usage.ru_utime + usage.ru_stime, usage.ru_maxrss
+
+
+def measure(compiler, extra, p4file, runs):
+    """Best-of-runs time and memory for one compilation."""
+    best = None
+    for _ in range(runs):
+        status, cpu, rss = run([compiler] + extra + [p4file])
+        if best is None or cpu < best[1]:
+            best = (status, cpu, rss)
+    return best
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Compare garbage-collected, malloc and arena allocation")
+    parser.add_argument("-n", dest="runs", type=int, default=1,
+                        help="run each compilation this many times and keep the fastest")
+    parser.add_argument("--malloc", dest="malloc_compiler",
+                        help="the same compiler built without the garbage collector")
+    parser.add_argument("compiler", help="compiler binary, e.g. ./p4test or ./p4c-bm2-ss")
+    parser.add_argument("inputs", nargs="*",
+                        help="P4 files or folders (default: testdata/p4_16_samples)")
+    argv = sys.argv[1:]
+    extra = []
+    if "--" in argv:
+        extra = argv[argv.index("--") + 1:]
+        argv = argv[:argv.index("--")]
+    args = parser.parse_args(argv)
+
+    srcdir = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    inputs = args.inputs or [os.path.join(srcdir, "testdata", "p4_16_samples")]
+    files = []
+    for i in inputs:
+        if os.path.isdir(i):
+            files += sorted(glob.glob(os.path.join(i, "*.p4")))
+        else:
+            files.append(i)
+
+    # (name, compiler, extra arguments)
+    configs = [("gc", args.compiler, [])]
+    if args.malloc_compiler:
+        configs.append(("malloc", args.malloc_compiler, []))
+    configs.append(("arena", args.compiler, ["--arena"]))
+
+    totals = dict((name, [0.0, 0]) for name, _, _ in configs)
+    print("%-40s" % "program" +
+          "".join(" %10s" % (name + " sec") for name, _, _ in configs) +
+          "".join(" %10s" % (name + " MB") for name, _, _ in configs))
+    for f in files:
+        results = [measure(compiler, extra + more, f, args.runs)
+                   for _, compiler, more in configs]
+        if any(result[0] != 0 for result in results):
+            # only compare programs that compile cleanly every way
+            continue
+        for (name, _, _), result in zip(configs, results):
+            totals[name][0] += result[1]
+            totals[name][1] = max(totals[name][1], result[2])
+        print("%-40s" % os.path.basename(f)[:40] +
+              "".join(" %10.3f" % result[1] for result in results) +
+              "".join(" %10.1f" % (result[2] / 1024.0) for result in results))
+    print("%-40s" % "TOTAL (time) / MAX (memory)" +
+          "".join(" %10.3f" % totals[name][0] for name, _, _ in configs) +
+          "".join(" %10.1f" % (totals[name][1] / 1024.0) for name, _, _ in configs))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
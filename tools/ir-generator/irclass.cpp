@@ -14,6 +14,7 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+#include <functional>
 #include "irclass.h"
 #include "lib/exceptions.h"
 #include "lib/enumerator.h"
@@ -75,7 +76,23 @@ Util::Enumerator<IrClass*>* IrDefinitions::getClasses() const {
             ->where([] (IrClass* e) { return e != nullptr; });
 }
 
+void IrDefinitions::numberClasses() const {
+    std::map<const IrClass *, std::vector<const IrClass *>> subclasses;
+    for (auto cls : *getClasses())
+        if (cls->kind == NodeKind::Abstract || cls->kind == NodeKind::Concrete)
+            subclasses[cls->getParent()].push_back(cls);
+    // 0 is Node itself, and the template classes (Vector etc) that derive directly from it
+    unsigned next = 0;
+    std::function<void(const IrClass *)> number = [&](const IrClass *cls) {
+        cls->kindIndex = next++;
+        for (auto sub : subclasses[cls])
+            number(sub);
+        cls->kindEnd = next; };
+    number(IrClass::nodeClass);
+}
+
 void IrDefinitions::generate(std::ostream &t, std::ostream &out, std::ostream &impl) const {
+    numberClasses();
     std::string macroname = "_IR_GENERATED_H_";
     out << "#ifndef " << macroname << "\n"
         << "#define " << macroname << "\n" << std::endl;
@@ -87,25 +104,32 @@ void IrDefinitions::generate(std::ostream &t, std::ostream &out, std::ostream &i
         << "#include <functional>\n" << std::endl
         << "class JSONLoader;\n"
         << "using NodeFactoryFn = IR::Node*(*)(JSONLoader&);\n"
+        << "class BinaryLoader;\n"
+        << "using BinaryFactoryFn = IR::Node*(*)(BinaryLoader&);\n"
         << std::endl
         << "namespace IR {\n"
         << "extern std::map<cstring, NodeFactoryFn> unpacker_table;\n"
+        << "extern std::map<cstring, BinaryFactoryFn> binary_unpacker_table;\n"
         << "}\n";
 
-    impl << "std::map<cstring, NodeFactoryFn> IR::unpacker_table = {\n";
-
-    bool first = true;
-    for (auto cls : *getClasses()) {
-        if (cls->kind == NodeKind::Concrete) {
-            if (first)
-                first = false;
-            else
-                impl << ",\n";
-            impl << "{\"" << cls->name << "\", NodeFactoryFn(&IR::";
-            if (cls->containedIn && cls->containedIn->name)
-                impl << cls->containedIn->name << "::";
-            impl << cls->name << "::fromJSON)}"; } }
-    impl << " };\n" << std::endl;
+    static const struct { const char *table, *type, *factory; } unpackers[] = {
+        { "unpacker_table", "NodeFactoryFn", "fromJSON" },
+        { "binary_unpacker_table", "BinaryFactoryFn", "fromBinary" } };
+    for (auto &unpacker : unpackers) {
+        impl << "std::map<cstring, " << unpacker.type << "> IR::" << unpacker.table << " = {\n";
+
+        bool first = true;
+        for (auto cls : *getClasses()) {
+            if (cls->kind == NodeKind::Concrete) {
+                if (first)
+                    first = false;
+                else
+                    impl << ",\n";
+                impl << "{\"" << cls->name << "\", " << unpacker.type << "(&IR::";
+                if (cls->containedIn && cls->containedIn->name)
+                    impl << cls->containedIn->name << "::";
+                impl << cls->name << "::" << unpacker.factory << ")}"; } }
+        impl << " };\n" << std::endl; }
 
     for (auto e : elements) {
         e->generate_hdr(out);
@@ -291,6 +315,12 @@ void IrClass::generate_hdr(std::ostream &out) const {
         if (e->access != access) out << (access = e->access);
         e->generate_hdr(out); }
 
+    if (kind == NodeKind::Abstract || kind == NodeKind::Concrete) {
+        if (access != IrElement::Public) out << IrElement::Public;
+        out << indent << "static constexpr unsigned static_kind = " << kindIndex
+            << ", static_kind_end = " << kindEnd << ";" << std::endl
+            << indent << "unsigned node_kind() const override { return " << kindIndex
+            << "; }" << std::endl; }
     if (kind != NodeKind::Interface && kind != NodeKind::Nested)
         out << indent << "IRNODE" << (kind == NodeKind::Abstract ?  "_ABSTRACT" : "")
             << "_SUBCLASS(" << name << ")" << std::endl;
@@ -226,6 +226,9 @@ class IrClass : public IrElement {
     mutable bool needIndexedVector = false;  // using an IndexedVecor of this class
     mutable bool needNameMap = false;   // using a NameMap of this class
     mutable bool needNodeMap = false;   // using a NodeMap of this class
+    // classes are numbered in a preorder walk of the class hierarchy, so the subclasses
+    // of a class are numbered [kindIndex+1, kindEnd)
+    mutable unsigned kindIndex = 0, kindEnd = 0;
     access_t current_access = Public;   // used while parsing the class body
 
     static const char* indent;
@@ -266,6 +269,7 @@ class IrClass : public IrElement {
 class IrDefinitions {
     std::vector<IrElement*> elements;
     Util::Enumerator<IrClass*>* getClasses() const;
+    void numberClasses() const;
 
  public:
     explicit IrDefinitions(std::vector<IrElement*> classes) : elements(classes) {}
@@ -131,6 +131,37 @@ const ordered_map<cstring, IrMethod::info_t> IrMethod::Generate = {
         buf << "{ return new " << cl->name << "(json); }";
         return buf.str();
     } } },
+{ "toBinary", { &NamedType::Void, {
+        new IrField(new ReferenceType(&NamedType::BinaryGenerator), "bin")
+    }, CONST + IN_IMPL + OVERRIDE,
+    [](IrClass *cl, Util::SourceInfo, cstring) -> cstring {
+        std::stringstream buf;
+        buf << "{" << std::endl
+            << cl->indent << cl->getParent()->name << "::toBinary(bin);" << std::endl;
+        for (auto f : *cl->getFields())
+            buf << cl->indent << "bin << this->" << f->name << ";" << std::endl;
+        buf << "}";
+        return buf.str(); } } },
+// the constructor reading from a BinaryLoader; the name only distinguishes it
+// from the JSONLoader one
+{ "binary constructor", { nullptr, {
+        new IrField(new ReferenceType(&NamedType::BinaryLoader), "bin")
+    }, IN_IMPL + CONSTRUCTOR,
+    [](IrClass *cl, Util::SourceInfo, cstring) -> cstring {
+        std::stringstream buf;
+        buf << ": " << cl->getParent()->name << "(bin) {" << std::endl;
+        for (auto f : *cl->getFields())
+            buf << cl->indent << "bin.load(" << f->name << ");" << std::endl;
+        buf << "}";
+        return buf.str(); } } },
+{ "fromBinary", { nullptr, {
+        new IrField(new ReferenceType(&NamedType::BinaryLoader), "bin"),
+    }, FACTORY + IN_IMPL + CONCRETE_ONLY,
+    [](IrClass *cl, Util::SourceInfo, cstring) -> cstring {
+        std::stringstream buf;
+        buf << "{ return new " << cl->name << "(bin); }";
+        return buf.str();
+    } } },
 { "toString", { &NamedType::Cstring, {}, CONST + IN_IMPL + OVERRIDE + NOT_DEFAULT,
     [](IrClass *, Util::SourceInfo, cstring) -> cstring { return cstring(); } } },
 };
@@ -192,7 +223,7 @@ void IrClass::generateMethods() {
         if (!IrMethod::Generate.count(m->name))
             throw Util::CompilationError("Unrecognized predefined method %1%", m);
         auto &info = IrMethod::Generate.at(m->name);
-        if (m->name) {
+        if (m->name && !(info.flags & CONSTRUCTOR)) {
             if (info.rtype) {
                 // This predefined method has an explicit return type.
                 m->rtype = info.rtype;
@@ -57,7 +57,8 @@ NamedType NamedType::Bool("bool"), NamedType::Int("int"), NamedType::Void("void"
           NamedType::Cstring("cstring"), NamedType::Ostream("std::ostream"),
           NamedType::Visitor("Visitor"), NamedType::Unordered_Set("std::unordered_set"),
           NamedType::JSONGenerator("JSONGenerator"), NamedType::JSONLoader("JSONLoader"),
-          NamedType::JsonObject("JsonObject");
+          NamedType::JsonObject("JsonObject"), NamedType::BinaryGenerator("BinaryGenerator"),
+          NamedType::BinaryLoader("BinaryLoader");
 
 cstring TemplateInstantiation::toString() const {
     std::string rv = base->toString().c_str();
@@ -86,7 +86,7 @@ class NamedType : public Type {
         return (lookup == t.lookup || (lookup && t.lookup && *lookup == *t.lookup)); }
 
     static NamedType Bool, Int, Void, Cstring, Ostream, Visitor, Unordered_Set, JSONGenerator,
-        JSONLoader, JsonObject;
+        JSONLoader, JsonObject, BinaryGenerator, BinaryLoader;
 };
 
 class TemplateInstantiation : public Type {